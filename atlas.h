@@ -0,0 +1,52 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <SFML/Graphics.hpp>
+#include <tinyxml2.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Built by atlas_pack from every sprite the game draws
+#define ATLAS_IMAGE "atlas.png"
+#define ATLAS_INDEX "atlas.xml"
+
+struct SubTexture {
+    std::string name;
+    int x, y, width, height;
+};
+
+inline std::vector<SubTexture> loadSubTextures(const std::string& xmlFile, const std::string& prefix) {
+    std::vector<SubTexture> subTextures;
+    tinyxml2::XMLDocument doc;
+    if (doc.LoadFile(xmlFile.c_str()) != tinyxml2::XML_SUCCESS) {
+        std::cerr << "Failed to load XML file!" << std::endl;
+        return subTextures;
+    }
+
+    tinyxml2::XMLElement* atlas = doc.FirstChildElement("TextureAtlas");
+    if (!atlas) return subTextures;
+
+    for (tinyxml2::XMLElement* elem = atlas->FirstChildElement("SubTexture"); elem != nullptr; elem = elem->NextSiblingElement("SubTexture")) {
+        SubTexture subTexture;
+        subTexture.name = elem->Attribute("name");
+        subTexture.x = elem->IntAttribute("x");
+        subTexture.y = elem->IntAttribute("y");
+        subTexture.width = elem->IntAttribute("width");
+        subTexture.height = elem->IntAttribute("height");
+
+        if (subTexture.name.find(prefix) == 0) {
+            subTextures.push_back(subTexture);
+        }
+    }
+    return subTextures;
+}
+
+inline const SubTexture* findSubTexture(const std::vector<SubTexture>& subTextures, const std::string& name) {
+    for (const auto& subTex : subTextures) {
+        if (subTex.name == name) return &subTex;
+    }
+    return nullptr;
+}
+
+#endif
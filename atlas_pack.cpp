@@ -0,0 +1,160 @@
+// Packs every sprite the game draws into one texture atlas.
+// g++ -std=c++11 atlas_pack.cpp -o atlas_pack -lsfml-graphics -lsfml-window -lsfml-system -ltinyxml2
+// ./atlas_pack            writes atlas.png and atlas.xml next to the game
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "atlas.h"
+
+// Border around each sprite, filled by repeating its edge pixels so
+// filtering and scaling never sample a neighbouring sprite
+#define ATLAS_PADDING 2
+#define ATLAS_MAX_SIZE 4096
+
+#define SHEET_IMAGE "resourcePack/Spritesheet/sokoban_spritesheet@2.png"
+#define SHEET_INDEX "resourcePack/Spritesheet/sokoban_spritesheet@2.xml"
+
+struct PackEntry {
+    std::string name;
+    sf::Image image;
+    int x, y;
+};
+
+bool addSheetSprites(std::vector<PackEntry>& entries, const sf::Image& sheet, const std::string& prefix) {
+    std::vector<SubTexture> subTextures = loadSubTextures(SHEET_INDEX, prefix);
+    if (subTextures.empty()) {
+        std::cerr << "No '" << prefix << "' sprites in " << SHEET_INDEX << std::endl;
+        return false;
+    }
+    for (const auto& subTex : subTextures) {
+        PackEntry entry;
+        entry.name = subTex.name;
+        entry.image.create(subTex.width, subTex.height);
+        entry.image.copy(sheet, 0, 0, sf::IntRect(subTex.x, subTex.y, subTex.width, subTex.height));
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+bool addFileSprite(std::vector<PackEntry>& entries, const std::string& file) {
+    PackEntry entry;
+    entry.name = file;
+    if (!entry.image.loadFromFile(file)) {
+        std::cerr << "Failed to load " << file << std::endl;
+        return false;
+    }
+    entries.push_back(entry);
+    return true;
+}
+
+// Shelf packing, tallest first; returns the used height or -1 if too tall
+int shelfPack(std::vector<PackEntry>& entries, const std::vector<int>& order, int width) {
+    int x = 0, y = 0, shelfHeight = 0;
+    for (int idx : order) {
+        PackEntry& e = entries[idx];
+        int w = static_cast<int>(e.image.getSize().x) + 2 * ATLAS_PADDING;
+        int h = static_cast<int>(e.image.getSize().y) + 2 * ATLAS_PADDING;
+        if (w > width) return -1;
+        if (x + w > width) {
+            x = 0;
+            y += shelfHeight;
+            shelfHeight = 0;
+        }
+        e.x = x + ATLAS_PADDING;
+        e.y = y + ATLAS_PADDING;
+        x += w;
+        shelfHeight = std::max(shelfHeight, h);
+    }
+    int height = y + shelfHeight;
+    return height > ATLAS_MAX_SIZE ? -1 : height;
+}
+
+void blitWithExtrusion(sf::Image& atlas, const PackEntry& e) {
+    int w = static_cast<int>(e.image.getSize().x);
+    int h = static_cast<int>(e.image.getSize().y);
+    atlas.copy(e.image, e.x, e.y);
+    for (int py = -ATLAS_PADDING; py < h + ATLAS_PADDING; py++) {
+        for (int px = -ATLAS_PADDING; px < w + ATLAS_PADDING; px++) {
+            if (px >= 0 && px < w && py >= 0 && py < h) continue;
+            int sx = std::min(std::max(px, 0), w - 1);
+            int sy = std::min(std::max(py, 0), h - 1);
+            atlas.setPixel(e.x + px, e.y + py, e.image.getPixel(sx, sy));
+        }
+    }
+}
+
+int main() {
+    sf::Image sheet;
+    if (!sheet.loadFromFile(SHEET_IMAGE)) {
+        std::cerr << "Failed to load " << SHEET_IMAGE << std::endl;
+        return -1;
+    }
+
+    // Order here is the order in the index, so prefix lookups in the game
+    // see ground and block tiles in the same order as the original sheet
+    std::vector<PackEntry> entries;
+    if (!addSheetSprites(entries, sheet, "ground") ||
+        !addSheetSprites(entries, sheet, "block") ||
+        !addFileSprite(entries, "item.png") ||
+        !addFileSprite(entries, "crate.png") ||
+        !addFileSprite(entries, "player_03.png") ||
+        !addFileSprite(entries, "player_06.png")) {
+        return -1;
+    }
+
+    std::vector<int> order(entries.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = static_cast<int>(i);
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        if (entries[a].image.getSize().y != entries[b].image.getSize().y) {
+            return entries[a].image.getSize().y > entries[b].image.getSize().y;
+        }
+        return a < b;
+    });
+
+    // Smallest power-of-two width whose packing gives the least area
+    int bestWidth = -1;
+    long long bestArea = 0;
+    for (int width = 64; width <= ATLAS_MAX_SIZE; width *= 2) {
+        int height = shelfPack(entries, order, width);
+        if (height < 0) continue;
+        long long area = static_cast<long long>(width) * height;
+        if (bestWidth < 0 || area < bestArea) {
+            bestWidth = width;
+            bestArea = area;
+        }
+    }
+    if (bestWidth < 0) {
+        std::cerr << "Sprites do not fit in a " << ATLAS_MAX_SIZE << "px atlas" << std::endl;
+        return -1;
+    }
+    int height = shelfPack(entries, order, bestWidth);
+
+    sf::Image atlas;
+    atlas.create(bestWidth, height, sf::Color::Transparent);
+    for (const auto& e : entries) {
+        blitWithExtrusion(atlas, e);
+    }
+    if (!atlas.saveToFile(ATLAS_IMAGE)) {
+        std::cerr << "Failed to write " << ATLAS_IMAGE << std::endl;
+        return -1;
+    }
+
+    std::ofstream index(ATLAS_INDEX);
+    index << "<TextureAtlas imagePath=\"" << ATLAS_IMAGE << "\">\n";
+    for (const auto& e : entries) {
+        index << "\t<SubTexture name=\"" << e.name << "\" x=\"" << e.x << "\" y=\"" << e.y
+              << "\" width=\"" << e.image.getSize().x << "\" height=\"" << e.image.getSize().y << "\"/>\n";
+    }
+    index << "</TextureAtlas>\n";
+    if (!index) {
+        std::cerr << "Failed to write " << ATLAS_INDEX << std::endl;
+        return -1;
+    }
+
+    std::cout << "Packed " << entries.size() << " sprites into " << bestWidth << "x" << height
+              << " " << ATLAS_IMAGE << std::endl;
+    return 0;
+}
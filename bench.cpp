@@ -0,0 +1,1862 @@
+// Standalone benchmarks for the SFML-free game modules.
+// g++ -std=c++20 -O2 bench.cpp -o bench -pthread -lrt
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "rng.h"
+#include "mapgen.h"
+#include "connectivity.h"
+#include "input.h"
+#include "board.h"
+#include "state_export.h"
+#include "savegame.h"
+#include "systems.h"
+#include "rollout.h"
+#include "capture.h"
+#include "metrics.h"
+#include "render_chunks.h"
+#include "threadconf.h"
+#include "leaderboard.h"
+#include "eventlog.h"
+#include "netcode.h"
+#include "coro.h"
+#include "level.h"
+
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static const char* mapTypeName(MapType type) {
+    switch (type) {
+        case MAP_RANDOM_FILL: return "random";
+        case MAP_CAVES: return "caves";
+        default: return "maze";
+    }
+}
+
+static void benchMapGen() {
+    printf("== mapgen ==\n");
+    const MapType types[] = {MAP_RANDOM_FILL, MAP_CAVES, MAP_MAZE};
+    const int sizes[] = {1024, 2048, 4096};
+    const int threadCounts[] = {1, 2, 4, 8};
+
+    for (int t = 0; t < 3; t++) {
+        for (int s = 0; s < 3; s++) {
+            int N = sizes[s];
+            uint64_t reference = 0;
+            for (int k = 0; k < 4; k++) {
+                MapConfig cfg;
+                cfg.type = types[t];
+                cfg.size = N;
+                cfg.seed = 42;
+                cfg.obstacleCount = (N - 2) * (N - 2) / 4;
+                cfg.minComponentSize = cfg.type == MAP_CAVES ? 32 : 0;
+                cfg.threads = threadCounts[k];
+                cfg.starts.push_back(std::make_pair(1, 1));
+                cfg.starts.push_back(std::make_pair(N - 2, N - 2));
+
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                GameMap map = generateMap(cfg);
+                double ms = elapsedMs(start);
+
+                // FNV-1a over the cells: must match for every thread count
+                uint64_t hash = 1469598103934665603ULL;
+                for (size_t i = 0; i < map.cells.size(); i++) hash = (hash ^ map.cells[i]) * 1099511628211ULL;
+                if (k == 0) reference = hash;
+
+                int floor = countFloor(map);
+                bool connected = countReachable(map, 1, 1) == floor &&
+                                 countReachable(map, N - 2, N - 2) == floor;
+                printf("%-7s N=%-5d threads=%d  %9.2f ms  floor=%d  connected=%s  %s\n",
+                       mapTypeName(cfg.type), N, cfg.threads, ms, floor,
+                       connected ? "yes" : "NO", hash == reference ? "same" : "DIFFERENT");
+            }
+        }
+    }
+}
+
+static void benchConnectivity() {
+    printf("== connectivity ==\n");
+    const int sizes[] = {256, 1024, 2048};
+    for (int s = 0; s < 3; s++) {
+        int N = sizes[s];
+        MapConfig cfg;
+        cfg.type = MAP_CAVES;
+        cfg.size = N;
+        cfg.seed = 7;
+        cfg.minComponentSize = 32;
+        cfg.starts.push_back(std::make_pair(1, 1));
+        cfg.starts.push_back(std::make_pair(N - 2, N - 2));
+        GameMap map = generateMap(cfg);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        ConnectivityIndex index;
+        index.build(map);
+        double buildMs = elapsedMs(start);
+
+        // Spawn and collect: pick a reachable free cell, occupy it, free it again
+        const int picks = 1000000;
+        int xs[2] = {1, N - 2}, ys[2] = {1, N - 2};
+        Rng rng(1);
+        start = std::chrono::steady_clock::now();
+        int x = 0, y = 0;
+        for (int i = 0; i < picks; i++) {
+            index.pickReachableFreeCell(xs, ys, 2, rng.next(), x, y);
+            index.markOccupied(x, y);
+            index.markFree(x, y);
+        }
+        double pickNs = elapsedMs(start) * 1e6 / picks;
+
+        // Close and reopen floor cells; closing may split a component
+        const int toggles = 200;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < toggles; i++) {
+            int tx, ty;
+            do {
+                tx = 1 + static_cast<int>(rng.below(N - 2));
+                ty = 1 + static_cast<int>(rng.below(N - 2));
+            } while (map.isWall(tx, ty));
+            index.addObstacle(tx, ty);
+            index.removeObstacle(tx, ty);
+        }
+        double toggleUs = elapsedMs(start) * 1e3 / toggles;
+
+        printf("N=%-5d build %8.2f ms  pick+occupy+free %6.1f ns  obstacle add+remove %9.1f us  reachable=%d\n",
+               N, buildMs, pickNs, toggleUs, index.reachableArea(1, 1));
+    }
+}
+
+struct RngBenchJob {
+    int first, stride, streams;
+    uint64_t draws;
+    std::vector<uint64_t>* sums;
+};
+
+static void* rngBenchWorker(void* arg) {
+    RngBenchJob* job = static_cast<RngBenchJob*>(arg);
+    for (int st = job->first; st < job->streams; st += job->stride) {
+        Rng rng = rngStream(rngMasterSeed(), RNG_STREAM_THREAD, st);
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < job->draws; i++) sum += rng.next();
+        (*job->sums)[st] = sum;
+    }
+    return nullptr;
+}
+
+static void benchRng() {
+    printf("== rng ==\n");
+    const uint64_t draws = 100000000ULL;
+
+    Rng rng(42);
+    uint64_t sink = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < draws; i++) sink += rng.next();
+    printf("xoshiro256** next  %6.2f ns/draw\n", elapsedMs(start) * 1e6 / draws);
+
+    start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < draws / 10; i++) sink += rand();
+    printf("rand()             %6.2f ns/draw\n", elapsedMs(start) * 1e6 / (draws / 10));
+
+    // Same per-stream output no matter how streams are spread over threads
+    rngMasterSeed() = 1234;
+    const int streams = 16;
+    const int threadCounts[] = {1, 2, 4, 8};
+    std::vector<uint64_t> reference;
+    for (int k = 0; k < 4; k++) {
+        int threads = threadCounts[k];
+        std::vector<uint64_t> sums(streams);
+        std::vector<RngBenchJob> jobs(threads);
+        std::vector<pthread_t> workers(threads);
+        start = std::chrono::steady_clock::now();
+        for (int t = 0; t < threads; t++) {
+            RngBenchJob job = {t, threads, streams, draws / streams, &sums};
+            jobs[t] = job;
+            pthread_create(&workers[t], nullptr, rngBenchWorker, &jobs[t]);
+        }
+        for (int t = 0; t < threads; t++) pthread_join(workers[t], nullptr);
+        double ms = elapsedMs(start);
+        if (k == 0) reference = sums;
+        printf("%d streams on %d threads  %8.2f ms  %s\n", streams, threads, ms,
+               sums == reference ? "same" : "DIFFERENT");
+    }
+    if (sink == 42) printf("\n");
+}
+
+// Simulated fast tapping against both input paths. Moves are applied by
+// the main loop at the start of each frame; latency is press to applied
+// move, and a press that never produced a move counts as dropped.
+struct KeyPress {
+    int64_t downUs, upUs;
+    int dir;
+};
+
+// Index of the press held at time t, or -1; cursor only moves forward
+static int heldAt(const std::vector<KeyPress>& presses, int64_t t, size_t& cursor) {
+    while (cursor < presses.size() && presses[cursor].upUs <= t) cursor++;
+    if (cursor < presses.size() && presses[cursor].downUs <= t) return static_cast<int>(cursor);
+    return -1;
+}
+
+static void reportInput(const char* name, const LatencyStats& first, size_t presses) {
+    printf("%-17s first-move latency mean %6.2f ms  max %6.2f ms  dropped presses %lld/%zu\n",
+           name, first.meanUs() / 1000.0, first.maxUs / 1000.0,
+           static_cast<long long>(presses) - first.count, presses);
+}
+
+static void benchInput() {
+    printf("== input ==\n");
+    Rng rng(9);
+    std::vector<KeyPress> presses;
+    int64_t t = 0;
+    while (t < 60000000LL) {
+        KeyPress p;
+        p.downUs = t + 20000 + rng.below(130000);
+        p.upUs = p.downUs + 30000 + rng.below(90000);
+        p.dir = static_cast<int>(rng.below(4));
+        presses.push_back(p);
+        t = p.upUs;
+    }
+
+    const int64_t frameUs = 16667;
+    const int64_t endUs = t + 1000000;
+
+    // Old playerThread: poll, push, sleep 100 ms after a move or 10 ms otherwise
+    {
+        LatencyStats first;
+        size_t cursor = 0;
+        int lastPress = -1;
+        for (int64_t now = 0; now < endUs;) {
+            int press = heldAt(presses, now, cursor);
+            if (press >= 0) {
+                if (press != lastPress) {
+                    int64_t applied = (now / frameUs + 1) * frameUs;
+                    first.record(applied - presses[press].downUs);
+                    lastPress = press;
+                }
+                now += 100000;
+            } else {
+                now += 10000;
+            }
+        }
+        reportInput("sleep polling", first, presses.size());
+    }
+
+    // InputScheduler sampled at the end of every frame
+    {
+        LatencyStats first;
+        InputScheduler scheduler;
+        size_t cursor = 0;
+        int lastHeld = -1, lastPress = -1;
+        for (int64_t now = frameUs; now < endUs; now += frameUs) {
+            int press = heldAt(presses, now, cursor);
+            if (press >= 0) lastHeld = press;
+            unsigned mask = press >= 0 ? DIR_BIT(presses[press].dir) : 0;
+            // A press that began and ended between two ticks is never seen
+            if (scheduler.update(mask, now) != DIR_NONE && lastHeld != lastPress) {
+                first.record(now - presses[lastHeld].downUs);
+                lastPress = lastHeld;
+            }
+        }
+        reportInput("tick + scheduler", first, presses.size());
+    }
+}
+
+// The pre-bitboard game: crates and items in vectors, scanned per query
+struct ScanCell {
+    int x, y;
+    bool collected;
+};
+
+static bool scanOccupied(const std::vector<ScanCell>& cells, int x, int y) {
+    for (size_t i = 0; i < cells.size(); i++) {
+        if (!cells[i].collected && cells[i].x == x && cells[i].y == y) return true;
+    }
+    return false;
+}
+
+template <int W>
+static void benchBoardSize(int N, int crateCount, int itemCount) {
+    Rng rng(N);
+    Board<W> board(N);
+    std::vector<ScanCell> crates, items;
+    while (static_cast<int>(crates.size()) < crateCount) {
+        ScanCell c = {1 + static_cast<int>(rng.below(N - 2)), 1 + static_cast<int>(rng.below(N - 2)), false};
+        if (board.hasCrate(c.x, c.y)) continue;
+        board.setCrate(c.x, c.y);
+        crates.push_back(c);
+    }
+    while (static_cast<int>(items.size()) < itemCount) {
+        ScanCell c = {1 + static_cast<int>(rng.below(N - 2)), 1 + static_cast<int>(rng.below(N - 2)), false};
+        if (board.hasCrate(c.x, c.y) || board.hasItem(c.x, c.y)) continue;
+        board.setItem(c.x, c.y);
+        items.push_back(c);
+    }
+    Board<W> start = board;
+    std::vector<ScanCell> startItems = items;
+
+    // Move resolution: random walk, open check plus pickup
+    const int moves = 2000000;
+    std::vector<unsigned> dirs(moves);
+    for (int i = 0; i < moves; i++) dirs[i] = rng.below(4);
+    static const int DX[4] = {-1, 1, 0, 0};
+    static const int DY[4] = {0, 0, -1, 1};
+
+    int px = 1, py = 1, score = 0;
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < moves; i++) {
+        int nx = px + DX[dirs[i]], ny = py + DY[dirs[i]];
+        if (nx > 0 && nx < N - 1 && ny > 0 && ny < N - 1 && !scanOccupied(crates, nx, ny)) {
+            px = nx;
+            py = ny;
+            for (size_t k = 0; k < items.size(); k++) {
+                if (!items[k].collected && items[k].x == nx && items[k].y == ny) {
+                    items[k].collected = true;
+                    score++;
+                }
+            }
+        }
+    }
+    double scanMoveNs = elapsedMs(t0) * 1e6 / moves;
+    int scanScore = score;
+
+    px = 1, py = 1, score = 0;
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < moves; i++) {
+        int nx = px + DX[dirs[i]], ny = py + DY[dirs[i]];
+        if (board.isOpen(nx, ny)) {
+            px = nx;
+            py = ny;
+            score += board.pickup(nx, ny);
+        }
+    }
+    double boardMoveNs = elapsedMs(t0) * 1e6 / moves;
+
+    // Spawning: the old retry loop against a popcount pick over candidate masks
+    const int spawns = 200000;
+    items = startItems;
+    int scanFailures = 0;
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < spawns; i++) {
+        bool valid = false;
+        for (int attempts = 0; attempts < 10 && !valid; attempts++) {
+            int x = 1 + static_cast<int>(rng.below(N - 2)), y = 1 + static_cast<int>(rng.below(N - 2));
+            valid = !scanOccupied(crates, x, y) && !scanOccupied(items, x, y);
+        }
+        scanFailures += !valid;
+    }
+    double scanSpawnNs = elapsedMs(t0) * 1e6 / spawns;
+
+    board = start;
+    long long checksum = 0;
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < spawns; i++) {
+        int x = 0, y = 0;
+        if (board.pickSpawn(static_cast<uint32_t>(rng.next()), x, y)) checksum += x + y;
+    }
+    double boardSpawnNs = elapsedMs(t0) * 1e6 / spawns;
+
+    printf("N=%-4d Board<%d>  move: scan %7.1f ns  board %5.1f ns (score %d/%d)  spawn: scan %8.1f ns  board %7.1f ns%s\n",
+           N, W, scanMoveNs, boardMoveNs, scanScore, score, scanSpawnNs, boardSpawnNs,
+           scanFailures ? "  (scan spawn failed sometimes)" : "");
+    if (checksum == 42) printf("\n");
+}
+
+static void benchBoard() {
+    printf("== board ==\n");
+    benchBoardSize<16>(15, 7, 40);
+    benchBoardSize<32>(25, 7, 40);
+    benchBoardSize<64>(64, 400, 400);
+    benchBoardSize<256>(256, 6500, 6500);
+}
+
+// Fills a snapshot the way the game does each tick. Every field is derived
+// from the tick so a reader can tell a torn copy from a clean one.
+static void fillExport(ExportSnapshot* snap, uint64_t tick) {
+    snap->elapsed = static_cast<float>(tick);
+    snap->timeRemaining = 60;
+    snap->gridSize = 25;
+    snap->running = 1;
+    snap->playerCount = 2;
+    for (int i = 0; i < 2; i++) {
+        snap->players[i].x = static_cast<int32_t>(tick + i);
+        snap->players[i].y = static_cast<int32_t>(tick);
+        snap->players[i].score = static_cast<int32_t>(tick);
+    }
+    snap->itemCount = 40;
+    for (int i = 0; i < 40; i++) {
+        snap->items[i].x = static_cast<int16_t>(tick);
+        snap->items[i].y = static_cast<int16_t>(i);
+        snap->items[i].spawnTime = static_cast<float>(tick);
+    }
+    snap->crateCount = 7;
+    for (int i = 0; i < 7; i++) {
+        snap->crates[i].x = static_cast<int16_t>(tick);
+        snap->crates[i].y = static_cast<int16_t>(i);
+    }
+}
+
+struct ExportReaderJob {
+    std::atomic<bool>* stop;
+    long long reads, torn, empty;
+};
+
+static void* exportReader(void* arg) {
+    ExportReaderJob* job = static_cast<ExportReaderJob*>(arg);
+    StateExportReader reader;
+    if (!reader.open("/maga_fight_bench")) return nullptr;
+    ExportSnapshot snap;
+    while (!job->stop->load()) {
+        if (!reader.readLatest(snap)) {
+            job->empty++;
+            continue;
+        }
+        job->reads++;
+        int16_t t = static_cast<int16_t>(snap.tick);
+        if (snap.players[1].x != static_cast<int32_t>(snap.tick + 1) || snap.items[39].x != t ||
+            snap.crates[6].x != t || snap.elapsed != static_cast<float>(snap.tick)) {
+            job->torn++;
+        }
+    }
+    return nullptr;
+}
+
+static void benchExport() {
+    printf("== export ==\n");
+    StateExportWriter writer;
+    if (!writer.open("/maga_fight_bench")) {
+        printf("shm_open failed\n");
+        return;
+    }
+
+    const int ticks = 2000000;
+    for (int readers = 0; readers <= 2; readers++) {
+        std::atomic<bool> stop(false);
+        std::vector<ExportReaderJob> jobs(readers);
+        std::vector<pthread_t> threads(readers);
+        for (int r = 0; r < readers; r++) {
+            ExportReaderJob job = {&stop, 0, 0, 0};
+            jobs[r] = job;
+            pthread_create(&threads[r], nullptr, exportReader, &jobs[r]);
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int i = 0; i < ticks; i++) {
+            ExportSnapshot* snap = writer.begin();
+            fillExport(snap, snap->tick);
+            writer.publish();
+        }
+        double ns = elapsedMs(start) * 1e6 / ticks;
+        stop = true;
+
+        long long reads = 0, torn = 0;
+        for (int r = 0; r < readers; r++) {
+            pthread_join(threads[r], nullptr);
+            reads += jobs[r].reads;
+            torn += jobs[r].torn;
+        }
+        printf("publish %6.1f ns/tick with %d reader(s)  reads %lld  torn %lld\n", ns, readers, reads, torn);
+    }
+}
+
+// A mid-match 25x25 game: generated crates plus a full set of coins, a
+// quarter of them already collected
+static void buildMatch(MatchState& match, uint64_t seed) {
+    setupMatch(match, seed, 25);
+
+    int xs[TOTAL_PLAYERS] = {1, 23}, ys[TOTAL_PLAYERS] = {1, 23};
+    for (int i = 0; i < MAX_ITEMS; i++) {
+        int x, y;
+        if (!match.connectivity.pickReachableFreeCell(xs, ys, TOTAL_PLAYERS, match.spawnRng.next(), x, y)) break;
+        if (i % 4 == 0) {
+            match.addScore(i % TOTAL_PLAYERS, 1);
+        } else {
+            match.world.create(itemDesc(x, y, i * 1.5f, 0));
+            match.connectivity.markOccupied(x, y);
+            match.board.setItem(x, y);
+        }
+        match.itemsSpawned++;
+    }
+    match.lastItemSpawnTime = 30;
+}
+
+// Same occupancy, positions, scores and RNG state
+static bool sameMatch(MatchState& a, MatchState& b) {
+    if (a.gridSize != b.gridSize || a.itemsSpawned != b.itemsSpawned) return false;
+    if (a.world.count(COMP_COLLECTIBLE) != b.world.count(COMP_COLLECTIBLE)) return false;
+    for (int i = 0; i < TOTAL_PLAYERS; i++) {
+        if (a.playerPos(i).x != b.playerPos(i).x || a.playerPos(i).y != b.playerPos(i).y ||
+            a.playerScore(i) != b.playerScore(i)) {
+            return false;
+        }
+    }
+    for (int x = 0; x < a.gridSize; x++) {
+        for (int y = 0; y < a.gridSize; y++) {
+            if (a.board.isOpen(x, y) != b.board.isOpen(x, y) || a.board.hasItem(x, y) != b.board.hasItem(x, y)) return false;
+            if (a.connectivity.reachableArea(x, y) != b.connectivity.reachableArea(x, y)) return false;
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        if (a.spawnRng.s[i] != b.spawnRng.s[i]) return false;
+    }
+    return true;
+}
+
+static void benchSave() {
+    printf("== save ==\n");
+    MatchState match;
+    buildMatch(match, 42);
+    const int iterations = 20000;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 200; i++) {
+        MatchState fresh;
+        buildMatch(fresh, 42);
+    }
+    printf("regenerate      %8.2f us\n", elapsedMs(start) * 1000 / 200);
+
+    std::vector<char> buf;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) snapshotMatch(match, 30.0f, buf);
+    printf("snapshot        %8.2f us  (%zu bytes)\n", elapsedMs(start) * 1000 / iterations, buf.size());
+
+    MatchState restored;
+    float elapsed = 0;
+    bool ok = true;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) ok = restoreMatch(restored, buf.data(), buf.size(), elapsed) && ok;
+    printf("restore         %8.2f us\n", elapsedMs(start) * 1000 / iterations);
+
+    const char* path = "/tmp/maga_bench.sav";
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 2000; i++) ok = saveMatchFile(match, 30.0f, path) && ok;
+    printf("save file       %8.2f us\n", elapsedMs(start) * 1000 / 2000);
+
+    MatchState loaded;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 2000; i++) ok = loadMatchFile(loaded, path, elapsed) && ok;
+    printf("load file       %8.2f us\n", elapsedMs(start) * 1000 / 2000);
+    unlink(path);
+
+    MatchState copy = match;
+    ok = ok && elapsed == 30.0f && sameMatch(copy, restored);
+    copy = match;
+    ok = ok && sameMatch(copy, loaded);
+    printf("round trip %s\n", ok ? "ok" : "MISMATCH");
+}
+
+// Stand-in for the SFML render system: one quad (x, y, sprite) per entity
+struct BenchQuad {
+    float x, y;
+    int sprite;
+};
+
+static void benchRenderSystem(void* arg, World& world, Commands&) {
+    FrameContext* frame = static_cast<FrameContext*>(arg);
+    std::vector<BenchQuad>& quads = *static_cast<std::vector<BenchQuad>*>(frame->renderData);
+    quads.clear();
+    world.each(COMP_POSITION | COMP_SPRITE, 0, [&](Archetype& a) {
+        for (int r = 0; r < a.size(); r++) {
+            BenchQuad q = {a.positions[r].y * 24.0f, a.positions[r].x * 24.0f, a.sprites[r].id};
+            quads.push_back(q);
+        }
+    });
+}
+
+// Runs a 60-second match at 60 fps with random inputs, coins expiring after
+// five seconds; returns microseconds per frame
+static double runEcsMatch(MatchState& match, bool parallel, double parallelMinUs, std::string* stages) {
+    buildMatch(match, 7);
+    match.itemLifetime = 5;
+    match.lastItemSpawnTime = 0;
+    match.itemsSpawned = 0;
+
+    SystemScheduler scheduler;
+    scheduler.parallel = parallel;
+    scheduler.parallelMinUs = parallelMinUs;
+    addGameSystems(scheduler, benchRenderSystem);
+    if (stages) *stages = scheduler.describe();
+
+    std::vector<BenchQuad> quads;
+    FrameContext frame;
+    frame.match = &match;
+    frame.renderData = &quads;
+    Rng inputRng = rngStream(7, RNG_STREAM_PLAYER);
+    const int frames = 3600;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++) {
+        frame.now = f / 60.0f;
+        frame.moves.clear();
+        for (int p = 0; p < TOTAL_PLAYERS; p++) {
+            MoveMessage msg = {p, 0, 0, 0};
+            dirToDelta(static_cast<int>(inputRng.below(4)), msg.newX, msg.newY);
+            frame.moves.push_back(msg);
+        }
+        scheduler.run(match.world, &frame);
+    }
+    return elapsedMs(start) * 1000 / frames;
+}
+
+static void benchEcs() {
+    printf("== ecs ==\n");
+    MatchState serial, adaptive, parallel;
+    std::string stages;
+    double serialUs = runEcsMatch(serial, false, 0, &stages);
+    double adaptiveUs = runEcsMatch(adaptive, true, ECS_PARALLEL_MIN_US, nullptr);
+    double parallelUs = runEcsMatch(parallel, true, 0, nullptr);
+    printf("stages: %s\n", stages.c_str());
+    printf("serial          %6.2f us/frame\n", serialUs);
+    printf("parallel >=%dus %6.2f us/frame\n", ECS_PARALLEL_MIN_US, adaptiveUs);
+    printf("always parallel %6.2f us/frame\n", parallelUs);
+    printf("coins left %d, spawned %d, scores %d/%d, same result %s\n",
+           serial.world.count(COMP_COLLECTIBLE), serial.itemsSpawned, serial.playerScore(0), serial.playerScore(1),
+           sameMatch(serial, parallel) && sameMatch(serial, adaptive) ? "yes" : "NO");
+}
+
+static void benchRollout() {
+    printf("== rollout ==\n");
+    MatchState match;
+    buildMatch(match, 11);
+    RolloutState root = rolloutFromMatch(match, 30.0f);
+
+    const int clones = 1000000;
+    std::vector<RolloutState> sink(2);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < clones; i++) {
+        sink[i & 1] = root;
+        sink[i & 1].now += 1;
+    }
+    printf("clone %zu bytes  %6.1f ns\n", sizeof(RolloutState), elapsedMs(start) * 1e6 / clones);
+
+    RolloutConfig cfg;
+    cfg.rollouts = 20000;
+    cfg.chunks = 64;
+    cfg.seed = 99;
+    int maxThreads = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    if (maxThreads < 8) maxThreads = 8;
+    double base = 0;
+    int firstMove = DIR_NONE;
+    bool same = true;
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        ThreadPool pool;
+        pool.start(threads);
+        RolloutStats stats = {0, {{0, 0}, {0, 0}, {0, 0}, {0, 0}}};
+        start = std::chrono::steady_clock::now();
+        int move = rolloutBotMove(root, 0, cfg, &pool, &stats);
+        double perSec = stats.rollouts / (elapsedMs(start) / 1000);
+        if (threads == 1) {
+            base = perSec;
+            firstMove = move;
+        }
+        same = same && move == firstMove;
+        printf("%2d threads  %9.0f rollouts/s  x%.2f  (depth %d)\n", threads, perSec, perSec / base, cfg.depth);
+    }
+    printf("same move for every thread count: %s\n", same ? "yes" : "NO");
+}
+
+// Records frames of a 600x600 window into a raw stream. The memcpy stands in
+// for the GPU readback; handoff is what the pipeline itself costs the
+// render thread (taking a buffer and queueing it).
+static void runCapture(const char* name, int frames, int encoders, int buffers, bool paced) {
+    const int size = 600;
+    const char* path = "/tmp/bench_capture.rgba";
+    FrameCapture capture;
+    if (!capture.open(path, CAPTURE_RAW, size, size, encoders, nullptr, buffers)) {
+        printf("cannot open %s\n", path);
+        return;
+    }
+    std::vector<uint8_t> source(capture.frameBytes());
+    std::vector<long long> handoffNs;
+    double copyUs = 0;
+    std::vector<unsigned char> tags;   // tag of each frame that was not dropped
+    int64_t nextUs = monotonicMicros();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++) {
+        if (paced) {
+            int64_t wait = nextUs - monotonicMicros();
+            if (wait > 0) usleep(static_cast<useconds_t>(wait));
+            nextUs += 1000000 / CAPTURE_FPS;
+        }
+        memset(source.data(), f & 0xFF, 64);   // tag each frame so the output can be checked
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        CaptureFrame* shot = capture.acquire();
+        std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point t2 = t1;
+        if (shot) {
+            memcpy(shot->pixels.data(), source.data(), source.size());
+            t2 = std::chrono::steady_clock::now();
+            capture.submit(shot);
+            tags.push_back(static_cast<unsigned char>(f & 0xFF));
+        }
+        std::chrono::steady_clock::time_point t3 = std::chrono::steady_clock::now();
+        handoffNs.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>((t1 - t0) + (t3 - t2)).count());
+        copyUs += std::chrono::duration<double, std::micro>(t2 - t1).count();
+    }
+    double seconds = elapsedMs(start) / 1000;
+    capture.close();
+
+    std::sort(handoffNs.begin(), handoffNs.end());
+    long long total = 0;
+    for (size_t i = 0; i < handoffNs.size(); i++) total += handoffNs[i];
+    printf("%-6s %d enc %d buf  %7.0f fps  handoff mean %4.1f us p99 %5.1f us max %6.1f us  copy %5.1f us  written %4lld  dropped %lld\n",
+           name, encoders, buffers, frames / seconds, total / 1000.0 / frames,
+           handoffNs[handoffNs.size() * 99 / 100] / 1000.0, handoffNs.back() / 1000.0,
+           tags.empty() ? 0.0 : copyUs / tags.size(), static_cast<long long>(capture.written),
+           static_cast<long long>(capture.dropped));
+
+    // Frames must land in submit order with no gaps, whatever encoder wrote them
+    FILE* in = fopen(path, "rb");
+    struct stat st;
+    bool ok = in && stat(path, &st) == 0 && capture.written == static_cast<long long>(tags.size()) &&
+              st.st_size == static_cast<off_t>(tags.size() * capture.frameBytes());
+    for (size_t i = 0; ok && i < tags.size(); i++) {
+        unsigned char tag;
+        ok = fseeko(in, static_cast<off_t>(i * capture.frameBytes()), SEEK_SET) == 0 && fread(&tag, 1, 1, in) == 1 &&
+             tag == tags[i];
+    }
+    if (in) fclose(in);
+    unlink(path);
+    printf("       stream size and frame order %s\n", ok ? "ok" : "BAD");
+}
+
+static void benchCapture() {
+    printf("== capture ==\n");
+    runCapture("60fps", 300, CAPTURE_DEFAULT_ENCODERS, CAPTURE_BUFFERS, true);
+    runCapture("60fps", 300, 1, CAPTURE_BUFFERS, true);
+    runCapture("burst", 1000, 1, 2, false);
+    runCapture("burst", 1000, CAPTURE_DEFAULT_ENCODERS, CAPTURE_BUFFERS, false);
+}
+
+struct MetricsJob {
+    bool sharded;
+    int iterations;
+    std::atomic<uint64_t>* shared;
+};
+
+static void* metricsWorker(void* arg) {
+    MetricsJob* job = static_cast<MetricsJob*>(arg);
+    for (int i = 0; i < job->iterations; i++) {
+        if (job->sharded) {
+            countMetric(METRIC_MOVES_ENQUEUED);
+        } else {
+            job->shared->fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    return nullptr;
+}
+
+// Per-thread shards against one shared atomic counter, which every thread
+// has to pull into its own cache to increment
+static void benchMetrics() {
+    printf("== metrics ==\n");
+    const int iterations = 20000000;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) observeMetric(METRIC_FRAME_TIME_US, static_cast<uint64_t>(i & 4095));
+    printf("observe histogram %5.2f ns\n", elapsedMs(start) * 1e6 / iterations);
+
+    int maxThreads = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    if (maxThreads < 4) maxThreads = 4;
+    uint64_t expected = 0;
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        expected += static_cast<uint64_t>(iterations / threads) * threads;
+        double ns[2];
+        for (int mode = 0; mode < 2; mode++) {
+            std::atomic<uint64_t> shared(0);
+            std::vector<MetricsJob> jobs(threads);
+            std::vector<pthread_t> workers(threads);
+            start = std::chrono::steady_clock::now();
+            for (int t = 0; t < threads; t++) {
+                MetricsJob job = {mode == 0, iterations / threads, &shared};
+                jobs[t] = job;
+                pthread_create(&workers[t], nullptr, metricsWorker, &jobs[t]);
+            }
+            for (int t = 0; t < threads; t++) pthread_join(workers[t], nullptr);
+            ns[mode] = elapsedMs(start) * 1e6 / iterations;
+        }
+        printf("%2d threads  sharded %5.2f ns/count  shared atomic %5.2f ns/count\n", threads, ns[0], ns[1]);
+    }
+    // Threads come and go between runs; their shards keep the counts
+    printf("counted %llu, expected %llu\n", static_cast<unsigned long long>(metricsRegistry().counter(METRIC_MOVES_ENQUEUED)),
+           static_cast<unsigned long long>(expected));
+
+    start = std::chrono::steady_clock::now();
+    std::string text;
+    for (int i = 0; i < 1000; i++) text = renderMetrics();
+    printf("render %zu bytes  %6.1f us\n", text.size(), elapsedMs(start));
+}
+
+// Same layout as sf::Vertex
+struct BenchVec {
+    float x, y;
+};
+
+struct BenchVertex {
+    BenchVec position;
+    uint32_t color;
+    BenchVec texCoords;
+};
+
+// The old render loop: one growing array, appended cell by cell
+static void buildTilesSingle(std::vector<BenchVertex>& out, const std::vector<uint8_t>& tiles, const TileUV* uvs,
+                             int n, float cellSize) {
+    out.clear();
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+            BenchVertex q[4];
+            setTileQuad(q, j * cellSize, i * cellSize, cellSize, uvs[tiles[i * n + j]]);
+            for (int k = 0; k < 4; k++) out.push_back(q[k]);
+        }
+    }
+}
+
+static bool sameChunks(const ChunkedTiles<BenchVertex>& a, const ChunkedTiles<BenchVertex>& b) {
+    if (a.chunkCount() != b.chunkCount()) return false;
+    for (int c = 0; c < a.chunkCount(); c++) {
+        if (a.chunks[c].size() != b.chunks[c].size() ||
+            memcmp(a.chunks[c].data(), b.chunks[c].data(), a.chunks[c].size() * sizeof(BenchVertex)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void benchRender() {
+    printf("== render ==\n");
+    TileUV uvs[2] = {tileUV(0, 0, 32, 32), tileUV(32, 0, 32, 32)};
+    int maxThreads = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    if (maxThreads < 4) maxThreads = 4;
+    const int sizes[] = {1024, 2048, 4096};
+    for (int s = 0; s < 3; s++) {
+        int n = sizes[s];
+        std::vector<uint8_t> tiles(static_cast<size_t>(n) * n, 0);
+        Rng rng = rngStream(5, RNG_STREAM_VISUAL);
+        for (size_t c = 0; c < tiles.size(); c++) tiles[c] = rng.below(4) == 0 ? 1 : 0;
+        float cellSize = 600.0f / n;
+        int frames = n >= 4096 ? 3 : 10;
+
+        std::vector<BenchVertex> single;
+        buildTilesSingle(single, tiles, uvs, n, cellSize);   // warm up
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int f = 0; f < frames; f++) buildTilesSingle(single, tiles, uvs, n, cellSize);
+        double singleMs = elapsedMs(start) / frames;
+
+        ChunkedTiles<BenchVertex> serial;
+        serial.layout(n);
+        serial.tiles = tiles.data();
+        serial.uvs = uvs;
+        serial.cellSize = cellSize;
+        buildTileChunks(serial, static_cast<ThreadPool*>(nullptr));
+        start = std::chrono::steady_clock::now();
+        for (int f = 0; f < frames; f++) buildTileChunks(serial, static_cast<ThreadPool*>(nullptr));
+        double serialMs = elapsedMs(start) / frames;
+        printf("N=%d  %d chunks  single array %7.2f ms  chunked serial %7.2f ms\n", n, serial.chunkCount(),
+               singleMs, serialMs);
+
+        bool same = true;
+        for (int threads = 1; threads <= maxThreads; threads *= 2) {
+            ThreadPool pool;
+            pool.start(threads);
+            ChunkedTiles<BenchVertex> parallel;
+            parallel.layout(n);
+            parallel.tiles = tiles.data();
+            parallel.uvs = uvs;
+            parallel.cellSize = cellSize;
+            buildTileChunks(parallel, &pool);
+            start = std::chrono::steady_clock::now();
+            for (int f = 0; f < frames; f++) buildTileChunks(parallel, &pool);
+            double ms = elapsedMs(start) / frames;
+            same = same && sameChunks(serial, parallel);
+            printf("       %2d threads %7.2f ms  x%.2f vs single array\n", threads, ms, singleMs / ms);
+        }
+        printf("       same vertices for every thread count: %s\n", same ? "yes" : "NO");
+    }
+}
+
+struct JitterJob {
+    std::atomic<bool>* stop;
+    int periods;
+    std::vector<long long> lateUs;
+};
+
+// Wakes up every millisecond on an absolute deadline, like the input
+// threads polling the keyboard, and records how late each wake-up was
+static void* jitterWorker(void* arg) {
+    JitterJob* job = static_cast<JitterJob*>(arg);
+    timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (int i = 0; i < job->periods; i++) {
+        next.tv_nsec += 1000000;
+        if (next.tv_nsec >= 1000000000) {
+            next.tv_nsec -= 1000000000;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        job->lateUs.push_back(((now.tv_sec - next.tv_sec) * 1000000000LL + now.tv_nsec - next.tv_nsec) / 1000);
+    }
+    return nullptr;
+}
+
+static void* busyWorker(void* arg) {
+    std::atomic<bool>* stop = static_cast<std::atomic<bool>*>(arg);
+    volatile uint64_t x = 0;
+    while (!*stop) x = x + 1;
+    return nullptr;
+}
+
+static void runJitter(const char* name, int loadThreads) {
+    std::atomic<bool> stop(false);
+    std::vector<pthread_t> load(loadThreads);
+    for (int t = 0; t < loadThreads; t++) createRoleThread(&load[t], ROLE_WORKER, t, busyWorker, &stop);
+    JitterJob job;
+    job.stop = &stop;
+    job.periods = 2000;
+    pthread_t thread;
+    createRoleThread(&thread, ROLE_INPUT, 0, jitterWorker, &job);
+    pthread_join(thread, nullptr);
+    stop = true;
+    for (int t = 0; t < loadThreads; t++) pthread_join(load[t], nullptr);
+
+    std::sort(job.lateUs.begin(), job.lateUs.end());
+    size_t n = job.lateUs.size();
+    printf("%-28s late p50 %5lld us  p99 %6lld us  max %6lld us\n", name, job.lateUs[n / 2],
+           job.lateUs[n * 99 / 100], job.lateUs[n - 1]);
+}
+
+static void resetThreadConfig() {
+    for (int r = 0; r < ROLE_COUNT; r++) {
+        ThreadRoleConfig& cfg = threadConfig().roles[r];
+        cfg.pinned = false;
+        cfg.fifoPriority = 0;
+        cfg.niced = false;
+    }
+}
+
+// Wake-up jitter of a 1 kHz input-role thread while pool-role threads keep
+// every core busy, under each placement option
+static void benchThreads() {
+    printf("== threads ==\n");
+    int cpus = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    int loadThreads = 2 * cpus;
+    char loadCpus[32], inputCpu[32];
+    snprintf(inputCpu, sizeof(inputCpu), "input=0");
+    if (cpus > 1) {
+        snprintf(loadCpus, sizeof(loadCpus), "pool=1-%d", cpus - 1);
+    } else {
+        snprintf(loadCpus, sizeof(loadCpus), "pool=0");
+    }
+
+    resetThreadConfig();
+    runJitter("idle", 0);
+    runJitter("loaded, default", loadThreads);
+
+    parseThreadOption("--pin", inputCpu);
+    parseThreadOption("--pin", loadCpus);
+    runJitter(cpus > 1 ? "loaded, input pinned apart" : "loaded, pinned (1 cpu)", loadThreads);
+
+    resetThreadConfig();
+    parseThreadOption("--nice", "pool=19");
+    runJitter("loaded, pool nice 19", loadThreads);
+
+    resetThreadConfig();
+    parseThreadOption("--fifo", "input=50");
+    runJitter("loaded, input SCHED_FIFO 50", loadThreads);
+    resetThreadConfig();
+}
+
+struct ScoreEvent {
+    int player;
+    int delta;
+};
+
+// Player threads post score events in batches; the leaderboard owner swaps
+// the pending batch out once per frame, like the move queue in the game
+struct ScoreFeed {
+    pthread_mutex_t lock;
+    std::vector<ScoreEvent> pending;
+    std::atomic<bool> stop;
+};
+
+struct ScoreProducer {
+    ScoreFeed* feed;
+    int index;
+    int players;
+    long long events;
+};
+
+static void* scoreProducer(void* arg) {
+    ScoreProducer* job = static_cast<ScoreProducer*>(arg);
+    Rng rng = rngStream(17, RNG_STREAM_PLAYER, static_cast<uint64_t>(job->index));
+    std::vector<ScoreEvent> batch;
+    while (!job->feed->stop) {
+        for (int i = 0; i < 64; i++) {
+            ScoreEvent e = {static_cast<int>(rng.below(job->players)), 1 + static_cast<int>(rng.below(3))};
+            batch.push_back(e);
+        }
+        pthread_mutex_lock(&job->feed->lock);
+        job->feed->pending.insert(job->feed->pending.end(), batch.begin(), batch.end());
+        pthread_mutex_unlock(&job->feed->lock);
+        job->events += static_cast<long long>(batch.size());
+        batch.clear();
+        usleep(1000);   // 64 scores a millisecond per thread
+    }
+    return nullptr;
+}
+
+// Every rank and every player position agree with a full sort
+static bool leaderboardMatchesSort(const Leaderboard& board) {
+    std::vector<int> order(board.size());
+    for (int p = 0; p < board.size(); p++) order[p] = p;
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        return board.score(a) != board.score(b) ? board.score(a) > board.score(b) : a < b;
+    });
+    for (int r = 0; r < board.size(); r++) {
+        if (board.at(r) != order[r] || board.rank(order[r]) != r) return false;
+    }
+    return true;
+}
+
+static void benchLeaderboard() {
+    printf("== leaderboard ==\n");
+    const int counts[] = {1000, 10000, 100000};
+    for (int c = 0; c < 3; c++) {
+        int n = counts[c];
+        Leaderboard board;
+        board.reset(n);
+        Rng rng = rngStream(3, RNG_STREAM_PLAYER);
+        const int updates = 1000000;
+        std::vector<ScoreEvent> events(updates);
+        for (int i = 0; i < updates; i++) {
+            events[i].player = static_cast<int>(rng.below(n));
+            events[i].delta = 1 + static_cast<int>(rng.below(3));
+        }
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int i = 0; i < updates; i++) board.add(events[i].player, events[i].delta);
+        double updateNs = elapsedMs(start) * 1e6 / updates;
+
+        int sink = 0;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < updates; i++) sink += board.rank(events[i].player);
+        double rankNs = elapsedMs(start) * 1e6 / updates;
+
+        int top[10];
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 100000; i++) sink += board.top(10, top);
+        double topNs = elapsedMs(start) * 1e6 / 100000;
+
+        // What the HUD would pay re-sorting everyone each frame
+        std::vector<int> order(n);
+        start = std::chrono::steady_clock::now();
+        for (int f = 0; f < 20; f++) {
+            for (int p = 0; p < n; p++) order[p] = p;
+            std::sort(order.begin(), order.end(), [&](int a, int b) {
+                return board.score(a) != board.score(b) ? board.score(a) > board.score(b) : a < b;
+            });
+        }
+        double sortUs = elapsedMs(start) * 1000 / 20;
+        printf("%6d players  update %5.0f ns  rank %5.0f ns  top-10 %5.0f ns  full sort %8.1f us  matches sort %s%s\n",
+               n, updateNs, rankNs, topNs, sortUs, leaderboardMatchesSort(board) ? "yes" : "NO", sink == -1 ? " " : "");
+    }
+
+    // Thousands of players scoring from several threads at once; the owner
+    // applies everything posted since the last frame, 1000 frames a second
+    int maxThreads = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    if (maxThreads < 4) maxThreads = 4;
+    const int players = 5000;
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        ScoreFeed feed;
+        pthread_mutex_init(&feed.lock, nullptr);
+        feed.stop = false;
+        Leaderboard board;
+        board.reset(players);
+        std::vector<ScoreProducer> jobs(threads);
+        std::vector<pthread_t> workers(threads);
+        for (int t = 0; t < threads; t++) {
+            ScoreProducer job = {&feed, t, players, 0};
+            jobs[t] = job;
+            pthread_create(&workers[t], nullptr, scoreProducer, &jobs[t]);
+        }
+        std::vector<ScoreEvent> frameEvents;
+        double applyMs = 0, worstMs = 0;
+        long long applied = 0;
+        const int frames = 500;
+        for (int f = 0; f < frames; f++) {
+            usleep(1000);
+            pthread_mutex_lock(&feed.lock);
+            frameEvents.swap(feed.pending);
+            pthread_mutex_unlock(&feed.lock);
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < frameEvents.size(); i++) board.add(frameEvents[i].player, frameEvents[i].delta);
+            double ms = elapsedMs(start);
+            applyMs += ms;
+            if (ms > worstMs) worstMs = ms;
+            applied += static_cast<long long>(frameEvents.size());
+            frameEvents.clear();
+        }
+        feed.stop = true;
+        for (int t = 0; t < threads; t++) pthread_join(workers[t], nullptr);
+        pthread_mutex_destroy(&feed.lock);
+        printf("%d players, %d scoring threads  %8lld events applied  %.3f ms/frame (max %.3f)  matches sort %s\n",
+               players, threads, applied, applyMs / frames, worstMs, leaderboardMatchesSort(board) ? "yes" : "NO");
+    }
+}
+
+struct EventLogJob {
+    int batches;
+    int perBatch;
+};
+
+// Logs perBatch events every millisecond, about the rate of a busy server
+// worker
+static void* eventLogWorker(void* arg) {
+    EventLogJob* job = static_cast<EventLogJob*>(arg);
+    for (int b = 0; b < job->batches; b++) {
+        for (int i = 0; i < job->perBatch; i++) logEvent(EVENT_MOVE, i & 1, b, i);
+        usleep(1000);
+    }
+    return nullptr;
+}
+
+// Records in the live file and its rotations, checking each thread's
+// records come back in the order they were logged
+static long long countLoggedRecords(const char* path, int keep, bool& ordered) {
+    long long total = 0;
+    ordered = true;
+    for (int i = keep - 1; i >= 0; i--) {
+        std::string file = i == 0 ? std::string(path) : std::string(path) + "." + std::to_string(i);
+        FILE* f = fopen(file.c_str(), "rb");
+        if (!f) continue;
+        EventFileHeader header;
+        if (fread(&header, sizeof(header), 1, f) == 1 && header.magic == EVENTLOG_MAGIC) {
+            uint64_t last[EVENTLOG_MAX_THREADS] = {0};
+            EventRecord r;
+            while (fread(&r, sizeof(r), 1, f) == 1) {
+                if (r.type == EVENT_DROPPED) continue;
+                if (r.thread >= EVENTLOG_MAX_THREADS || r.timeNs < last[r.thread]) ordered = false;
+                else last[r.thread] = r.timeNs;
+                total++;
+            }
+        }
+        fclose(f);
+    }
+    return total;
+}
+
+static void benchEventLog() {
+    printf("== eventlog ==\n");
+    const char* path = "/tmp/maga_bench.evlog";
+    EventLog& log = eventLog();
+    const int iterations = 2000000;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) logEvent(EVENT_MOVE, 0, i, i);
+    double offNs = elapsedMs(start) * 1e6 / iterations;
+
+    // Fits in the ring between two flushes, so none are dropped
+    if (!log.open(path)) {
+        printf("cannot open %s\n", path);
+        return;
+    }
+    const int burst = EVENTLOG_RING_RECORDS / 2;
+    double onNs = 0;
+    for (int rep = 0; rep < 20; rep++) {
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < burst; i++) logEvent(EVENT_MOVE, 0, i, i);
+        onNs += elapsedMs(start) * 1e6;
+        usleep(2 * EVENTLOG_FLUSH_MS * 1000);
+    }
+    printf("log event  closed %5.2f ns  open %5.2f ns\n", offNs, onNs / (20 * burst));
+
+    // The same match with the log closed and open, best of three each;
+    // every move, pickup and spawn is logged
+    log.close();
+    double closedUs = 1e30, openUs = 1e30;
+    uint64_t before = log.recordsWritten;
+    for (int rep = 0; rep < 3; rep++) {
+        MatchState match;
+        double us = runEcsMatch(match, false, 0, nullptr);
+        if (us < closedUs) closedUs = us;
+        log.open(path);
+        us = runEcsMatch(match, false, 0, nullptr);
+        log.close();
+        if (us < openUs) openUs = us;
+    }
+    printf("ecs match  closed %6.2f us/frame  open %6.2f us/frame  (%.1f events/frame)\n", closedUs, openUs,
+           static_cast<double>(log.recordsWritten - before) / (3 * 3600));
+
+    // Several threads at a steady rate, rotating every megabyte
+    int maxThreads = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    if (maxThreads < 4) maxThreads = 4;
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        uint64_t droppedBefore = log.dropped();
+        uint64_t rotationsBefore = log.rotations;
+        if (!log.open(path, 1 << 20, 64)) {
+            printf("cannot open %s\n", path);
+            return;
+        }
+        std::vector<EventLogJob> jobs(threads);
+        std::vector<pthread_t> workers(threads);
+        start = std::chrono::steady_clock::now();
+        for (int t = 0; t < threads; t++) {
+            EventLogJob job = {500, 100};
+            jobs[t] = job;
+            pthread_create(&workers[t], nullptr, eventLogWorker, &jobs[t]);
+        }
+        for (int t = 0; t < threads; t++) pthread_join(workers[t], nullptr);
+        double ms = elapsedMs(start);
+        log.close();
+        long long logged = static_cast<long long>(threads) * 500 * 100;
+        bool ordered;
+        long long onDisk = countLoggedRecords(path, 64, ordered);
+        printf("%d threads  %8lld events  %6.0f k/s  dropped %llu  on disk %lld  rotations %llu  in order %s\n",
+               threads, logged, logged / ms, static_cast<unsigned long long>(log.dropped() - droppedBefore), onDisk,
+               static_cast<unsigned long long>(log.rotations - rotationsBefore), ordered ? "yes" : "NO");
+        for (int i = 1; i < 64; i++) unlink((std::string(path) + "." + std::to_string(i)).c_str());
+    }
+    unlink(path);
+}
+
+struct NetRunResult {
+    double downBytesPerClient, upBytesPerClient;   // per second
+    LatencyHistogram tickToScreen;
+    LatencyHistogram tickCost;
+    uint64_t full, delta, discarded;
+    bool consistent;
+};
+
+// clients headless players on 127.0.0.1 against an in-process server, each
+// drawing at 60 fps and wandering in a direction it changes every half
+// second. dropEvery > 0 makes every client discard that share of snapshots.
+static NetRunResult runNet(int clients, bool deltas, unsigned dropEvery, int seconds) {
+    NetRunResult result;
+    NetServer server;
+    server.seed = 5;
+    server.deltas = deltas;
+    if (!server.start(0)) {
+        printf("cannot start the server\n");
+        result.consistent = false;
+        return result;
+    }
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(static_cast<uint16_t>(server.port));
+
+    std::vector<NetClient> players(clients);
+    std::vector<unsigned> held(clients, 0);
+    Rng rng = rngStream(5, RNG_STREAM_PLAYER);
+    for (int c = 0; c < clients; c++) {
+        players[c].dropEvery = dropEvery;
+        if (!players[c].connect(addr, 2000)) printf("client %d could not connect\n", c);
+    }
+
+    const int64_t frameUs = 1000000 / 60;
+    int64_t startUs = monotonicMicros(), nextUs = startUs;
+    for (int f = 0; f < seconds * 60; f++) {
+        for (int c = 0; c < clients; c++) {
+            players[c].receive();
+            if (f % 30 == c % 30) held[c] = DIR_BIT(static_cast<int>(rng.below(4)));
+            players[c].sendInput(held[c]);
+            NetView view;
+            players[c].view(monotonicMicros(), view);
+        }
+        nextUs += frameUs;
+        int64_t waitUs = nextUs - monotonicMicros();
+        if (waitUs > 0) usleep(static_cast<useconds_t>(waitUs));
+    }
+    double elapsed = (monotonicMicros() - startUs) / 1e6;
+    for (int c = 0; c < clients; c++) players[c].receive();
+    server.stop();
+
+    // Each client's newest decoded state must equal what the server sent
+    result.consistent = true;
+    uint64_t down = 0, up = 0;
+    result.discarded = 0;
+    for (int c = 0; c < clients; c++) {
+        down += players[c].traffic.bytesIn;
+        up += players[c].traffic.bytesOut;
+        result.tickToScreen.merge(players[c].tickToScreen);
+        result.discarded += players[c].discarded;
+        const NetPeer& peer = server.peers[players[c].clientId];
+        const NetState& mine = players[c].states[players[c].newestTick & (NET_HISTORY - 1)];
+        const NetState& sent = server.matches[peer.match]->history[players[c].newestTick & (NET_HISTORY - 1)];
+        if (server.tick - players[c].newestTick >= NET_HISTORY || !sameNetState(mine, sent)) result.consistent = false;
+    }
+    result.downBytesPerClient = down / elapsed / clients;
+    result.upBytesPerClient = up / elapsed / clients;
+    result.tickCost = server.tickCost;
+    result.full = server.fullSnapshots;
+    result.delta = server.deltaSnapshots;
+    return result;
+}
+
+static void benchNet() {
+    printf("== net ==\n");
+    const int counts[] = {2, 4, 8, 16, 32, 64};
+    for (int i = 0; i < 6; i++) {
+        NetRunResult d = runNet(counts[i], true, 0, 3);
+        NetRunResult f = runNet(counts[i], false, 0, 3);
+        printf("%2d clients  down %5.0f B/s (full %5.0f)  up %4.0f B/s  tick p50 %5.1f p99 %6.1f us"
+               "  tick-to-screen p50 %4.1f p99 %5.1f ms  state ok %s\n",
+               counts[i], d.downBytesPerClient, f.downBytesPerClient, d.upBytesPerClient,
+               d.tickCost.percentile(0.5) / 1000.0, d.tickCost.percentile(0.99) / 1000.0,
+               d.tickToScreen.percentile(0.5) / 1e6, d.tickToScreen.percentile(0.99) / 1e6,
+               d.consistent && f.consistent ? "yes" : "NO");
+    }
+    // One snapshot in five lost: deltas stay against acknowledged states
+    NetRunResult lossy = runNet(8, true, 5, 3);
+    printf("8 clients, 20%% snapshot loss  down %5.0f B/s  snapshots %llu delta / %llu full  discarded %llu  state ok %s\n",
+           lossy.downBytesPerClient, static_cast<unsigned long long>(lossy.delta),
+           static_cast<unsigned long long>(lossy.full), static_cast<unsigned long long>(lossy.discarded),
+           lossy.consistent ? "yes" : "NO");
+}
+
+// An actor that does a step of work every tick
+static CoTask tickActor(CoScheduler& actors, std::atomic<long long>& steps, int ticks) {
+    for (int t = 0; t < ticks; t++) {
+        co_await actors.nextTick();
+        steps.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// An actor waiting for an input event that never comes
+static CoTask idleActor(CoEvent& event) {
+    co_await event.wait(event.version());
+}
+
+// An actor sleeping a random 0.1 to 1 seconds of game time, repeatedly
+static CoTask timerActor(CoScheduler& actors, std::atomic<long long>& fired, uint64_t seed) {
+    Rng rng(seed);
+    for (;;) {
+        co_await actors.sleepFor(0.1 + rng.below(900) / 1000.0);
+        fired.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+struct TickThreads {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint64_t tick;
+    int done;
+    bool stop;
+};
+
+// The thread-per-actor equivalent of tickActor
+static void* tickThread(void* arg) {
+    TickThreads* shared = static_cast<TickThreads*>(arg);
+    uint64_t seen = 0;
+    pthread_mutex_lock(&shared->lock);
+    for (;;) {
+        while (shared->tick == seen && !shared->stop) pthread_cond_wait(&shared->cond, &shared->lock);
+        if (shared->stop) break;
+        seen = shared->tick;
+        shared->done++;
+        pthread_cond_broadcast(&shared->cond);
+    }
+    pthread_mutex_unlock(&shared->lock);
+    return nullptr;
+}
+
+static double runThreadTicks(int threads, int ticks) {
+    TickThreads shared;
+    pthread_mutex_init(&shared.lock, nullptr);
+    pthread_cond_init(&shared.cond, nullptr);
+    shared.tick = 0;
+    shared.done = 0;
+    shared.stop = false;
+    std::vector<pthread_t> workers(threads);
+    for (int t = 0; t < threads; t++) pthread_create(&workers[t], nullptr, tickThread, &shared);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int t = 0; t < ticks; t++) {
+        pthread_mutex_lock(&shared.lock);
+        shared.done = 0;
+        shared.tick++;
+        pthread_cond_broadcast(&shared.cond);
+        while (shared.done < threads) pthread_cond_wait(&shared.cond, &shared.lock);
+        pthread_mutex_unlock(&shared.lock);
+    }
+    double ms = elapsedMs(start);
+    pthread_mutex_lock(&shared.lock);
+    shared.stop = true;
+    pthread_cond_broadcast(&shared.cond);
+    pthread_mutex_unlock(&shared.lock);
+    for (int t = 0; t < threads; t++) pthread_join(workers[t], nullptr);
+    pthread_cond_destroy(&shared.cond);
+    pthread_mutex_destroy(&shared.lock);
+    return ms / ticks;
+}
+
+static void benchCoro() {
+    printf("== coro ==\n");
+    int maxThreads = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    if (maxThreads < 2) maxThreads = 2;
+
+    // Every actor resumes once per tick
+    const int counts[] = {1000, 10000, 100000};
+    for (int i = 0; i < 3; i++) {
+        for (int threads = 1; threads <= maxThreads; threads *= 2) {
+            const int ticks = 20;
+            std::atomic<long long> steps(0);
+            CoScheduler actors;
+            actors.start(threads);
+            long long bytesBefore = coFrameBytes();
+            for (int a = 0; a < counts[i]; a++) actors.spawn(tickActor(actors, steps, ticks));
+            actors.waitIdle();
+            double frameBytes = static_cast<double>(coFrameBytes() - bytesBefore) / counts[i];
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (int t = 0; t < ticks; t++) {
+                actors.advanceTick();
+                actors.waitIdle();
+            }
+            double ms = elapsedMs(start);
+            printf("%6d tick actors, %d threads  %7.3f ms/tick  %6.1f ns/resume  frame %4.0f bytes  steps ok %s\n",
+                   counts[i], threads, ms / ticks, ms * 1e6 / (static_cast<double>(ticks) * counts[i]), frameBytes,
+                   steps == static_cast<long long>(ticks) * counts[i] ? "yes" : "NO");
+        }
+    }
+
+    // Actors waiting on input cost nothing per tick
+    for (int i = 0; i < 3; i++) {
+        const int ticks = 1000;
+        std::atomic<long long> steps(0);
+        CoScheduler actors;
+        CoEvent input(&actors);
+        actors.start(1);
+        for (int a = 0; a < counts[i]; a++) actors.spawn(idleActor(input));
+        for (int a = 0; a < 2; a++) actors.spawn(tickActor(actors, steps, ticks));
+        actors.waitIdle();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int t = 0; t < ticks; t++) {
+            actors.advanceTick();
+            actors.waitIdle();
+        }
+        double tickUs = elapsedMs(start) * 1000 / ticks;
+        start = std::chrono::steady_clock::now();
+        input.notify();
+        actors.waitIdle();
+        printf("%6d idle actors + 2 ticking  %6.2f us/tick  one event wakes all in %7.3f ms  left %zu\n", counts[i],
+               tickUs, elapsedMs(start), actors.actors());
+    }
+
+    // Thread per actor, woken by a condition broadcast each tick
+    const int threadCounts[] = {100, 1000};
+    for (int i = 0; i < 2; i++) {
+        int n = threadCounts[i];
+        double threadMs = runThreadTicks(n, 50);
+        std::atomic<long long> steps(0);
+        CoScheduler actors;
+        actors.start(1);
+        for (int a = 0; a < n; a++) actors.spawn(tickActor(actors, steps, 50));
+        actors.waitIdle();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int t = 0; t < 50; t++) {
+            actors.advanceTick();
+            actors.waitIdle();
+        }
+        printf("%5d actors  threads %8.3f ms/tick  coroutines %7.3f ms/tick\n", n, threadMs, elapsedMs(start) / 50);
+    }
+
+    // Timers: each actor sleeps a random 0.1..1 s, the clock moves 1/60 s a tick
+    for (int i = 0; i < 3; i++) {
+        std::atomic<long long> fired(0);
+        CoScheduler actors;
+        actors.start(1);
+        for (int a = 0; a < counts[i]; a++) actors.spawn(timerActor(actors, fired, a + 1));
+        actors.waitIdle();
+        const int ticks = 300;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int t = 1; t <= ticks; t++) {
+            actors.advanceClock(t / 60.0);
+            actors.waitIdle();
+        }
+        double ms = elapsedMs(start);
+        printf("%6d timer actors  %8lld fired  %7.3f ms/tick  %6.1f ns/timer\n", counts[i], fired.load(), ms / ticks,
+               fired ? ms * 1e6 / fired : 0.0);
+    }
+}
+
+// Pushes a file out of the page cache so the next reads come from disk
+static void dropFileCache(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+// Pages of the mapping that are in memory
+static size_t residentPages(const LevelFile& level) {
+    size_t pages = (level.length + LEVEL_PAGE - 1) / LEVEL_PAGE;
+    std::vector<unsigned char> in(pages);
+    if (mincore(const_cast<uint8_t*>(level.base), level.length, in.data()) != 0) return 0;
+    size_t count = 0;
+    for (size_t i = 0; i < pages; i++) count += in[i] & 1;
+    return count;
+}
+
+static bool sameCrates(const MatchState& a, const MatchState& b) {
+    std::vector<int> ca, cb;
+    a.world.each(COMP_POSITION | COMP_OBSTACLE, 0, [&](const Archetype& arch) {
+        for (int r = 0; r < arch.size(); r++) ca.push_back(arch.positions[r].x * 1000 + arch.positions[r].y);
+    });
+    b.world.each(COMP_POSITION | COMP_OBSTACLE, 0, [&](const Archetype& arch) {
+        for (int r = 0; r < arch.size(); r++) cb.push_back(arch.positions[r].x * 1000 + arch.positions[r].y);
+    });
+    std::sort(ca.begin(), ca.end());
+    std::sort(cb.begin(), cb.end());
+    return ca == cb;
+}
+
+static void benchLevel() {
+    printf("== level ==\n");
+    const char* path = "/tmp/maga_bench.lvl";
+
+    // A baked game map plays the same crates as the generator
+    bool same = true;
+    for (uint64_t seed = 1; seed <= 50; seed++) {
+        MapConfig cfg;
+        cfg.size = 15 + static_cast<int>(seed % 11);
+        cfg.seed = seed;
+        cfg.obstacleCount = MAX_CRATES;
+        cfg.starts.push_back(std::make_pair(1, 1));
+        cfg.starts.push_back(std::make_pair(cfg.size - 2, cfg.size - 2));
+        GameMap walls;
+        std::vector<LevelPoint> crates;
+        bakeLevelLayers(generateMap(cfg), true, walls, crates);
+        std::vector<LevelPoint> spawns(2);
+        spawns[0].x = spawns[0].y = 1;
+        spawns[1].x = spawns[1].y = static_cast<uint16_t>(cfg.size - 2);
+        LevelFile level;
+        MatchState generated, loaded;
+        setupMatch(generated, seed, cfg.size);
+        same = same && writeLevelFile(path, walls, crates, spawns, seed) && level.open(path) &&
+               setupMatchFromLevel(loaded, level, seed) && sameCrates(generated, loaded);
+    }
+    printf("baked game maps match the generator: %s\n", same ? "yes" : "NO");
+
+    // Huge caves: open, one 256x256 window, and everything
+    const int sizes[] = {2048, 8192};
+    for (int s = 0; s < 2; s++) {
+        int N = sizes[s];
+        MapConfig cfg;
+        cfg.type = MAP_CAVES;
+        cfg.size = N;
+        cfg.seed = 7;
+        cfg.minComponentSize = 32;
+        cfg.threads = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+        GameMap map = generateMap(cfg);
+        std::vector<LevelPoint> spawns(1);
+        spawns[0].x = spawns[0].y = 1;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        writeLevelFile(path, map, std::vector<LevelPoint>(), spawns, cfg.seed);
+        double writeMs = elapsedMs(start);
+        dropFileCache(path);
+
+        LevelFile level;
+        start = std::chrono::steady_clock::now();
+        if (!level.open(path)) {
+            printf("cannot open %s\n", path);
+            return;
+        }
+        double openUs = elapsedMs(start) * 1000;
+        size_t pages = (level.length + LEVEL_PAGE - 1) / LEVEL_PAGE;
+        size_t afterOpen = residentPages(level);
+
+        std::vector<uint8_t> window;
+        start = std::chrono::steady_clock::now();
+        level.readRegion(N / 2, N / 2, N / 2 + 256, N / 2 + 256, window);
+        double windowMs = elapsedMs(start);
+        size_t afterWindow = residentPages(level);
+
+        start = std::chrono::steady_clock::now();
+        level.readRegion(0, 0, N, N, window);
+        double allMs = elapsedMs(start);
+        bool matches = window == map.cells;
+
+        printf("N=%-5d write %7.1f ms  %7.2f MB (%4.1f%% of a byte per cell)  open %6.1f us  pages %zu after open,"
+               " %zu after a 256x256 window (%.1f ms) of %zu  whole map %7.1f ms  matches %s\n",
+               N, writeMs, level.length / 1048576.0, 100.0 * level.length / (static_cast<double>(N) * N), openUs,
+               afterOpen, afterWindow, windowMs, pages, allMs, matches ? "yes" : "NO");
+    }
+
+    // Crates in a window, with and without the chunk index
+    {
+        int N = 4096;
+        MapConfig cfg;
+        cfg.size = N;
+        cfg.seed = 3;
+        cfg.obstacleCount = N * N / 5;
+        cfg.threads = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+        GameMap walls;
+        std::vector<LevelPoint> crates;
+        bakeLevelLayers(generateMap(cfg), true, walls, crates);
+        std::vector<LevelPoint> spawns;
+        for (int indexed = 1; indexed >= 0; indexed--) {
+            writeLevelFile(path, walls, crates, spawns, cfg.seed, LEVEL_DEFAULT_CHUNK, indexed != 0);
+            LevelFile level;
+            level.open(path);
+            long long found = 0;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (int w = 0; w < 16; w++) {
+                int x0 = 1 + w * 200;
+                level.forEachCrate(x0, x0, x0 + 256, x0 + 256, [&](int, int) { found++; });
+            }
+            printf("%zu crates, 256x256 window %s  %8.3f ms  %lld found\n", crates.size(),
+                   indexed ? "indexed " : "scanned ", elapsedMs(start) / 16, found / 16);
+        }
+    }
+    unlink(path);
+}
+
+static void benchSpatial() {
+    printf("== spatial ==\n");
+    const int sides[] = {1024, 4096, 16384};
+    const double densities[] = {0.0001, 0.001, 0.01};
+    for (int si = 0; si < 3; si++) {
+        for (int di = 0; di < 3; di++) {
+            int side = sides[si];
+            int items = static_cast<int>(static_cast<double>(side) * side * densities[di]);
+            Rng rng(side + di);
+            std::vector<int> xs(items), ys(items);
+            for (int i = 0; i < items; i++) {
+                xs[i] = static_cast<int>(rng.below(side));
+                ys[i] = static_cast<int>(rng.below(side));
+            }
+
+            SpatialHash<int> hash;
+            std::vector<uint32_t> handles(items);
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (int i = 0; i < items; i++) handles[i] = hash.insert(xs[i], ys[i], i);
+            double insertNs = elapsedMs(start) * 1e6 / items;
+
+            // Everything takes one step in a random direction
+            start = std::chrono::steady_clock::now();
+            for (int i = 0; i < items; i++) {
+                int dx, dy;
+                dirToDelta(static_cast<int>(rng.below(4)), dx, dy);
+                xs[i] = std::min(side - 1, std::max(0, xs[i] + dx));
+                ys[i] = std::min(side - 1, std::max(0, ys[i] + dy));
+                hash.move(handles[i], xs[i], ys[i]);
+            }
+            double moveNs = elapsedMs(start) * 1e6 / items;
+
+            // Magnet pickups: everything within 4 cells of a random point
+            const int queries = 200000;
+            std::vector<int> qx(queries), qy(queries);
+            for (int q = 0; q < queries; q++) {
+                qx[q] = static_cast<int>(rng.below(side));
+                qy[q] = static_cast<int>(rng.below(side));
+            }
+            long long found = 0;
+            start = std::chrono::steady_clock::now();
+            for (int q = 0; q < queries; q++) {
+                hash.queryRadius(qx[q], qy[q], 4, [&](uint32_t, const SpatialHash<int>::Entry&) { found++; });
+            }
+            double radiusNs = elapsedMs(start) * 1e6 / queries;
+
+            // The old way, comparing every item, on the first of the same
+            // points; each must find what the hash found there
+            const int scans = items > 100000 ? 20 : 200;
+            long long scanned = 0;
+            start = std::chrono::steady_clock::now();
+            for (int q = 0; q < scans; q++) {
+                long long here = 0;
+                for (int i = 0; i < items; i++) {
+                    int dx = xs[i] - qx[q], dy = ys[i] - qy[q];
+                    here += dx * dx + dy * dy <= 16;
+                }
+                scanned += here;
+            }
+            double scanNs = elapsedMs(start) * 1e6 / scans;
+            long long hashed = 0;
+            for (int q = 0; q < scans; q++) {
+                hash.queryRadius(qx[q], qy[q], 4, [&](uint32_t, const SpatialHash<int>::Entry&) { hashed++; });
+            }
+            bool same = hashed == scanned;
+
+            long long inRect = 0;
+            start = std::chrono::steady_clock::now();
+            for (int q = 0; q < 1000; q++) {
+                int x0 = static_cast<int>(rng.below(side - 256)), y0 = static_cast<int>(rng.below(side - 256));
+                hash.queryRect(x0, y0, x0 + 255, y0 + 255, [&](uint32_t, const SpatialHash<int>::Entry&) { inRect++; });
+            }
+            double rectUs = elapsedMs(start);
+
+            start = std::chrono::steady_clock::now();
+            for (int i = 0; i < items; i++) hash.remove(handles[i]);
+            double removeNs = elapsedMs(start) * 1e6 / items;
+
+            double denseMb = static_cast<double>(side) * side * sizeof(uint32_t) / 1048576.0;
+            printf("%5d^2 %8d items  insert %5.1f move %5.1f remove %5.1f ns  r=4 %6.1f ns (%.2f found; scan %8.1f us, same %s)"
+                   "  256x256 %7.2f us (%6.1f found)  %7.1f MB vs dense %6.0f MB  empty %s\n",
+                   side, items, insertNs, moveNs, removeNs, radiusNs, static_cast<double>(found) / queries,
+                   scanNs / 1000, same ? "yes" : "NO", rectUs, inRect / 1000.0, hash.memoryBytes() / 1048576.0, denseMb,
+                   hash.empty() && hash.bucketCount() == 0 ? "yes" : "NO");
+        }
+    }
+}
+
+// Stand-in for a draw call: copies the vertices, as the driver uploads them
+static void submitVertices(std::vector<BenchVertex>& frameBuffer, const std::vector<BenchVertex>& vertices) {
+    frameBuffer.insert(frameBuffer.end(), vertices.begin(), vertices.end());
+}
+
+// Split screen on a 1200x1200 window at 16 px per cell, 1% of cells
+// holding a sprite. Shared: tiles and sprites built once per frame, every
+// view draws the chunks it overlaps. Per view: today's full loop (every
+// tile and sprite, built and drawn) once for each view.
+static void benchViews() {
+    printf("== views ==\n");
+    TileUV uvs[2] = {tileUV(0, 0, 32, 32), tileUV(32, 0, 32, 32)};
+    TileUV spriteUV = tileUV(64, 0, 32, 32);
+    const float cellSize = 16, windowPx = 1200;
+    const int sizes[] = {256, 1024};
+    const int maxViews = 8;
+    for (int s = 0; s < 2; s++) {
+        int n = sizes[s];
+        float boardPx = n * cellSize;
+        Rng rng = rngStream(9, RNG_STREAM_VISUAL);
+        std::vector<uint8_t> tiles(static_cast<size_t>(n) * n, 0);
+        for (size_t c = 0; c < tiles.size(); c++) tiles[c] = rng.below(4) == 0 ? 1 : 0;
+        std::vector<int> spriteRows, spriteCols;
+        for (int i = 0; i < n * n / 100; i++) {
+            spriteRows.push_back(static_cast<int>(rng.below(n)));
+            spriteCols.push_back(static_cast<int>(rng.below(n)));
+        }
+        int focusRow[maxViews], focusCol[maxViews];
+        for (int v = 0; v < maxViews; v++) {
+            focusRow[v] = static_cast<int>(rng.below(n));
+            focusCol[v] = static_cast<int>(rng.below(n));
+        }
+
+        ChunkedTiles<BenchVertex> grid;
+        grid.layout(n);
+        grid.tiles = tiles.data();
+        grid.uvs = uvs;
+        grid.cellSize = cellSize;
+        ChunkedSprites<BenchVertex> sprites;
+        sprites.layout(n, cellSize);
+        std::vector<BenchVertex> frameBuffer, single;
+        int frames = n >= 1024 ? 10 : 100;
+        double oneViewMs = 0;
+        bool complete = true;
+        for (int views = 1; views <= maxViews; views++) {
+            ViewportRect rects[maxViews];
+            for (int v = 0; v < views; v++) {
+                ViewportRect port = splitViewport(v, views);
+                float w = port.width * windowPx, h = port.height * windowPx;
+                ViewportRect world = {viewCentre((focusCol[v] + 0.5f) * cellSize, w, boardPx) - w / 2,
+                                      viewCentre((focusRow[v] + 0.5f) * cellSize, h, boardPx) - h / 2, w, h};
+                rects[v] = world;
+            }
+
+            size_t submitted = 0;
+            double buildMs = 0, drawMs = 0;
+            for (int f = -1; f < frames; f++) {   // frame -1 warms up
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                buildTileChunks(grid, static_cast<ThreadPool*>(nullptr));
+                sprites.clear();
+                for (size_t i = 0; i < spriteRows.size(); i++) sprites.add(spriteRows[i], spriteCols[i], spriteUV);
+                if (f >= 0) buildMs += elapsedMs(start);
+                start = std::chrono::steady_clock::now();
+                frameBuffer.clear();
+                for (int v = 0; v < views; v++) {
+                    const ViewportRect& w = rects[v];
+                    ChunkRange r = visibleChunks(grid.chunkCells, grid.chunksPerSide, cellSize, w.left, w.top, w.width,
+                                                 w.height);
+                    for (int cr = r.row0; cr < r.row1; cr++) {
+                        for (int cc = r.col0; cc < r.col1; cc++) submitVertices(frameBuffer, grid.chunks[cr * grid.chunksPerSide + cc]);
+                    }
+                    for (int cr = r.row0; cr < r.row1; cr++) {
+                        for (int cc = r.col0; cc < r.col1; cc++) submitVertices(frameBuffer, sprites.chunks[cr * sprites.chunksPerSide + cc]);
+                    }
+                }
+                if (f >= 0) drawMs += elapsedMs(start);
+                submitted = frameBuffer.size();
+            }
+            buildMs /= frames;
+            drawMs /= frames;
+            double sharedMs = buildMs + drawMs;
+            if (views == 1) oneViewMs = sharedMs;
+
+            // Every sprite whose cell overlaps a view must be in one of the
+            // chunks that view drew
+            for (int v = 0; v < views; v++) {
+                const ViewportRect& w = rects[v];
+                ChunkRange r = visibleChunks(grid.chunkCells, grid.chunksPerSide, cellSize, w.left, w.top, w.width,
+                                             w.height);
+                for (size_t i = 0; i < spriteRows.size(); i++) {
+                    float left = spriteCols[i] * cellSize, top = spriteRows[i] * cellSize;
+                    if (left + cellSize <= w.left || left >= w.left + w.width || top + cellSize <= w.top ||
+                        top >= w.top + w.height) {
+                        continue;
+                    }
+                    int cr = spriteRows[i] / grid.chunkCells, cc = spriteCols[i] / grid.chunkCells;
+                    complete = complete && cr >= r.row0 && cr < r.row1 && cc >= r.col0 && cc < r.col1;
+                }
+            }
+
+            int loopFrames = n >= 1024 ? 2 : 10;
+            buildTilesSingle(single, tiles, uvs, n, cellSize);   // warm up
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (int f = 0; f < loopFrames; f++) {
+                frameBuffer.clear();
+                for (int v = 0; v < views; v++) {
+                    buildTilesSingle(single, tiles, uvs, n, cellSize);
+                    for (size_t i = 0; i < spriteRows.size(); i++) {
+                        BenchVertex q[4];
+                        setTileQuad(q, spriteCols[i] * cellSize, spriteRows[i] * cellSize, cellSize, spriteUV);
+                        for (int k = 0; k < 4; k++) single.push_back(q[k]);
+                    }
+                    submitVertices(frameBuffer, single);
+                }
+            }
+            double perViewMs = elapsedMs(start) / loopFrames;
+            printf("N=%4d  %d view%s  shared: build %7.3f + draw %6.3f ms/frame (x%.2f vs 1 view, %6zu vertices)"
+                   "  per-view loop %8.2f ms/frame\n",
+                   n, views, views == 1 ? " " : "s", buildMs, drawMs, sharedMs / oneViewMs, submitted, perViewMs);
+        }
+        // A player halfway between cells 63 and 64 sits in the first chunk
+        // but shows in a view that starts at the second
+        sprites.clear();
+        float mid = grid.chunkCells - 0.5f;
+        sprites.add(mid, mid, spriteUV);
+        ChunkRange edge = visibleChunks(grid.chunkCells, grid.chunksPerSide, cellSize, grid.chunkCells * cellSize,
+                                        grid.chunkCells * cellSize, windowPx, windowPx);
+        bool between = sprites.used.size() == 1 && sprites.used[0] == 0 && edge.row0 == 0 && edge.col0 == 0 &&
+                       sprites.chunks[0][0].position.x == mid * cellSize;
+        printf("        every visible sprite drawn: %s, sprite between cells drawn at its position: %s\n",
+               complete ? "yes" : "NO", between ? "yes" : "NO");
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string only = argc > 1 ? argv[1] : "";
+    if (only.empty() || only == "mapgen") benchMapGen();
+    if (only.empty() || only == "connectivity") benchConnectivity();
+    if (only.empty() || only == "rng") benchRng();
+    if (only.empty() || only == "input") benchInput();
+    if (only.empty() || only == "board") benchBoard();
+    if (only.empty() || only == "export") benchExport();
+    if (only.empty() || only == "save") benchSave();
+    if (only.empty() || only == "ecs") benchEcs();
+    if (only.empty() || only == "rollout") benchRollout();
+    if (only.empty() || only == "capture") benchCapture();
+    if (only.empty() || only == "metrics") benchMetrics();
+    if (only.empty() || only == "render") benchRender();
+    if (only.empty() || only == "threads") benchThreads();
+    if (only.empty() || only == "leaderboard") benchLeaderboard();
+    if (only.empty() || only == "eventlog") benchEventLog();
+    if (only.empty() || only == "net") benchNet();
+    if (only.empty() || only == "coro") benchCoro();
+    if (only.empty() || only == "level") benchLevel();
+    if (only.empty() || only == "spatial") benchSpatial();
+    if (only.empty() || only == "views") benchViews();
+    return 0;
+}
@@ -0,0 +1,251 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+// Per-row bitboards for crates, items and players. Bit y of row x is cell
+// (x, y), matching the game's row/column convention. Boards up to 64 wide
+// keep every row in one machine word; wider boards fall back to several
+// 64-bit words per row.
+
+// Without -mpopcnt the builtin is a library call, so inline SWAR instead
+inline int popCount(uint64_t v) {
+#ifdef __POPCNT__
+    return __builtin_popcountll(v);
+#else
+    v = v - ((v >> 1) & 0x5555555555555555ULL);
+    v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+    v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return static_cast<int>((v * 0x0101010101010101ULL) >> 56);
+#endif
+}
+inline int lowestBit(uint64_t v) { return __builtin_ctzll(v); }
+
+// Position of the k-th (0-based) set bit of v
+inline int selectBit(uint64_t v, int k) {
+#ifdef __BMI2__
+    return lowestBit(_pdep_u64(1ULL << k, v));
+#else
+    int base = 0;
+    for (int c = popCount(v & 0xFF); k >= c; c = popCount(v & 0xFF)) {
+        k -= c;
+        v >>= 8;
+        base += 8;
+    }
+    for (int i = 0; i < k; i++) v &= v - 1;
+    return base + lowestBit(v);
+#endif
+}
+
+template <int N> struct BoardWord { typedef uint64_t type; };
+template <> struct BoardWord<8> { typedef uint8_t type; };
+template <> struct BoardWord<16> { typedef uint16_t type; };
+template <> struct BoardWord<32> { typedef uint32_t type; };
+
+// Fixed boards, N = 8, 16, 32 or 64 is the capacity; size <= N is the
+// actual side in use
+template <int N, bool Wide = (N > 64)>
+struct Board {
+    typedef typename BoardWord<N>::type Row;
+
+    int size;
+    Row interior[N];   // cells inside the wall ring
+    Row crates[N];
+    Row items[N];
+    Row players[N];
+
+    explicit Board(int n = N) { reset(n); }
+
+    void reset(int n) {
+        size = n;
+        memset(interior, 0, sizeof(interior));
+        memset(crates, 0, sizeof(crates));
+        memset(items, 0, sizeof(items));
+        memset(players, 0, sizeof(players));
+        Row inner = static_cast<Row>(((static_cast<uint64_t>(1) << (n - 2)) - 1) << 1);
+        for (int x = 1; x < n - 1; x++) interior[x] = inner;
+    }
+
+    static Row bit(int y) { return static_cast<Row>(static_cast<Row>(1) << y); }
+
+    void setCrate(int x, int y) { crates[x] |= bit(y); }
+    void setItem(int x, int y) { items[x] |= bit(y); }
+    void clearItem(int x, int y) { items[x] &= static_cast<Row>(~bit(y)); }
+    bool hasCrate(int x, int y) const { return (crates[x] & bit(y)) != 0; }
+    bool hasItem(int x, int y) const { return (items[x] & bit(y)) != 0; }
+
+    bool isOpen(int x, int y) const {
+        return x > 0 && x < size - 1 && ((interior[x] & ~crates[x]) & bit(y)) != 0;
+    }
+
+    // Player masks are OR-ed; callers rebuild them when players move
+    void clearPlayers() { memset(players, 0, sizeof(players)); }
+    void addPlayer(int x, int y) { players[x] |= bit(y); }
+
+    // Collects the item on (x, y) if any; returns whether one was there
+    bool pickup(int x, int y) {
+        Row b = bit(y);
+        if (!(items[x] & b)) return false;
+        items[x] &= static_cast<Row>(~b);
+        return true;
+    }
+
+    // Open neighbours of (x, y) as a DIR_BIT mask: up, down, left, right
+    unsigned openNeighbours(int x, int y) const {
+        Row b = bit(y);
+        unsigned mask = 0;
+        if ((interior[x - 1] & ~crates[x - 1]) & b) mask |= 1u;
+        if ((interior[x + 1] & ~crates[x + 1]) & b) mask |= 2u;
+        Row open = interior[x] & ~crates[x];
+        if (open & static_cast<Row>(b >> 1)) mask |= 4u;
+        if (open & static_cast<Row>(b << 1)) mask |= 8u;
+        return mask;
+    }
+
+    Row spawnRow(int x, bool avoidPlayers) const {
+        Row m = interior[x] & ~crates[x] & ~items[x];
+        if (avoidPlayers) m &= ~players[x];
+        return m;
+    }
+
+    int countSpawnCandidates(bool avoidPlayers = false) const {
+        int count = 0;
+        for (int x = 1; x < size - 1; x++) count += popCount(spawnRow(x, avoidPlayers));
+        return count;
+    }
+
+    // k-th spawn candidate in row-major order, k < countSpawnCandidates()
+    bool spawnCandidate(int k, int& outX, int& outY, bool avoidPlayers = false) const {
+        for (int x = 1; x < size - 1; x++) {
+            Row m = spawnRow(x, avoidPlayers);
+            int c = popCount(m);
+            if (k < c) {
+                outX = x;
+                outY = selectBit(m, k);
+                return true;
+            }
+            k -= c;
+        }
+        return false;
+    }
+
+    // Uniform spawn cell in one pass: candidate masks and their popcounts
+    // are built together, then the random index is resolved row by row
+    bool pickSpawn(uint32_t random, int& outX, int& outY, bool avoidPlayers = false) const {
+        Row masks[N];
+        int counts[N];
+        int total = 0;
+        for (int x = 1; x < size - 1; x++) {
+            masks[x] = spawnRow(x, avoidPlayers);
+            counts[x] = popCount(masks[x]);
+            total += counts[x];
+        }
+        if (total == 0) return false;
+        int k = static_cast<int>((static_cast<uint64_t>(random) * total) >> 32);
+        for (int x = 1; x < size - 1; x++) {
+            if (k < counts[x]) {
+                outX = x;
+                outY = selectBit(masks[x], k);
+                return true;
+            }
+            k -= counts[x];
+        }
+        return false;
+    }
+};
+
+// Generic fallback for boards wider than 64 cells: several words per row
+template <int N>
+struct Board<N, true> {
+    int size;
+    int words;
+    std::vector<uint64_t> interior, crates, items, players;
+
+    explicit Board(int n = N) { reset(n); }
+
+    void reset(int n) {
+        size = n;
+        words = (n + 63) / 64;
+        interior.assign(n * words, 0);
+        crates.assign(n * words, 0);
+        items.assign(n * words, 0);
+        players.assign(n * words, 0);
+        for (int x = 1; x < n - 1; x++) {
+            for (int y = 1; y < n - 1; y++) interior[x * words + y / 64] |= 1ULL << (y % 64);
+        }
+    }
+
+    int word(int x, int y) const { return x * words + y / 64; }
+    static uint64_t bit(int y) { return 1ULL << (y % 64); }
+
+    void setCrate(int x, int y) { crates[word(x, y)] |= bit(y); }
+    void setItem(int x, int y) { items[word(x, y)] |= bit(y); }
+    void clearItem(int x, int y) { items[word(x, y)] &= ~bit(y); }
+    bool hasCrate(int x, int y) const { return (crates[word(x, y)] & bit(y)) != 0; }
+    bool hasItem(int x, int y) const { return (items[word(x, y)] & bit(y)) != 0; }
+
+    bool isOpen(int x, int y) const {
+        int w = word(x, y);
+        return x > 0 && x < size - 1 && y > 0 && y < size - 1 && ((interior[w] & ~crates[w]) & bit(y)) != 0;
+    }
+
+    void clearPlayers() { std::fill(players.begin(), players.end(), 0); }
+    void addPlayer(int x, int y) { players[word(x, y)] |= bit(y); }
+
+    bool pickup(int x, int y) {
+        int w = word(x, y);
+        if (!(items[w] & bit(y))) return false;
+        items[w] &= ~bit(y);
+        return true;
+    }
+
+    unsigned openNeighbours(int x, int y) const {
+        unsigned mask = 0;
+        if (isOpen(x - 1, y)) mask |= 1u;
+        if (isOpen(x + 1, y)) mask |= 2u;
+        if (isOpen(x, y - 1)) mask |= 4u;
+        if (isOpen(x, y + 1)) mask |= 8u;
+        return mask;
+    }
+
+    uint64_t spawnWord(int w, bool avoidPlayers) const {
+        uint64_t m = interior[w] & ~crates[w] & ~items[w];
+        if (avoidPlayers) m &= ~players[w];
+        return m;
+    }
+
+    int countSpawnCandidates(bool avoidPlayers = false) const {
+        int count = 0;
+        for (int w = words; w < (size - 1) * words; w++) count += popCount(spawnWord(w, avoidPlayers));
+        return count;
+    }
+
+    bool spawnCandidate(int k, int& outX, int& outY, bool avoidPlayers = false) const {
+        for (int w = words; w < (size - 1) * words; w++) {
+            uint64_t m = spawnWord(w, avoidPlayers);
+            int c = popCount(m);
+            if (k < c) {
+                outX = w / words;
+                outY = (w % words) * 64 + selectBit(m, k);
+                return true;
+            }
+            k -= c;
+        }
+        return false;
+    }
+
+    bool pickSpawn(uint32_t random, int& outX, int& outY, bool avoidPlayers = false) const {
+        int total = countSpawnCandidates(avoidPlayers);
+        if (total == 0) return false;
+        int k = static_cast<int>((static_cast<uint64_t>(random) * total) >> 32);
+        return spawnCandidate(k, outX, outY, avoidPlayers);
+    }
+};
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef BOT_H
+#define BOT_H
+
+#include <cstdint>
+#include <cstdlib>
+#include "game.h"
+#include "input.h"
+
+// Greedy bot: walks towards the nearest coin. The spatial hash picks the
+// coin nearest in Manhattan distance (ties to the lower row, then column)
+// from growing windows around the bot; an A* search over open cells,
+// guided by the distance to that coin, then finds the first step of a
+// shortest path to it. If crates cut the coin off, a breadth-first search
+// heads for whichever coin is nearest by path instead. With no reachable
+// coin it wanders; with no coin at all it does so without searching.
+
+// Nearest coin to (x, y) by Manhattan distance, or false if there is none
+inline bool nearestCoin(const MatchState& match, int x, int y, int& coinX, int& coinY) {
+    int best = -1;
+    for (int r = 4;; r *= 2) {
+        match.world.spatial.queryRect(x - r, y - r, x + r, y + r, [&](uint32_t, const SpatialHash<Entity>::Entry& e) {
+            int d = std::abs(e.x - x) + std::abs(e.y - y);
+            if (best < 0 || d < best || (d == best && (e.x < coinX || (e.x == coinX && e.y < coinY)))) {
+                best = d;
+                coinX = e.x;
+                coinY = e.y;
+            }
+        });
+        // Anything outside the window is more than r away
+        if ((best >= 0 && best <= r) || r >= match.gridSize) return best >= 0;
+    }
+}
+
+// First step of a shortest path to (goalX, goalY), or DIR_NONE if walls
+// and crates cut it off. f = g + h only ever stays or grows by 2 on this
+// grid, so the open list is just the cells at the current f and at f + 2.
+inline int aStarStep(const MatchState& match, const Position& start, int goalX, int goalY) {
+    const int n = match.gridSize;
+    int16_t open[2][4 * MAX_GRID_SIZE * MAX_GRID_SIZE];
+    int counts[2] = {0, 0};
+    int16_t bestG[MAX_GRID_SIZE * MAX_GRID_SIZE];
+    int8_t firstStep[MAX_GRID_SIZE * MAX_GRID_SIZE];
+    for (int c = 0; c < n * n; c++) bestG[c] = INT16_MAX;
+
+    int startCell = start.x * n + start.y;
+    int f = std::abs(start.x - goalX) + std::abs(start.y - goalY);
+    bestG[startCell] = 0;
+    firstStep[startCell] = DIR_NONE;
+    open[0][counts[0]++] = static_cast<int16_t>(startCell);
+    int cur = 0;
+    while (counts[cur] > 0 || counts[cur ^ 1] > 0) {
+        if (counts[cur] == 0) {
+            cur ^= 1;
+            f += 2;
+            continue;
+        }
+        int cell = open[cur][--counts[cur]];
+        int x = cell / n, y = cell % n;
+        int g = f - std::abs(x - goalX) - std::abs(y - goalY);
+        if (g != bestG[cell]) continue;   // reached more cheaply since
+        if (x == goalX && y == goalY) return firstStep[cell];
+        for (int d = DIR_UP; d <= DIR_RIGHT; d++) {
+            int nx, ny;
+            dirToDelta(d, nx, ny);
+            nx += x;
+            ny += y;
+            int next = nx * n + ny;
+            if (!match.board.isOpen(nx, ny) || g + 1 >= bestG[next]) continue;
+            bestG[next] = static_cast<int16_t>(g + 1);
+            firstStep[next] = static_cast<int8_t>(cell == startCell ? d : firstStep[cell]);
+            int side = g + 1 + std::abs(nx - goalX) + std::abs(ny - goalY) == f ? cur : cur ^ 1;
+            open[side][counts[side]++] = static_cast<int16_t>(next);
+        }
+    }
+    return DIR_NONE;
+}
+
+// First step towards the coin nearest by path, or DIR_NONE if none is
+// reachable
+inline int bfsCoinStep(const MatchState& match, const Position& start) {
+    const int n = match.gridSize;
+    int16_t queue[MAX_GRID_SIZE * MAX_GRID_SIZE];
+    int8_t firstStep[MAX_GRID_SIZE * MAX_GRID_SIZE];
+    const int8_t unseen = -2;
+    for (int c = 0; c < n * n; c++) firstStep[c] = unseen;
+
+    int head = 0, tail = 0;
+    int startCell = start.x * n + start.y;
+    firstStep[startCell] = DIR_NONE;
+    queue[tail++] = static_cast<int16_t>(startCell);
+    while (head < tail) {
+        int cell = queue[head++];
+        int x = cell / n, y = cell % n;
+        if (cell != startCell && match.board.hasItem(x, y)) return firstStep[cell];
+        for (int d = DIR_UP; d <= DIR_RIGHT; d++) {
+            int nx, ny;
+            dirToDelta(d, nx, ny);
+            nx += x;
+            ny += y;
+            int next = nx * n + ny;
+            if (!match.board.isOpen(nx, ny) || firstStep[next] != unseen) continue;
+            firstStep[next] = static_cast<int8_t>(cell == startCell ? d : firstStep[cell]);
+            queue[tail++] = static_cast<int16_t>(next);
+        }
+    }
+    return DIR_NONE;
+}
+
+inline int greedyBotMove(const MatchState& match, int player, Rng& rng) {
+    const Position& start = match.world.get<Position>(match.players[player]);
+    int coinX = 0, coinY = 0;
+    if (!nearestCoin(match, start.x, start.y, coinX, coinY)) return static_cast<int>(rng.below(4));
+    int dir = DIR_NONE;
+    if (coinX != start.x || coinY != start.y) dir = aStarStep(match, start, coinX, coinY);
+    if (dir == DIR_NONE) dir = bfsCoinStep(match, start);
+    return dir != DIR_NONE ? dir : static_cast<int>(rng.below(4));
+}
+
+#endif
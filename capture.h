@@ -0,0 +1,239 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <pthread.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+#include "threadconf.h"
+
+// Asynchronous frame capture for match recordings. The render thread copies
+// a finished frame into one of a fixed set of recycled buffers and hands it
+// to a few encoder threads, which write it out as a numbered PNG or at its
+// offset in a raw RGBA stream. The render thread never waits for encoding
+// or disk: if every buffer is still in flight, the frame is dropped and
+// counted instead.
+
+#define CAPTURE_FPS 60
+#define CAPTURE_BUFFERS 8
+#define CAPTURE_DEFAULT_ENCODERS 2
+#define CAPTURE_MAX_ENCODERS 16
+
+enum CaptureFormat {
+    CAPTURE_PNG,   // <dir>/frame_000000.png, ...
+    CAPTURE_RAW    // one file of width * height * 4 byte frames
+};
+
+// Writes one RGBA image, top row first. PNG encoding is supplied by the
+// caller so this header needs no image library.
+typedef bool (*CaptureImageWriter)(const char* path, const uint8_t* rgba, int width, int height);
+
+struct CaptureFrame {
+    std::vector<uint8_t> pixels;
+    int64_t index;   // position in the recording; dropped frames take none
+};
+
+struct FrameCapture {
+    int width, height;
+    CaptureFormat format;
+    bool bottomUp;   // rows arrive bottom first, as glReadPixels returns them
+    std::string path;
+    CaptureImageWriter writeImage;
+    int rawFd;
+
+    std::vector<CaptureFrame> frames;
+    std::vector<int> freeFrames;
+    std::deque<int> readyFrames;
+    std::vector<pthread_t> encoders;
+    pthread_mutex_t lock;
+    pthread_cond_t readyCond;
+    bool stopping;
+
+    std::atomic<long long> captured;
+    std::atomic<long long> dropped;
+    std::atomic<long long> written;
+    std::atomic<long long> failed;
+
+    // Render-thread cost of each capture attempt, recorded by the caller
+    long long costCount;
+    long long costTotalUs;
+    long long costMaxUs;
+
+    FrameCapture() : width(0), height(0), format(CAPTURE_RAW), bottomUp(false), writeImage(nullptr), rawFd(-1),
+                     stopping(false), captured(0), dropped(0), written(0), failed(0),
+                     costCount(0), costTotalUs(0), costMaxUs(0) {
+        pthread_mutex_init(&lock, nullptr);
+        pthread_cond_init(&readyCond, nullptr);
+    }
+
+    ~FrameCapture() {
+        close();
+        pthread_cond_destroy(&readyCond);
+        pthread_mutex_destroy(&lock);
+    }
+
+    size_t frameBytes() const { return static_cast<size_t>(width) * height * 4; }
+    bool isOpen() const { return !encoders.empty(); }
+
+    // PNG output goes into the directory at path (created if missing), raw
+    // output replaces the file at path
+    bool open(const char* outPath, CaptureFormat fmt, int w, int h, int encoderCount,
+              CaptureImageWriter writer = nullptr, int bufferCount = CAPTURE_BUFFERS) {
+        if (isOpen() || w <= 0 || h <= 0 || bufferCount < 1) return false;
+        if (fmt == CAPTURE_PNG && !writer) return false;
+        if (encoderCount < 1) encoderCount = 1;
+        if (encoderCount > CAPTURE_MAX_ENCODERS) encoderCount = CAPTURE_MAX_ENCODERS;
+
+        if (fmt == CAPTURE_RAW) {
+            rawFd = ::open(outPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (rawFd < 0) return false;
+        } else if (mkdir(outPath, 0755) != 0 && errno != EEXIST) {
+            return false;
+        }
+
+        width = w;
+        height = h;
+        format = fmt;
+        path = outPath;
+        writeImage = writer;
+        stopping = false;
+        frames.assign(bufferCount, CaptureFrame());
+        freeFrames.clear();
+        for (int i = 0; i < bufferCount; i++) {
+            frames[i].pixels.resize(frameBytes());
+            freeFrames.push_back(i);
+        }
+
+        encoders.resize(encoderCount);
+        for (int i = 0; i < encoderCount; i++) {
+            if (createRoleThread(&encoders[i], ROLE_WORKER, i, encoder, this) != 0) {
+                encoders.resize(i);
+                break;
+            }
+        }
+        if (encoders.empty()) {
+            closeRaw();
+            return false;
+        }
+        return true;
+    }
+
+    // A free buffer to fill, or nullptr (counted as a drop) when the
+    // encoders are behind
+    CaptureFrame* acquire() {
+        CaptureFrame* frame = nullptr;
+        pthread_mutex_lock(&lock);
+        if (!freeFrames.empty()) {
+            frame = &frames[freeFrames.back()];
+            freeFrames.pop_back();
+        }
+        pthread_mutex_unlock(&lock);
+        if (!frame) dropped++;
+        return frame;
+    }
+
+    void submit(CaptureFrame* frame) {
+        frame->index = captured++;
+        pthread_mutex_lock(&lock);
+        readyFrames.push_back(static_cast<int>(frame - &frames[0]));
+        pthread_cond_signal(&readyCond);
+        pthread_mutex_unlock(&lock);
+    }
+
+    void recordCost(long long us) {
+        costCount++;
+        costTotalUs += us;
+        if (us > costMaxUs) costMaxUs = us;
+    }
+
+    double meanCostUs() const { return costCount ? static_cast<double>(costTotalUs) / costCount : 0.0; }
+
+    // Encodes everything already submitted, then stops the encoders
+    void close() {
+        if (!isOpen()) return;
+        pthread_mutex_lock(&lock);
+        stopping = true;
+        pthread_cond_broadcast(&readyCond);
+        pthread_mutex_unlock(&lock);
+        for (size_t i = 0; i < encoders.size(); i++) pthread_join(encoders[i], nullptr);
+        encoders.clear();
+        closeRaw();
+    }
+
+private:
+    void closeRaw() {
+        if (rawFd >= 0) ::close(rawFd);
+        rawFd = -1;
+    }
+
+    bool writeFrame(const CaptureFrame& frame) {
+        if (format == CAPTURE_PNG) {
+            char file[4096];
+            snprintf(file, sizeof(file), "%s/frame_%06lld.png", path.c_str(), static_cast<long long>(frame.index));
+            return writeImage(file, frame.pixels.data(), width, height);
+        }
+        // Encoders finish out of order, so each frame goes to its own offset
+        const uint8_t* data = frame.pixels.data();
+        size_t left = frameBytes();
+        off_t offset = static_cast<off_t>(frame.index) * static_cast<off_t>(frameBytes());
+        while (left > 0) {
+            ssize_t n = pwrite(rawFd, data, left, offset);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            data += n;
+            left -= static_cast<size_t>(n);
+            offset += n;
+        }
+        return true;
+    }
+
+    static void flipRows(uint8_t* pixels, int rowBytes, int rows, std::vector<uint8_t>& scratch) {
+        scratch.resize(rowBytes);
+        for (int top = 0, bottom = rows - 1; top < bottom; top++, bottom--) {
+            uint8_t* a = pixels + static_cast<size_t>(top) * rowBytes;
+            uint8_t* b = pixels + static_cast<size_t>(bottom) * rowBytes;
+            memcpy(scratch.data(), a, rowBytes);
+            memcpy(a, b, rowBytes);
+            memcpy(b, scratch.data(), rowBytes);
+        }
+    }
+
+    static void* encoder(void* arg) {
+        FrameCapture* cap = static_cast<FrameCapture*>(arg);
+        std::vector<uint8_t> scratch;
+        for (;;) {
+            pthread_mutex_lock(&cap->lock);
+            while (cap->readyFrames.empty() && !cap->stopping) pthread_cond_wait(&cap->readyCond, &cap->lock);
+            if (cap->readyFrames.empty()) {
+                pthread_mutex_unlock(&cap->lock);
+                break;
+            }
+            int f = cap->readyFrames.front();
+            cap->readyFrames.pop_front();
+            pthread_mutex_unlock(&cap->lock);
+
+            CaptureFrame& frame = cap->frames[f];
+            if (cap->bottomUp) flipRows(frame.pixels.data(), cap->width * 4, cap->height, scratch);
+            if (cap->writeFrame(frame)) {
+                cap->written++;
+            } else {
+                cap->failed++;
+            }
+
+            pthread_mutex_lock(&cap->lock);
+            cap->freeFrames.push_back(f);
+            pthread_mutex_unlock(&cap->lock);
+        }
+        return nullptr;
+    }
+};
+
+#endif
@@ -0,0 +1,275 @@
+#ifndef CONNECTIVITY_H
+#define CONNECTIVITY_H
+
+#include <cstdint>
+#include <vector>
+#include "mapgen.h"
+
+#define CONNECTIVITY_MAX_PICK 8
+
+// Reachability of floor cells, kept up to date as obstacles come and go.
+// Cells carry a component label; labels are merged through a union-find
+// when an obstacle is removed, and only the affected component is
+// relabelled when an obstacle is added and might split it.
+// Each component also keeps a dense list of its free cells (floor without
+// an item) so a spawn cell can be picked in constant time.
+struct ConnectivityIndex {
+    struct Component {
+        int area;
+        std::vector<int> freeCells;
+        Component() : area(0) {}
+    };
+
+    int size;
+    std::vector<uint8_t> blocked;
+    std::vector<uint8_t> occupied;
+    std::vector<int> label;      // -1 for blocked cells
+    std::vector<int> slot;       // index in the component's freeCells, -1 if not free
+    std::vector<int> parent;     // union-find over labels
+    std::vector<Component> components;
+    std::vector<unsigned> visited;
+    unsigned visitStamp;
+
+    ConnectivityIndex() : size(0), visitStamp(0) {}
+
+    void build(const GameMap& map) {
+        size = map.size;
+        blocked.assign(map.cells.begin(), map.cells.end());
+        occupied.assign(size * size, 0);
+        label.assign(size * size, -1);
+        slot.assign(size * size, -1);
+        visited.assign(size * size, 0);
+        visitStamp = 0;
+        parent.clear();
+        components.clear();
+
+        for (int c = 0; c < size * size; c++) {
+            if (!blocked[c] && label[c] < 0) flood(c, newLabel());
+        }
+    }
+
+    int component(int x, int y) {
+        int l = label[x * size + y];
+        return l < 0 ? -1 : find(l);
+    }
+
+    int area(int comp) const { return comp < 0 ? 0 : components[comp].area; }
+    int freeCount(int comp) const { return comp < 0 ? 0 : static_cast<int>(components[comp].freeCells.size()); }
+
+    // Number of floor cells the player standing at (x, y) can walk to
+    int reachableArea(int x, int y) { return area(component(x, y)); }
+
+    void markOccupied(int x, int y) {
+        int c = x * size + y;
+        if (blocked[c] || occupied[c]) return;
+        occupied[c] = 1;
+        removeFree(c);
+    }
+
+    void markFree(int x, int y) {
+        int c = x * size + y;
+        if (blocked[c] || !occupied[c]) return;
+        occupied[c] = 0;
+        addFree(c);
+    }
+
+    // Opening a cell can only join components, so labels are merged
+    void removeObstacle(int x, int y) {
+        int c = x * size + y;
+        if (!blocked[c]) return;
+        blocked[c] = 0;
+
+        int l = newLabel();
+        label[c] = l;
+        components[l].area = 1;
+        if (!occupied[c]) addFree(c);
+
+        const int offsets[4] = {-size, size, -1, 1};
+        for (int d = 0; d < 4; d++) {
+            int n = c + offsets[d];
+            if (n < 0 || n >= size * size || blocked[n]) continue;
+            merge(find(label[c]), find(label[n]));
+        }
+    }
+
+    // Closing a cell may split its component; only that component is rebuilt
+    void addObstacle(int x, int y) {
+        int c = x * size + y;
+        if (blocked[c]) return;
+        int old = find(label[c]);
+        if (!occupied[c]) removeFree(c);
+        blocked[c] = 1;
+        occupied[c] = 0;
+        label[c] = -1;
+        components[old].area--;
+        if (!maySplit(c)) return;
+
+        std::vector<int> members;
+        collect(c, old, members);
+        components[old].area = 0;
+        components[old].freeCells.clear();
+        for (size_t i = 0; i < members.size(); i++) {
+            label[members[i]] = -1;
+            slot[members[i]] = -1;
+        }
+        for (size_t i = 0; i < members.size(); i++) {
+            if (label[members[i]] < 0) flood(members[i], newLabel());
+        }
+    }
+
+    // Picks a free cell in a component holding at least one of the given
+    // positions, uniformly over those cells. Cost depends only on count.
+    // At most CONNECTIVITY_MAX_PICK distinct components are considered.
+    bool pickReachableFreeCell(const int* xs, const int* ys, int count, uint64_t random, int& outX, int& outY) {
+        int comps[CONNECTIVITY_MAX_PICK];
+        int distinct = 0;
+        long long total = 0;
+        for (int i = 0; i < count && distinct < CONNECTIVITY_MAX_PICK; i++) {
+            int comp = component(xs[i], ys[i]);
+            if (comp < 0) continue;
+            bool seen = false;
+            for (int k = 0; k < distinct; k++) seen = seen || comps[k] == comp;
+            if (seen) continue;
+            comps[distinct++] = comp;
+            total += freeCount(comp);
+        }
+        if (total == 0) return false;
+
+        long long pick = static_cast<long long>(random % static_cast<uint64_t>(total));
+        for (int k = 0; k < distinct; k++) {
+            long long n = freeCount(comps[k]);
+            if (pick < n) {
+                int c = components[comps[k]].freeCells[pick];
+                outX = c / size;
+                outY = c % size;
+                return true;
+            }
+            pick -= n;
+        }
+        return false;
+    }
+
+private:
+    // The floor 4-neighbours of a closed cell stay connected if one run of
+    // floor cells around its 8-ring holds all of them; then no split is possible
+    bool maySplit(int c) const {
+        const int ring[8] = {-size, -size + 1, 1, size + 1, size, size - 1, -1, -size - 1};
+        int start = -1;
+        for (int i = 0; i < 8; i++) {
+            if (blocked[c + ring[i]]) { start = i; break; }
+        }
+        if (start < 0) return false;
+
+        int runsWithNeighbour = 0;
+        bool inRun = false, runHasNeighbour = false;
+        for (int k = 1; k <= 8; k++) {
+            int i = (start + k) % 8;
+            if (!blocked[c + ring[i]]) {
+                inRun = true;
+                runHasNeighbour = runHasNeighbour || i % 2 == 0;
+            } else if (inRun) {
+                runsWithNeighbour += runHasNeighbour;
+                inRun = false;
+                runHasNeighbour = false;
+            }
+        }
+        return runsWithNeighbour > 1;
+    }
+
+    int newLabel() {
+        parent.push_back(static_cast<int>(parent.size()));
+        components.push_back(Component());
+        return static_cast<int>(parent.size()) - 1;
+    }
+
+    int find(int l) {
+        while (parent[l] != l) {
+            parent[l] = parent[parent[l]];
+            l = parent[l];
+        }
+        return l;
+    }
+
+    // Smaller free list is moved into the larger one
+    void merge(int a, int b) {
+        if (a == b) return;
+        if (components[a].freeCells.size() < components[b].freeCells.size()) std::swap(a, b);
+        Component& into = components[a];
+        Component& from = components[b];
+        for (size_t i = 0; i < from.freeCells.size(); i++) {
+            slot[from.freeCells[i]] = static_cast<int>(into.freeCells.size());
+            into.freeCells.push_back(from.freeCells[i]);
+        }
+        into.area += from.area;
+        from.area = 0;
+        std::vector<int>().swap(from.freeCells);
+        parent[b] = a;
+    }
+
+    void addFree(int c) {
+        Component& comp = components[find(label[c])];
+        slot[c] = static_cast<int>(comp.freeCells.size());
+        comp.freeCells.push_back(c);
+    }
+
+    void removeFree(int c) {
+        if (slot[c] < 0) return;
+        Component& comp = components[find(label[c])];
+        int last = comp.freeCells.back();
+        comp.freeCells[slot[c]] = last;
+        slot[last] = slot[c];
+        comp.freeCells.pop_back();
+        slot[c] = -1;
+    }
+
+    // Cells labelled into comp around the closed cell c
+    void collect(int c, int comp, std::vector<int>& members) {
+        if (++visitStamp == 0) {
+            visited.assign(size * size, 0);
+            visitStamp = 1;
+        }
+        const int offsets[4] = {-size, size, -1, 1};
+        std::vector<int> stack;
+        for (int d = 0; d < 4; d++) {
+            int n = c + offsets[d];
+            if (n >= 0 && n < size * size && !blocked[n] && find(label[n]) == comp && visited[n] != visitStamp) {
+                visited[n] = visitStamp;
+                stack.push_back(n);
+            }
+        }
+        while (!stack.empty()) {
+            int cur = stack.back();
+            stack.pop_back();
+            members.push_back(cur);
+            for (int d = 0; d < 4; d++) {
+                int n = cur + offsets[d];
+                if (n < 0 || n >= size * size || visited[n] == visitStamp || blocked[n]) continue;
+                visited[n] = visitStamp;
+                stack.push_back(n);
+            }
+        }
+    }
+
+    void flood(int start, int l) {
+        const int offsets[4] = {-size, size, -1, 1};
+        std::vector<int> stack(1, start);
+        label[start] = l;
+        while (!stack.empty()) {
+            int cur = stack.back();
+            stack.pop_back();
+            components[l].area++;
+            if (!occupied[cur]) {
+                slot[cur] = static_cast<int>(components[l].freeCells.size());
+                components[l].freeCells.push_back(cur);
+            }
+            for (int d = 0; d < 4; d++) {
+                int n = cur + offsets[d];
+                if (n < 0 || n >= size * size || blocked[n] || label[n] >= 0) continue;
+                label[n] = l;
+                stack.push_back(n);
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,334 @@
+#ifndef CORO_H
+#define CORO_H
+
+#include <pthread.h>
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <queue>
+#include <vector>
+#include "threadconf.h"
+
+// Coroutine runtime for game actors (C++20). An actor is a CoTask
+// coroutine handed to a CoScheduler; it runs on one of the scheduler's
+// few worker threads and, between steps, waits on
+//
+//   co_await actors.nextTick();            resumed by advanceTick()
+//   co_await actors.sleepUntil(t);         resumed by advanceClock(now >= t)
+//   co_await actors.sleepFor(dt);
+//   co_await event.wait(seenVersion);      resumed by event.notify()
+//
+// A waiting actor is its heap-allocated frame (a few hundred bytes) and
+// one entry in a list, heap or event; it has no thread or stack of its own,
+// so thousands of them cost nothing until they are resumed. The clock is
+// whatever the owner advances it with: match time in the game, so timers
+// follow save/restore, pause and rollback.
+//
+// Actors on different workers run in parallel and synchronise shared
+// state themselves. stop() destroys actors that are still waiting.
+
+struct CoScheduler;
+
+// Bytes of coroutine frames currently allocated, for the benchmark
+inline std::atomic<long long>& coFrameBytes() {
+    static std::atomic<long long> bytes(0);
+    return bytes;
+}
+
+struct CoTask {
+    struct promise_type;
+    typedef std::coroutine_handle<promise_type> Handle;
+
+    // Unlinks the finished actor and frees its frame
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        void await_suspend(Handle h) noexcept;
+        void await_resume() noexcept {}
+    };
+
+    struct promise_type {
+        CoScheduler* scheduler = nullptr;
+        promise_type* prev = nullptr;   // live actors, for stop()
+        promise_type* next = nullptr;
+
+        CoTask get_return_object() { return CoTask(Handle::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        FinalAwaiter final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+
+        static void* operator new(size_t size) {
+            coFrameBytes().fetch_add(static_cast<long long>(size), std::memory_order_relaxed);
+            return ::operator new(size);
+        }
+        static void operator delete(void* p, size_t size) {
+            coFrameBytes().fetch_sub(static_cast<long long>(size), std::memory_order_relaxed);
+            ::operator delete(p);
+        }
+    };
+
+    Handle handle;
+
+    explicit CoTask(Handle h) : handle(h) {}
+    CoTask(CoTask&& other) noexcept : handle(other.handle) { other.handle = nullptr; }
+    CoTask(const CoTask&) = delete;
+    CoTask& operator=(const CoTask&) = delete;
+    ~CoTask() {
+        if (handle) handle.destroy();   // never spawned
+    }
+};
+
+struct CoTimer {
+    double due;
+    uint64_t order;   // equal due times resume in the order they were set
+    std::coroutine_handle<> handle;
+};
+
+struct CoTimerLater {
+    bool operator()(const CoTimer& a, const CoTimer& b) const {
+        return a.due != b.due ? a.due > b.due : a.order > b.order;
+    }
+};
+
+struct CoScheduler {
+    pthread_mutex_t lock;
+    pthread_cond_t readyCond;
+    pthread_cond_t idleCond;
+    std::deque<std::coroutine_handle<> > ready;
+    std::vector<std::coroutine_handle<> > tickWaiters;
+    std::priority_queue<CoTimer, std::vector<CoTimer>, CoTimerLater> timers;
+    double clock;
+    uint64_t timerOrder;
+    uint64_t ticks;
+    std::vector<pthread_t> workers;
+    ThreadRole role;
+    bool stopping;
+    int resuming;                      // actors running on a worker right now
+    CoTask::promise_type* live;        // every actor not yet finished
+    size_t liveCount;
+
+    CoScheduler() : clock(0), timerOrder(0), ticks(0), role(ROLE_WORKER), stopping(false), resuming(0), live(nullptr),
+                    liveCount(0) {
+        pthread_mutex_init(&lock, nullptr);
+        pthread_cond_init(&readyCond, nullptr);
+        pthread_cond_init(&idleCond, nullptr);
+    }
+
+    ~CoScheduler() {
+        stop();
+        pthread_cond_destroy(&idleCond);
+        pthread_cond_destroy(&readyCond);
+        pthread_mutex_destroy(&lock);
+    }
+
+    // Returns how many workers started
+    int start(int threads) {
+        if (threads < 1) threads = 1;
+        stopping = false;
+        workers.resize(threads);
+        for (int i = 0; i < threads; i++) {
+            if (createRoleThread(&workers[i], role, i, worker, this) != 0) {
+                workers.resize(i);
+                break;
+            }
+        }
+        return static_cast<int>(workers.size());
+    }
+
+    // Stops the workers, then destroys every actor that has not finished
+    void stop() {
+        pthread_mutex_lock(&lock);
+        stopping = true;
+        pthread_cond_broadcast(&readyCond);
+        pthread_mutex_unlock(&lock);
+        for (size_t i = 0; i < workers.size(); i++) pthread_join(workers[i], nullptr);
+        workers.clear();
+
+        while (live) {
+            CoTask::promise_type* p = live;
+            live = p->next;
+            CoTask::Handle::from_promise(*p).destroy();
+        }
+        liveCount = 0;
+        ready.clear();
+        tickWaiters.clear();
+        timers = std::priority_queue<CoTimer, std::vector<CoTimer>, CoTimerLater>();
+    }
+
+    // Takes the actor over and runs it up to its first co_await
+    void spawn(CoTask task) {
+        CoTask::Handle h = task.handle;
+        task.handle = nullptr;
+        CoTask::promise_type& p = h.promise();
+        p.scheduler = this;
+        pthread_mutex_lock(&lock);
+        p.next = live;
+        if (live) live->prev = &p;
+        live = &p;
+        liveCount++;
+        makeReady(h);
+        pthread_mutex_unlock(&lock);
+    }
+
+    size_t actors() {
+        pthread_mutex_lock(&lock);
+        size_t n = liveCount;
+        pthread_mutex_unlock(&lock);
+        return n;
+    }
+
+    // Resumes everything waiting on nextTick()
+    void advanceTick() {
+        pthread_mutex_lock(&lock);
+        ticks++;
+        for (size_t i = 0; i < tickWaiters.size(); i++) ready.push_back(tickWaiters[i]);
+        if (!tickWaiters.empty()) pthread_cond_broadcast(&readyCond);
+        tickWaiters.clear();
+        pthread_mutex_unlock(&lock);
+    }
+
+    // Moves the clock to now and resumes the timers that are due
+    void advanceClock(double now) {
+        pthread_mutex_lock(&lock);
+        clock = now;
+        bool woke = false;
+        while (!timers.empty() && timers.top().due <= now) {
+            ready.push_back(timers.top().handle);
+            timers.pop();
+            woke = true;
+        }
+        if (woke) pthread_cond_broadcast(&readyCond);
+        pthread_mutex_unlock(&lock);
+    }
+
+    // Until nothing is ready or running
+    void waitIdle() {
+        pthread_mutex_lock(&lock);
+        while ((!ready.empty() || resuming > 0) && !stopping) pthread_cond_wait(&idleCond, &lock);
+        pthread_mutex_unlock(&lock);
+    }
+
+    struct TickAwaiter {
+        CoScheduler* s;
+        bool await_ready() { return false; }
+        void await_suspend(std::coroutine_handle<> h) {
+            pthread_mutex_lock(&s->lock);
+            s->tickWaiters.push_back(h);
+            pthread_mutex_unlock(&s->lock);
+        }
+        void await_resume() {}
+    };
+
+    struct TimerAwaiter {
+        CoScheduler* s;
+        double due;
+        bool await_ready() { return false; }
+        bool await_suspend(std::coroutine_handle<> h) {
+            pthread_mutex_lock(&s->lock);
+            bool wait = due > s->clock;
+            if (wait) {
+                CoTimer t = {due, s->timerOrder++, h};
+                s->timers.push(t);
+            }
+            pthread_mutex_unlock(&s->lock);
+            return wait;
+        }
+        void await_resume() {}
+    };
+
+    TickAwaiter nextTick() { return TickAwaiter{this}; }
+    TimerAwaiter sleepUntil(double time) { return TimerAwaiter{this, time}; }
+
+    // Relative to the clock as of the co_await
+    TimerAwaiter sleepFor(double seconds) {
+        pthread_mutex_lock(&lock);
+        double due = clock + seconds;
+        pthread_mutex_unlock(&lock);
+        return TimerAwaiter{this, due};
+    }
+
+    // Called with lock held
+    void makeReady(std::coroutine_handle<> h) {
+        ready.push_back(h);
+        pthread_cond_signal(&readyCond);
+    }
+
+    void retire(CoTask::promise_type& p) {
+        pthread_mutex_lock(&lock);
+        if (p.prev) p.prev->next = p.next;
+        else live = p.next;
+        if (p.next) p.next->prev = p.prev;
+        liveCount--;
+        pthread_mutex_unlock(&lock);
+    }
+
+private:
+    static void* worker(void* arg) {
+        CoScheduler* s = static_cast<CoScheduler*>(arg);
+        pthread_mutex_lock(&s->lock);
+        for (;;) {
+            while (s->ready.empty() && !s->stopping) pthread_cond_wait(&s->readyCond, &s->lock);
+            if (s->stopping) break;
+            std::coroutine_handle<> h = s->ready.front();
+            s->ready.pop_front();
+            s->resuming++;
+            pthread_mutex_unlock(&s->lock);
+            h.resume();
+            pthread_mutex_lock(&s->lock);
+            s->resuming--;
+            if (s->ready.empty() && s->resuming == 0) pthread_cond_broadcast(&s->idleCond);
+        }
+        pthread_cond_broadcast(&s->idleCond);
+        pthread_mutex_unlock(&s->lock);
+        return nullptr;
+    }
+};
+
+inline void CoTask::FinalAwaiter::await_suspend(Handle h) noexcept {
+    h.promise().scheduler->retire(h.promise());
+    h.destroy();
+}
+
+// Something actors wait for, such as a change in the keys held. version()
+// is read before looking at the state; wait(seen) then returns at once if
+// it changed in between, so no notify is lost.
+struct CoEvent {
+    CoScheduler* scheduler;
+    std::atomic<uint64_t> counter;
+    std::vector<std::coroutine_handle<> > waiters;   // guarded by scheduler->lock
+
+    explicit CoEvent(CoScheduler* s = nullptr) : scheduler(s), counter(0) {}
+
+    uint64_t version() const { return counter.load(std::memory_order_acquire); }
+
+    struct Awaiter {
+        CoEvent* e;
+        uint64_t seen;
+        bool await_ready() { return e->version() != seen; }
+        bool await_suspend(std::coroutine_handle<> h) {
+            pthread_mutex_lock(&e->scheduler->lock);
+            bool wait = e->version() == seen;
+            if (wait) e->waiters.push_back(h);
+            pthread_mutex_unlock(&e->scheduler->lock);
+            return wait;
+        }
+        void await_resume() {}
+    };
+
+    Awaiter wait(uint64_t seen) { return Awaiter{this, seen}; }
+
+    void notify() {
+        pthread_mutex_lock(&scheduler->lock);
+        counter.fetch_add(1, std::memory_order_acq_rel);
+        if (!scheduler->stopping) {
+            for (size_t i = 0; i < waiters.size(); i++) scheduler->makeReady(waiters[i]);
+        }
+        waiters.clear();
+        pthread_mutex_unlock(&scheduler->lock);
+    }
+};
+
+#endif
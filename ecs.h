@@ -0,0 +1,414 @@
+#ifndef ECS_H
+#define ECS_H
+
+#include <pthread.h>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "spatial.h"
+#include "threadconf.h"
+#include "threadpool.h"
+
+// Archetype entity-component-system. Entities with the same set of
+// components live in one archetype, which stores each component in its own
+// dense array, so systems walk plain arrays instead of per-type vectors.
+// Structural changes (create/destroy) made by systems are recorded in a
+// command buffer and applied between scheduler stages, so systems in one
+// stage never see the arrays move underneath them.
+
+#define ECS_MAX_STAGE_SYSTEMS 8
+#define ECS_PARALLEL_MIN_US 20   // waking a stage worker costs a few us; cheaper systems stay inline
+
+// Component bits; the low 16 bits of a system's read/write set
+enum ComponentBit {
+    COMP_POSITION = 1u << 0,
+    COMP_COLLECTIBLE = 1u << 1,
+    COMP_OBSTACLE = 1u << 2,   // tag, no storage
+    COMP_SCORE = 1u << 3,
+    COMP_SPRITE = 1u << 4,
+    COMP_LIFETIME = 1u << 5
+};
+
+struct Position {
+    int x, y;
+};
+
+struct Collectible {
+    int value;
+    float spawnTime;
+};
+
+struct Score {
+    int value;
+};
+
+struct Sprite {
+    int id;
+};
+
+struct Lifetime {
+    float expiresAt;
+};
+
+struct Entity {
+    uint32_t index;
+    uint32_t generation;
+};
+
+inline bool operator==(Entity a, Entity b) { return a.index == b.index && a.generation == b.generation; }
+inline bool operator!=(Entity a, Entity b) { return !(a == b); }
+
+// Every component an entity may start with; only those in mask are used
+struct EntityDesc {
+    unsigned mask;
+    Position position;
+    Collectible collectible;
+    Score score;
+    Sprite sprite;
+    Lifetime lifetime;
+
+    EntityDesc() : mask(0) {
+        position.x = position.y = 0;
+        collectible.value = 0;
+        collectible.spawnTime = 0;
+        score.value = 0;
+        sprite.id = 0;
+        lifetime.expiresAt = 0;
+    }
+};
+
+struct Archetype {
+    unsigned mask;
+    std::vector<Entity> entities;
+    std::vector<Position> positions;
+    std::vector<Collectible> collectibles;
+    std::vector<Score> scores;
+    std::vector<Sprite> sprites;
+    std::vector<Lifetime> lifetimes;
+
+    explicit Archetype(unsigned m) : mask(m) {}
+    int size() const { return static_cast<int>(entities.size()); }
+    bool has(unsigned bits) const { return (mask & bits) == bits; }
+
+    template<class T> std::vector<T>& column() { return columnOf(static_cast<T*>(nullptr)); }
+    template<class T> const std::vector<T>& column() const {
+        return const_cast<Archetype*>(this)->columnOf(static_cast<T*>(nullptr));
+    }
+
+    void push(Entity e, const EntityDesc& d) {
+        entities.push_back(e);
+        if (mask & COMP_POSITION) positions.push_back(d.position);
+        if (mask & COMP_COLLECTIBLE) collectibles.push_back(d.collectible);
+        if (mask & COMP_SCORE) scores.push_back(d.score);
+        if (mask & COMP_SPRITE) sprites.push_back(d.sprite);
+        if (mask & COMP_LIFETIME) lifetimes.push_back(d.lifetime);
+    }
+
+    // Swap-removes a row; returns the entity that moved into it (or the
+    // removed one if it was the last row)
+    Entity removeRow(int row) {
+        int last = size() - 1;
+        Entity moved = entities[last];
+        entities[row] = moved;
+        entities.pop_back();
+        swapPop(positions, row, last);
+        swapPop(collectibles, row, last);
+        swapPop(scores, row, last);
+        swapPop(sprites, row, last);
+        swapPop(lifetimes, row, last);
+        return moved;
+    }
+
+private:
+    template<class T> static void swapPop(std::vector<T>& v, int row, int last) {
+        if (v.empty()) return;
+        v[row] = v[last];
+        v.pop_back();
+    }
+
+    std::vector<Position>& columnOf(Position*) { return positions; }
+    std::vector<Collectible>& columnOf(Collectible*) { return collectibles; }
+    std::vector<Score>& columnOf(Score*) { return scores; }
+    std::vector<Sprite>& columnOf(Sprite*) { return sprites; }
+    std::vector<Lifetime>& columnOf(Lifetime*) { return lifetimes; }
+};
+
+struct EntityRecord {
+    int archetype;   // -1 once destroyed
+    int row;
+    uint32_t generation;
+    uint32_t spatial;   // handle in World::spatial, or SPATIAL_NONE
+};
+
+// Deferred structural changes, applied in order by World::apply
+struct Commands {
+    std::vector<Entity> destroyed;
+    std::vector<EntityDesc> created;
+
+    void destroy(Entity e) { destroyed.push_back(e); }
+    void create(const EntityDesc& d) { created.push_back(d); }
+    bool empty() const { return destroyed.empty() && created.empty(); }
+    void clear() {
+        destroyed.clear();
+        created.clear();
+    }
+};
+
+struct World {
+    std::vector<Archetype> archetypes;
+    std::vector<EntityRecord> records;
+    std::vector<uint32_t> freeIndices;
+    // Entities with every bit of spatialMask (which must include
+    // COMP_POSITION) are kept in spatial by position; move them with
+    // setPosition
+    SpatialHash<Entity> spatial;
+    unsigned spatialMask;
+
+    World() : spatialMask(0) {}
+
+    void clear() {
+        archetypes.clear();
+        records.clear();
+        freeIndices.clear();
+        spatial.clear();
+    }
+
+    int archetypeFor(unsigned mask) {
+        for (size_t a = 0; a < archetypes.size(); a++) {
+            if (archetypes[a].mask == mask) return static_cast<int>(a);
+        }
+        archetypes.push_back(Archetype(mask));
+        return static_cast<int>(archetypes.size()) - 1;
+    }
+
+    Entity create(const EntityDesc& d) {
+        Entity e;
+        if (!freeIndices.empty()) {
+            e.index = freeIndices.back();
+            freeIndices.pop_back();
+        } else {
+            e.index = static_cast<uint32_t>(records.size());
+            EntityRecord blank = {-1, 0, 0, SPATIAL_NONE};
+            records.push_back(blank);
+        }
+        EntityRecord& rec = records[e.index];
+        e.generation = rec.generation;
+        rec.archetype = archetypeFor(d.mask);
+        rec.row = archetypes[rec.archetype].size();
+        archetypes[rec.archetype].push(e, d);
+        rec.spatial = SPATIAL_NONE;
+        if (spatialMask && (d.mask & spatialMask) == spatialMask) {
+            rec.spatial = spatial.insert(d.position.x, d.position.y, e);
+        }
+        return e;
+    }
+
+    bool alive(Entity e) const {
+        return e.index < records.size() && records[e.index].generation == e.generation &&
+               records[e.index].archetype >= 0;
+    }
+
+    void destroy(Entity e) {
+        if (!alive(e)) return;
+        EntityRecord& rec = records[e.index];
+        if (rec.spatial != SPATIAL_NONE) spatial.remove(rec.spatial);
+        Entity moved = archetypes[rec.archetype].removeRow(rec.row);
+        if (moved != e) records[moved.index].row = rec.row;
+        rec.archetype = -1;
+        rec.generation++;
+        freeIndices.push_back(e.index);
+    }
+
+    void apply(Commands& cmds) {
+        for (size_t i = 0; i < cmds.destroyed.size(); i++) destroy(cmds.destroyed[i]);
+        for (size_t i = 0; i < cmds.created.size(); i++) create(cmds.created[i]);
+        cmds.clear();
+    }
+
+    void setPosition(Entity e, int x, int y) {
+        Position& pos = get<Position>(e);
+        pos.x = x;
+        pos.y = y;
+        if (records[e.index].spatial != SPATIAL_NONE) spatial.move(records[e.index].spatial, x, y);
+    }
+
+    bool has(Entity e, unsigned bits) const { return alive(e) && archetypes[records[e.index].archetype].has(bits); }
+
+    template<class T> T& get(Entity e) {
+        const EntityRecord& rec = records[e.index];
+        return archetypes[rec.archetype].column<T>()[rec.row];
+    }
+
+    template<class T> const T& get(Entity e) const {
+        const EntityRecord& rec = records[e.index];
+        return archetypes[rec.archetype].column<T>()[rec.row];
+    }
+
+    // Number of live entities carrying all of the given components
+    int count(unsigned required) const {
+        int n = 0;
+        for (size_t a = 0; a < archetypes.size(); a++) {
+            if (archetypes[a].has(required)) n += archetypes[a].size();
+        }
+        return n;
+    }
+
+    // Calls fn(Archetype&) for every archetype with all of required and
+    // none of excluded
+    template<class Fn> void each(unsigned required, unsigned excluded, Fn fn) {
+        for (size_t a = 0; a < archetypes.size(); a++) {
+            if (archetypes[a].has(required) && !(archetypes[a].mask & excluded) && archetypes[a].size() > 0) {
+                fn(archetypes[a]);
+            }
+        }
+    }
+
+    template<class Fn> void each(unsigned required, unsigned excluded, Fn fn) const {
+        for (size_t a = 0; a < archetypes.size(); a++) {
+            if (archetypes[a].has(required) && !(archetypes[a].mask & excluded) && archetypes[a].size() > 0) {
+                fn(archetypes[a]);
+            }
+        }
+    }
+};
+
+// A system declares what it reads and writes: component bits plus any
+// resource bits (>= 1 << 16) the game defines for shared non-ECS state.
+// Structural changes go through the Commands buffer and do not count as
+// writes, since they are applied after the stage.
+struct SystemDesc {
+    const char* name;
+    unsigned reads;
+    unsigned writes;
+    void (*run)(void* ctx, World& world, Commands& cmds);
+};
+
+inline bool systemsConflict(const SystemDesc& a, const SystemDesc& b) {
+    return (a.writes & (b.reads | b.writes)) || (b.writes & a.reads);
+}
+
+struct SystemJob {
+    const SystemDesc* system;
+    void* ctx;
+    World* world;
+    Commands* cmds;
+    double* avgUs;
+};
+
+inline void systemWorker(void* arg) {
+    SystemJob* job = static_cast<SystemJob*>(arg);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    job->system->run(job->ctx, *job->world, *job->cmds);
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    *job->avgUs += (us - *job->avgUs) / 8;
+}
+
+// Systems run in the order they were added, except that a system with no
+// conflict against anything since its last conflicting predecessor joins
+// that predecessor's following stage. Systems in one stage may run in
+// parallel; one is handed to a stage worker only while its running average
+// cost is at least parallelMinUs, so tiny systems are not slowed down by
+// the hand-off. The workers are a small pool started the first time a
+// system qualifies and kept until the scheduler goes away; a scheduler
+// whose systems all stay cheap never starts a thread.
+struct SystemScheduler {
+    std::vector<SystemDesc> systems;
+    std::vector<std::vector<int> > stages;
+    std::vector<Commands> commands;
+    std::vector<double> avgUs;
+    bool parallel;
+    double parallelMinUs;
+    ThreadPool* workers;   // ROLE_SIMULATION stage workers, or nullptr
+    bool workersFailed;    // do not retry every frame
+
+    SystemScheduler() : parallel(true), parallelMinUs(ECS_PARALLEL_MIN_US), workers(nullptr), workersFailed(false) {}
+
+    // A copy shares no threads; it starts its own workers when it needs them
+    SystemScheduler(const SystemScheduler& other)
+        : systems(other.systems), stages(other.stages), commands(other.commands), avgUs(other.avgUs),
+          parallel(other.parallel), parallelMinUs(other.parallelMinUs), workers(nullptr), workersFailed(false) {}
+
+    SystemScheduler& operator=(const SystemScheduler& other) {
+        if (this != &other) {
+            systems = other.systems;
+            stages = other.stages;
+            commands = other.commands;
+            avgUs = other.avgUs;
+            parallel = other.parallel;
+            parallelMinUs = other.parallelMinUs;
+        }
+        return *this;
+    }
+
+    ~SystemScheduler() { delete workers; }
+
+    void add(const SystemDesc& s) {
+        systems.push_back(s);
+        commands.resize(systems.size());
+        avgUs.push_back(0);
+
+        int stage = 0;
+        for (size_t st = 0; st < stages.size(); st++) {
+            for (size_t i = 0; i < stages[st].size(); i++) {
+                if (systemsConflict(systems[stages[st][i]], s)) stage = static_cast<int>(st) + 1;
+            }
+        }
+        while (stage < static_cast<int>(stages.size()) && stages[stage].size() >= ECS_MAX_STAGE_SYSTEMS) stage++;
+        if (stage == static_cast<int>(stages.size())) stages.push_back(std::vector<int>());
+        stages[stage].push_back(static_cast<int>(systems.size()) - 1);
+    }
+
+    void run(World& world, void* ctx) {
+        for (size_t st = 0; st < stages.size(); st++) {
+            const std::vector<int>& stage = stages[st];
+            SystemJob jobs[ECS_MAX_STAGE_SYSTEMS];
+            for (size_t i = 0; i < stage.size(); i++) {
+                SystemJob job = {&systems[stage[i]], ctx, &world, &commands[stage[i]], &avgUs[stage[i]]};
+                jobs[i] = job;
+            }
+            // The calling thread takes the first system of the stage, and
+            // any that are too cheap to hand off or find no worker
+            bool handedOff = false;
+            for (size_t i = 1; i < stage.size(); i++) {
+                if (parallel && avgUs[stage[i]] >= parallelMinUs && startWorkers()) {
+                    workers->submit(systemWorker, &jobs[i]);
+                    handedOff = true;
+                } else {
+                    systemWorker(&jobs[i]);
+                }
+            }
+            systemWorker(&jobs[0]);
+            if (handedOff) workers->waitIdle();
+            for (size_t i = 0; i < stage.size(); i++) world.apply(commands[stage[i]]);
+        }
+    }
+
+    bool startWorkers() {
+        if (workers) return true;
+        if (workersFailed) return false;
+        workers = new ThreadPool;
+        workers->role = ROLE_SIMULATION;
+        if (workers->start(ECS_MAX_STAGE_SYSTEMS - 1) == 0) {
+            delete workers;
+            workers = nullptr;
+            workersFailed = true;
+        }
+        return workers != nullptr;
+    }
+
+    // e.g. "movement | pickup, render | expiry | spawn"
+    std::string describe() const {
+        std::string out;
+        for (size_t st = 0; st < stages.size(); st++) {
+            if (st) out += " | ";
+            for (size_t i = 0; i < stages[st].size(); i++) {
+                if (i) out += ", ";
+                out += systems[stages[st][i]].name;
+            }
+        }
+        return out;
+    }
+};
+
+#endif
@@ -0,0 +1,331 @@
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <pthread.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Structured binary event log. Each producing thread owns a ring of fixed
+// 32-byte records and is its only writer, so logging an event is a clock
+// read, a copy and a release store; no lock and no system call. A
+// background thread drains every ring a few dozen times a second and
+// appends the records to a file that is rotated when it grows too large.
+// A full ring drops the event and counts it; the count is logged as an
+// EVENT_DROPPED record once the ring has room again.
+//
+// Decode with eventlog_decode (text or JSON lines).
+
+#define EVENTLOG_MAGIC 0x56454D47u   // "MGEV"
+#define EVENTLOG_VERSION 1
+#define EVENTLOG_RING_RECORDS 8192   // per thread, power of two
+#define EVENTLOG_MAX_THREADS 64
+#define EVENTLOG_FLUSH_MS 20
+#define EVENTLOG_DEFAULT_FILE_BYTES (64 << 20)
+#define EVENTLOG_KEEP_FILES 4        // the live file plus .1 .. .3
+
+enum EventType {
+    EVENT_MOVE = 1,          // player, x, y (cell moved to)
+    EVENT_MOVE_REJECTED,     // player, x, y (wall or crate)
+    EVENT_PICKUP,            // player, x, y, score
+    EVENT_SPAWN,             // x, y, coins spawned
+    EVENT_SPAWN_FAILED,      // coins spawned
+    EVENT_GAME_OVER,         // winner (-1 for a tie), score
+    EVENT_THREAD_START,      // role, index
+    EVENT_THREAD_STOP,       // role, index
+    EVENT_DROPPED,           // records lost to a full ring
+    EVENT_TYPE_END
+};
+
+struct EventRecord {
+    uint64_t timeNs;   // CLOCK_MONOTONIC
+    uint16_t type;
+    uint16_t thread;   // ring index; reused after a thread exits
+    uint32_t source;   // match slot in the server, 0 in the game
+    int32_t args[4];
+};
+
+static_assert(sizeof(EventRecord) == 32, "records are a fixed 32 bytes on disk");
+
+struct EventFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t reserved;
+    uint64_t monotonicNs;   // the same instant on both clocks, to place
+    uint64_t realtimeNs;    // records in wall-clock time
+};
+
+struct EventTypeInfo {
+    const char* name;
+    const char* args[4];   // nullptr past the last argument
+};
+
+inline const EventTypeInfo& eventTypeInfo(int type) {
+    static const EventTypeInfo info[EVENT_TYPE_END] = {
+        {"unknown", {nullptr, nullptr, nullptr, nullptr}},
+        {"move", {"player", "x", "y", nullptr}},
+        {"move_rejected", {"player", "x", "y", nullptr}},
+        {"pickup", {"player", "x", "y", "score"}},
+        {"spawn", {"x", "y", "spawned", nullptr}},
+        {"spawn_failed", {"spawned", nullptr, nullptr, nullptr}},
+        {"game_over", {"winner", "score", nullptr, nullptr}},
+        {"thread_start", {"role", "index", nullptr, nullptr}},
+        {"thread_stop", {"role", "index", nullptr, nullptr}},
+        {"dropped", {"count", nullptr, nullptr, nullptr}}
+    };
+    return info[type > 0 && type < EVENT_TYPE_END ? type : 0];
+}
+
+inline uint64_t eventClockNs(clockid_t clock = CLOCK_MONOTONIC) {
+    timespec ts;
+    clock_gettime(clock, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+// Single producer (the owning thread), single consumer (the flusher)
+struct EventRing {
+    std::atomic<uint64_t> head;      // next slot the producer writes
+    char pad0[56];
+    std::atomic<uint64_t> tail;      // next slot the flusher reads
+    char pad1[56];
+    std::atomic<uint64_t> dropped;   // written by the producer, taken by the flusher
+    uint64_t droppedReported;        // flusher only
+    uint16_t id;
+    EventRecord records[EVENTLOG_RING_RECORDS];
+
+    explicit EventRing(uint16_t index) : head(0), tail(0), dropped(0), droppedReported(0), id(index) {}
+
+    void push(const EventRecord& r) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= EVENTLOG_RING_RECORDS) {
+            dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+        records[h & (EVENTLOG_RING_RECORDS - 1)] = r;
+        head.store(h + 1, std::memory_order_release);
+    }
+};
+
+struct EventLog {
+    std::atomic<bool> running;
+    EventRing* rings[EVENTLOG_MAX_THREADS];
+    std::atomic<int> ringCount;
+    int freeRings[EVENTLOG_MAX_THREADS];
+    int freeCount;
+    pthread_mutex_t ringLock;
+    std::atomic<uint64_t> unringed;   // events from threads past EVENTLOG_MAX_THREADS
+
+    std::string path;
+    uint64_t maxFileBytes;
+    int keepFiles;
+    int fd;
+    uint64_t fileBytes;
+    uint64_t recordsWritten;
+    uint64_t rotations;
+    bool writeFailed;
+    pthread_t flusher;
+    std::atomic<bool> stopping;
+
+    EventLog() : running(false), ringCount(0), freeCount(0), unringed(0), maxFileBytes(EVENTLOG_DEFAULT_FILE_BYTES),
+                 keepFiles(EVENTLOG_KEEP_FILES), fd(-1), fileBytes(0), recordsWritten(0), rotations(0),
+                 writeFailed(false), stopping(false) {
+        for (int i = 0; i < EVENTLOG_MAX_THREADS; i++) rings[i] = nullptr;
+        pthread_mutex_init(&ringLock, nullptr);
+    }
+
+    bool open(const char* filePath, uint64_t maxBytes = EVENTLOG_DEFAULT_FILE_BYTES, int keep = EVENTLOG_KEEP_FILES) {
+        if (running) return false;
+        path = filePath;
+        maxFileBytes = maxBytes > sizeof(EventFileHeader) + sizeof(EventRecord) ? maxBytes : EVENTLOG_DEFAULT_FILE_BYTES;
+        keepFiles = keep > 0 ? keep : 1;
+        writeFailed = false;
+        if (!openFile()) return false;
+        stopping = false;
+        running = true;
+        if (pthread_create(&flusher, nullptr, flushLoop, this) != 0) {
+            running = false;
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+        return true;
+    }
+
+    // Writes out everything logged so far and stops; events logged while
+    // closing may be lost
+    void close() {
+        if (!running) return;
+        running = false;
+        stopping = true;
+        pthread_join(flusher, nullptr);
+        ::close(fd);
+        fd = -1;
+    }
+
+    uint64_t dropped() const {
+        uint64_t n = unringed.load(std::memory_order_relaxed);
+        int count = ringCount.load(std::memory_order_acquire);
+        for (int i = 0; i < count; i++) n += rings[i]->dropped.load(std::memory_order_relaxed);
+        return n;
+    }
+
+    EventRing* claimRing() {
+        pthread_mutex_lock(&ringLock);
+        EventRing* ring = nullptr;
+        if (freeCount > 0) {
+            ring = rings[freeRings[--freeCount]];
+        } else {
+            int count = ringCount.load(std::memory_order_relaxed);
+            if (count < EVENTLOG_MAX_THREADS) {
+                ring = new EventRing(static_cast<uint16_t>(count));
+                rings[count] = ring;
+                ringCount.store(count + 1, std::memory_order_release);
+            }
+        }
+        pthread_mutex_unlock(&ringLock);
+        return ring;
+    }
+
+    void releaseRing(EventRing* ring) {
+        pthread_mutex_lock(&ringLock);
+        freeRings[freeCount++] = ring->id;
+        pthread_mutex_unlock(&ringLock);
+    }
+
+private:
+    bool openFile() {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return false;
+        EventFileHeader header = {EVENTLOG_MAGIC, EVENTLOG_VERSION, sizeof(EventRecord), 0,
+                                  eventClockNs(), eventClockNs(CLOCK_REALTIME)};
+        fileBytes = 0;
+        return writeAll(&header, sizeof(header));
+    }
+
+    bool writeAll(const void* data, size_t size) {
+        const char* p = static_cast<const char*>(data);
+        while (size > 0) {
+            ssize_t n = ::write(fd, p, size);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n;
+            size -= static_cast<size_t>(n);
+            fileBytes += static_cast<uint64_t>(n);
+        }
+        return true;
+    }
+
+    // log -> log.1 -> log.2 ...; the oldest is overwritten
+    bool rotate() {
+        ::close(fd);
+        for (int i = keepFiles - 1; i >= 1; i--) {
+            std::string from = i == 1 ? path : path + "." + std::to_string(i - 1);
+            std::string to = path + "." + std::to_string(i);
+            rename(from.c_str(), to.c_str());
+        }
+        rotations++;
+        return openFile();
+    }
+
+    void append(const EventRecord* records, size_t count) {
+        while (count > 0 && !writeFailed) {
+            uint64_t room = (maxFileBytes - fileBytes) / sizeof(EventRecord);
+            if (room == 0) {
+                if (keepFiles > 1 && rotate()) continue;
+                writeFailed = true;   // one file only, and it is full
+                break;
+            }
+            size_t n = count < room ? count : static_cast<size_t>(room);
+            if (!writeAll(records, n * sizeof(EventRecord))) {
+                writeFailed = true;
+                break;
+            }
+            recordsWritten += n;
+            records += n;
+            count -= n;
+        }
+    }
+
+    void drain(std::vector<EventRecord>& batch) {
+        int count = ringCount.load(std::memory_order_acquire);
+        for (int i = 0; i < count; i++) {
+            EventRing* ring = rings[i];
+            uint64_t t = ring->tail.load(std::memory_order_relaxed);
+            uint64_t h = ring->head.load(std::memory_order_acquire);
+            batch.clear();
+            for (; t < h; t++) batch.push_back(ring->records[t & (EVENTLOG_RING_RECORDS - 1)]);
+            ring->tail.store(t, std::memory_order_release);
+
+            uint64_t lost = ring->dropped.load(std::memory_order_relaxed);
+            if (lost != ring->droppedReported) {
+                EventRecord r;
+                memset(&r, 0, sizeof(r));
+                r.timeNs = eventClockNs();
+                r.type = EVENT_DROPPED;
+                r.thread = ring->id;
+                r.args[0] = static_cast<int32_t>(lost - ring->droppedReported);
+                batch.push_back(r);
+                ring->droppedReported = lost;
+            }
+            if (!batch.empty()) append(batch.data(), batch.size());
+        }
+    }
+
+    static void* flushLoop(void* arg) {
+        EventLog* log = static_cast<EventLog*>(arg);
+        pthread_setname_np(pthread_self(), "maga-eventlog");
+        std::vector<EventRecord> batch;
+        batch.reserve(EVENTLOG_RING_RECORDS + 1);
+        while (!log->stopping) {
+            usleep(EVENTLOG_FLUSH_MS * 1000);
+            log->drain(batch);
+        }
+        log->drain(batch);
+        return nullptr;
+    }
+};
+
+inline EventLog& eventLog() {
+    static EventLog log;
+    return log;
+}
+
+// Claims a ring on the thread's first event and hands it back on exit
+struct EventThreadRing {
+    EventRing* ring;
+    EventThreadRing() : ring(eventLog().claimRing()) {}
+    ~EventThreadRing() {
+        if (ring) eventLog().releaseRing(ring);
+    }
+};
+
+// Does nothing unless the log is open
+inline void logEvent(EventType type, int32_t a = 0, int32_t b = 0, int32_t c = 0, int32_t d = 0, uint32_t source = 0) {
+    EventLog& log = eventLog();
+    if (!log.running.load(std::memory_order_relaxed)) return;
+    static thread_local EventThreadRing local;
+    if (!local.ring) {
+        log.unringed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    EventRecord r;
+    r.timeNs = eventClockNs();
+    r.type = static_cast<uint16_t>(type);
+    r.thread = local.ring->id;
+    r.source = source;
+    r.args[0] = a;
+    r.args[1] = b;
+    r.args[2] = c;
+    r.args[3] = d;
+    local.ring->push(r);
+}
+
+#endif
@@ -0,0 +1,102 @@
+// Prints the records of binary event logs written by --event-log.
+// g++ -std=c++11 -O2 eventlog_decode.cpp -o eventlog_decode
+// ./eventlog_decode game.evlog.1 game.evlog         one line of text per event
+// ./eventlog_decode --json server.evlog | jq ...     one JSON object per line
+// Files are printed in the order given (oldest rotation first); records
+// within a file are sorted by time, since each thread's ring is flushed
+// as a batch.
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "eventlog.h"
+#include "threadconf.h"
+
+static bool earlier(const EventRecord& a, const EventRecord& b) { return a.timeNs < b.timeNs; }
+
+static bool readFile(const char* path, EventFileHeader& header, std::vector<EventRecord>& records) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return false;
+    }
+    bool ok = fread(&header, sizeof(header), 1, f) == 1 && header.magic == EVENTLOG_MAGIC;
+    if (!ok) {
+        fprintf(stderr, "%s is not an event log\n", path);
+    } else if (header.version != EVENTLOG_VERSION || header.recordSize != sizeof(EventRecord)) {
+        fprintf(stderr, "%s: version %u with %u-byte records, expected %d with %d\n", path, header.version,
+                header.recordSize, EVENTLOG_VERSION, static_cast<int>(sizeof(EventRecord)));
+        ok = false;
+    }
+    if (ok) {
+        EventRecord r;
+        records.clear();
+        while (fread(&r, sizeof(r), 1, f) == 1) records.push_back(r);
+    }
+    fclose(f);
+    return ok;
+}
+
+static void printText(const EventFileHeader& header, const EventRecord& r) {
+    const EventTypeInfo& info = eventTypeInfo(r.type);
+    double t = (static_cast<double>(r.timeNs) - static_cast<double>(header.monotonicNs)) / 1e9;
+    printf("%12.6f  t%-2u s%-3u %-13s", t, r.thread, r.source, info.name);
+    for (int a = 0; a < 4 && info.args[a]; a++) {
+        if (a == 0 && (r.type == EVENT_THREAD_START || r.type == EVENT_THREAD_STOP)) {
+            printf(" role=%s", threadRoleName(r.args[0]));
+        } else {
+            printf(" %s=%d", info.args[a], r.args[a]);
+        }
+    }
+    printf("\n");
+}
+
+static void printJson(const EventFileHeader& header, const EventRecord& r) {
+    const EventTypeInfo& info = eventTypeInfo(r.type);
+    unsigned long long wallNs = header.realtimeNs + (r.timeNs - header.monotonicNs);
+    printf("{\"time_ns\":%llu,\"wall_ns\":%llu,\"type\":\"%s\",\"thread\":%u,\"source\":%u",
+           static_cast<unsigned long long>(r.timeNs), wallNs, info.name, r.thread, r.source);
+    for (int a = 0; a < 4 && info.args[a]; a++) {
+        if (a == 0 && (r.type == EVENT_THREAD_START || r.type == EVENT_THREAD_STOP)) {
+            printf(",\"role\":\"%s\"", threadRoleName(r.args[0]));
+        } else {
+            printf(",\"%s\":%d", info.args[a], r.args[a]);
+        }
+    }
+    printf("}\n");
+}
+
+int main(int argc, char** argv) {
+    bool json = false;
+    std::vector<const char*> paths;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty()) {
+        fprintf(stderr, "usage: %s [--json] <event log>...\n", argv[0]);
+        return -1;
+    }
+
+    int status = 0;
+    std::vector<EventRecord> records;
+    for (size_t i = 0; i < paths.size(); i++) {
+        EventFileHeader header;
+        if (!readFile(paths[i], header, records)) {
+            status = -1;
+            continue;
+        }
+        std::stable_sort(records.begin(), records.end(), earlier);
+        for (size_t r = 0; r < records.size(); r++) {
+            if (json) {
+                printJson(header, records[r]);
+            } else {
+                printText(header, records[r]);
+            }
+        }
+    }
+    return status;
+}
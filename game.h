@@ -0,0 +1,182 @@
+#ifndef GAME_H
+#define GAME_H
+
+#include <cstdint>
+#include <vector>
+#include "rng.h"
+#include "mapgen.h"
+#include "connectivity.h"
+#include "board.h"
+#include "ecs.h"
+#include "leaderboard.h"
+
+#define TOTAL_PLAYERS 2
+#define MAX_ITEMS 40
+#define GAME_DURATION 60
+#define ITEM_SPAWN_INTERVAL 2
+#define MAX_CRATES 7
+#define MAX_GRID_SIZE 32   // generateGridSize never goes past 25
+
+// Message structures for thread communication
+struct MoveMessage {
+    int playerID;
+    int newX;
+    int newY;
+    int64_t dueUs;   // when the input scheduler decided to move
+};
+
+enum SpriteId {
+    SPRITE_CRATE,
+    SPRITE_ITEM,
+    SPRITE_PLAYER   // + player index
+};
+
+inline EntityDesc crateDesc(int x, int y) {
+    EntityDesc d;
+    d.mask = COMP_POSITION | COMP_OBSTACLE | COMP_SPRITE;
+    d.position.x = x;
+    d.position.y = y;
+    d.sprite.id = SPRITE_CRATE;
+    return d;
+}
+
+// lifetime <= 0 means the coin stays until someone collects it
+inline EntityDesc itemDesc(int x, int y, float spawnTime, float lifetime) {
+    EntityDesc d;
+    d.mask = COMP_POSITION | COMP_COLLECTIBLE | COMP_SPRITE;
+    d.position.x = x;
+    d.position.y = y;
+    d.collectible.value = 1;
+    d.collectible.spawnTime = spawnTime;
+    d.sprite.id = SPRITE_ITEM;
+    if (lifetime > 0) {
+        d.mask |= COMP_LIFETIME;
+        d.lifetime.expiresAt = spawnTime + lifetime;
+    }
+    return d;
+}
+
+inline EntityDesc playerDesc(int playerNum, int x, int y) {
+    EntityDesc d;
+    d.mask = COMP_POSITION | COMP_SCORE | COMP_SPRITE;
+    d.position.x = x;
+    d.position.y = y;
+    d.sprite.id = SPRITE_PLAYER + playerNum;
+    return d;
+}
+
+// Everything that defines a match, without any rendering or threading state.
+// Players, crates and coins are entities in world; the occupancy structures
+// (board, connectivity) are derived from them and can always be rebuilt.
+struct MatchState {
+    int gridSize;
+    uint64_t seed;
+    World world;
+    Entity players[TOTAL_PLAYERS];
+    ConnectivityIndex connectivity;
+    Board<MAX_GRID_SIZE> board;
+    Leaderboard leaderboard;   // mirrors the players' Score components
+    Rng spawnRng;
+    float lastItemSpawnTime;
+    int itemsSpawned;    // coins spawned so far, capped at MAX_ITEMS per match
+    float itemLifetime;  // seconds a coin stays on the board, 0 = until collected
+    float clockOffset;   // match time already played before a restore
+
+    MatchState() : gridSize(0), seed(0), lastItemSpawnTime(0), itemsSpawned(0), itemLifetime(0), clockOffset(0) {
+        // Coins are found by position through world.spatial
+        world.spatialMask = COMP_POSITION | COMP_COLLECTIBLE;
+        for (int i = 0; i < TOTAL_PLAYERS; i++) {
+            players[i].index = 0;
+            players[i].generation = 0;
+        }
+    }
+
+    // Clears the world and creates the players at their start cells
+    void resetWorld() {
+        world.clear();
+        for (int i = 0; i < TOTAL_PLAYERS; i++) {
+            int start = i == 0 ? 1 : gridSize - 2;
+            players[i] = world.create(playerDesc(i, start, start));
+        }
+        leaderboard.reset(TOTAL_PLAYERS);
+    }
+
+    Position& playerPos(int i) { return world.get<Position>(players[i]); }
+    int playerScore(int i) const { return world.get<Score>(players[i]).value; }
+
+    // Score changes go through here so the leaderboard stays in step
+    void setScore(int i, int score) {
+        world.get<Score>(players[i]).value = score;
+        leaderboard.set(i, score);
+    }
+
+    void addScore(int i, int delta) { setScore(i, playerScore(i) + delta); }
+
+    // Index of a player entity, or -1
+    int playerIndex(Entity e) const {
+        for (int i = 0; i < TOTAL_PLAYERS; i++) {
+            if (players[i] == e) return i;
+        }
+        return -1;
+    }
+
+    void rebuildOccupancy() {
+        GameMap map;
+        map.size = gridSize;
+        map.cells.assign(gridSize * gridSize, CELL_FLOOR);
+        for (int i = 0; i < gridSize; i++) {
+            map.cells[i] = map.cells[(gridSize - 1) * gridSize + i] = CELL_WALL;
+            map.cells[i * gridSize] = map.cells[i * gridSize + gridSize - 1] = CELL_WALL;
+        }
+        board.reset(gridSize);
+        world.each(COMP_POSITION | COMP_OBSTACLE, 0, [&](Archetype& a) {
+            for (int r = 0; r < a.size(); r++) {
+                const Position& p = a.positions[r];
+                map.cells[p.x * gridSize + p.y] = CELL_WALL;
+                board.setCrate(p.x, p.y);
+            }
+        });
+        connectivity.build(map);
+        world.each(COMP_POSITION | COMP_COLLECTIBLE, 0, [&](Archetype& a) {
+            for (int r = 0; r < a.size(); r++) {
+                const Position& p = a.positions[r];
+                connectivity.markOccupied(p.x, p.y);
+                board.setItem(p.x, p.y);
+            }
+        });
+    }
+};
+
+inline void generateCrates(World& world, const GameMap& map) {
+    for (int x = 1; x < map.size - 1; x++) {
+        for (int y = 1; y < map.size - 1; y++) {
+            if (!map.isWall(x, y)) continue;
+            world.create(crateDesc(x, y));
+        }
+    }
+}
+
+// Starts a fresh match: players at opposite corners and MAX_CRATES crates,
+// with every floor cell reachable from both starts
+inline void setupMatch(MatchState& match, uint64_t seed, int gridSize) {
+    MapConfig mapConfig;
+    mapConfig.type = MAP_RANDOM_FILL;
+    mapConfig.size = gridSize;
+    mapConfig.seed = seed;
+    mapConfig.obstacleCount = MAX_CRATES;
+    mapConfig.starts.push_back(std::make_pair(1, 1));
+    mapConfig.starts.push_back(std::make_pair(gridSize - 2, gridSize - 2));
+    GameMap map = generateMap(mapConfig);
+
+    match.gridSize = gridSize;
+    match.seed = seed;
+    match.spawnRng = rngStream(seed, RNG_STREAM_SPAWN);
+    match.lastItemSpawnTime = 0;
+    match.itemsSpawned = 0;
+    match.clockOffset = 0;
+    match.resetWorld();
+    generateCrates(match.world, map);
+    match.rebuildOccupancy();
+}
+
+#endif
@@ -0,0 +1,173 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+#define INPUT_INITIAL_DELAY_MS 200
+#define INPUT_REPEAT_MS 100
+#define LATENCY_BUCKETS 160
+
+enum MoveDir {
+    DIR_NONE = -1,
+    DIR_UP = 0,
+    DIR_DOWN,
+    DIR_LEFT,
+    DIR_RIGHT
+};
+
+#define DIR_BIT(d) (1u << (d))
+
+inline int64_t monotonicMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline void dirToDelta(int dir, int& dx, int& dy) {
+    static const int DX[4] = {-1, 1, 0, 0};
+    static const int DY[4] = {0, 0, -1, 1};
+    dx = DX[dir];
+    dy = DY[dir];
+}
+
+// Key-repeat for one player, fed the held-direction mask once per tick.
+// A newly pressed direction moves at once (or as soon as the previous move
+// has cooled down, buffered in a single pending slot so quick taps and
+// turns are not lost). Holding a key repeats it after initialDelay, then
+// every repeat. Nothing here sleeps; timing comes from the caller's clock.
+struct InputScheduler {
+    int64_t initialDelayUs;
+    int64_t repeatUs;
+    unsigned heldMask;
+    int heldDir;
+    int pendingDir;
+    int64_t pendingSince;
+    int64_t nextMoveAt;
+    int64_t nextRepeatAt;
+    int64_t lastDue;       // when the last emitted move became due
+
+    InputScheduler(int initialDelayMs = INPUT_INITIAL_DELAY_MS, int repeatMs = INPUT_REPEAT_MS)
+        : initialDelayUs(initialDelayMs * 1000LL), repeatUs(repeatMs * 1000LL), heldMask(0),
+          heldDir(DIR_NONE), pendingDir(DIR_NONE), pendingSince(0), nextMoveAt(0),
+          nextRepeatAt(0), lastDue(0) {}
+
+    // Returns the direction to move now, or DIR_NONE
+    int update(unsigned mask, int64_t now) {
+        unsigned pressed = mask & ~heldMask;
+        heldMask = mask;
+        if (pressed) {
+            heldDir = lowestDir(pressed);
+            pendingDir = heldDir;
+            pendingSince = now;
+        } else if (heldDir != DIR_NONE && !(mask & DIR_BIT(heldDir))) {
+            // Released; fall back to another key that is still down
+            heldDir = mask ? lowestDir(mask) : DIR_NONE;
+            nextRepeatAt = now + initialDelayUs;
+        }
+
+        if (pendingDir != DIR_NONE) {
+            if (now < nextMoveAt) return DIR_NONE;
+            int dir = pendingDir;
+            pendingDir = DIR_NONE;
+            lastDue = pendingSince > nextMoveAt ? pendingSince : nextMoveAt;
+            nextMoveAt = lastDue + repeatUs;
+            nextRepeatAt = lastDue + initialDelayUs;
+            return dir;
+        }
+
+        if (heldDir != DIR_NONE && now >= nextRepeatAt && now >= nextMoveAt) {
+            lastDue = nextRepeatAt > nextMoveAt ? nextRepeatAt : nextMoveAt;
+            // Fell behind by more than one period: do not burst to catch up
+            if (now - lastDue > repeatUs) lastDue = now;
+            nextMoveAt = lastDue + repeatUs;
+            nextRepeatAt = lastDue + repeatUs;
+            return heldDir;
+        }
+        return DIR_NONE;
+    }
+
+    // Forgets a move owed from before now, such as one sampled against a
+    // match that was since restored; a key still held repeats again after
+    // the initial delay, not at once
+    void dropPending(int64_t now) {
+        pendingDir = DIR_NONE;
+        nextRepeatAt = now + initialDelayUs;
+    }
+
+    // No key held and no move owed: update() returns DIR_NONE until a key
+    // goes down
+    bool idle() const { return heldMask == 0 && pendingDir == DIR_NONE; }
+
+private:
+    static int lowestDir(unsigned mask) {
+        for (int d = DIR_UP; d <= DIR_RIGHT; d++) {
+            if (mask & DIR_BIT(d)) return d;
+        }
+        return DIR_NONE;
+    }
+};
+
+// Input-to-move latency, recorded when a move is applied
+struct LatencyStats {
+    long long count;
+    long long totalUs;
+    long long maxUs;
+
+    LatencyStats() : count(0), totalUs(0), maxUs(0) {}
+
+    void record(long long us) {
+        count++;
+        totalUs += us;
+        if (us > maxUs) maxUs = us;
+    }
+
+    double meanUs() const { return count ? static_cast<double>(totalUs) / count : 0.0; }
+};
+
+// Log-scale histogram, four buckets per power of two (~19% resolution)
+struct LatencyHistogram {
+    uint64_t counts[LATENCY_BUCKETS];
+    uint64_t count;
+    uint64_t maxNs;
+
+    LatencyHistogram() : count(0), maxNs(0) { memset(counts, 0, sizeof(counts)); }
+
+    static int bucket(uint64_t ns) {
+        if (ns < 4) return static_cast<int>(ns);
+        int msb = 63 - __builtin_clzll(ns);
+        int b = 4 * (msb - 1) + static_cast<int>((ns >> (msb - 2)) & 3);
+        return b < LATENCY_BUCKETS ? b : LATENCY_BUCKETS - 1;
+    }
+
+    static uint64_t upperBound(int b) {
+        if (b < 4) return static_cast<uint64_t>(b);
+        int msb = b / 4 + 1;
+        return (static_cast<uint64_t>(4 + b % 4 + 1) << (msb - 2)) - 1;
+    }
+
+    void record(uint64_t ns) {
+        counts[bucket(ns)]++;
+        count++;
+        if (ns > maxNs) maxNs = ns;
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (int b = 0; b < LATENCY_BUCKETS; b++) counts[b] += other.counts[b];
+        count += other.count;
+        maxNs = std::max(maxNs, other.maxNs);
+    }
+
+    uint64_t percentile(double p) const {
+        uint64_t target = static_cast<uint64_t>(p * count);
+        uint64_t seen = 0;
+        for (int b = 0; b < LATENCY_BUCKETS; b++) {
+            seen += counts[b];
+            if (seen > target) return std::min(upperBound(b), maxNs);
+        }
+        return maxNs;
+    }
+};
+
+#endif
@@ -0,0 +1,162 @@
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include <cstdint>
+#include <vector>
+
+// Players ranked by score, kept in order as scores change instead of being
+// sorted every frame. The order is score descending, then player id
+// ascending, so ties always come out the same way.
+//
+// It is a treap with one node per player and subtree sizes: a score change
+// is an O(log n) remove and re-insert, rank-of-player and player-at-rank
+// are one O(log n) walk from the root each. Priorities are a hash of the
+// player id, so the tree shape is deterministic too.
+
+struct LeaderboardNode {
+    int left, right;
+    int size;
+    uint32_t priority;
+};
+
+struct Leaderboard {
+    std::vector<int> scores;
+    std::vector<LeaderboardNode> nodes;   // node i is player i
+    int root;
+    uint64_t version;                     // bumped on every change, for cached views
+
+    Leaderboard() : root(-1), version(0) {}
+
+    int size() const { return static_cast<int>(scores.size()); }
+
+    // players entries, all on score 0
+    void reset(int players) {
+        scores.assign(players, 0);
+        nodes.resize(players);
+        root = -1;
+        for (int p = 0; p < players; p++) {
+            uint64_t h = static_cast<uint64_t>(p) * 0x9E3779B97F4A7C15ull;
+            h ^= h >> 31;
+            h *= 0xBF58476D1CE4E5B9ull;
+            LeaderboardNode n = {-1, -1, 1, static_cast<uint32_t>(h >> 32)};
+            nodes[p] = n;
+            root = merge(root, p);   // ids ascend, so each one goes last
+        }
+        version++;
+    }
+
+    int score(int player) const { return scores[player]; }
+
+    void set(int player, int score) {
+        if (scores[player] == score) return;
+        root = erase(root, player);
+        scores[player] = score;
+        nodes[player].left = nodes[player].right = -1;
+        nodes[player].size = 1;
+        int before, after;
+        split(root, player, before, after);
+        root = merge(merge(before, player), after);
+        version++;
+    }
+
+    void add(int player, int delta) { set(player, scores[player] + delta); }
+
+    // 0 for the leader
+    int rank(int player) const {
+        int r = 0;
+        int t = root;
+        while (t != player) {
+            if (ahead(player, t)) {
+                t = nodes[t].left;
+            } else {
+                r += sizeOf(nodes[t].left) + 1;
+                t = nodes[t].right;
+            }
+        }
+        return r + sizeOf(nodes[player].left);
+    }
+
+    // Player at a rank, or -1 past the end
+    int at(int rank) const {
+        int t = root;
+        while (t >= 0) {
+            int leftSize = sizeOf(nodes[t].left);
+            if (rank < leftSize) {
+                t = nodes[t].left;
+            } else if (rank == leftSize) {
+                return t;
+            } else {
+                rank -= leftSize + 1;
+                t = nodes[t].right;
+            }
+        }
+        return -1;
+    }
+
+    // Writes up to k players in rank order; returns how many
+    int top(int k, int* out) const {
+        int count = 0;
+        while (count < k && count < size()) {
+            out[count] = at(count);
+            count++;
+        }
+        return count;
+    }
+
+    // Whether the top two share the leading score
+    bool tiedForLead() const {
+        int lead[2];
+        return top(2, lead) == 2 && scores[lead[0]] == scores[lead[1]];
+    }
+
+private:
+    // a is ranked ahead of b
+    bool ahead(int a, int b) const { return scores[a] != scores[b] ? scores[a] > scores[b] : a < b; }
+
+    int sizeOf(int t) const { return t >= 0 ? nodes[t].size : 0; }
+
+    void pull(int t) { nodes[t].size = 1 + sizeOf(nodes[t].left) + sizeOf(nodes[t].right); }
+
+    // Everything in a is ranked ahead of everything in b
+    int merge(int a, int b) {
+        if (a < 0) return b;
+        if (b < 0) return a;
+        if (nodes[a].priority > nodes[b].priority) {
+            nodes[a].right = merge(nodes[a].right, b);
+            pull(a);
+            return a;
+        }
+        nodes[b].left = merge(a, nodes[b].left);
+        pull(b);
+        return b;
+    }
+
+    // Splits t into the nodes ranked ahead of player and the rest
+    void split(int t, int player, int& before, int& after) {
+        if (t < 0) {
+            before = after = -1;
+            return;
+        }
+        if (ahead(t, player)) {
+            split(nodes[t].right, player, nodes[t].right, after);
+            before = t;
+        } else {
+            split(nodes[t].left, player, before, nodes[t].left);
+            after = t;
+        }
+        pull(t);
+    }
+
+    int erase(int t, int player) {
+        if (t == player) return merge(nodes[t].left, nodes[t].right);
+        if (ahead(player, t)) {
+            nodes[t].left = erase(nodes[t].left, player);
+        } else {
+            nodes[t].right = erase(nodes[t].right, player);
+        }
+        pull(t);
+        return t;
+    }
+};
+
+#endif
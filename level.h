@@ -0,0 +1,335 @@
+#ifndef LEVEL_H
+#define LEVEL_H
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "game.h"
+#include "mapgen.h"
+
+// Level file format: a header, the spawn points, a wall bit per cell and
+// the crates, optionally followed by a chunk index. The file is memory
+// mapped and nothing is read up front, so a huge level opens in a few
+// microseconds and only the pages of the regions looked at are faulted in.
+//
+// Walls are stored chunk by chunk (chunkSize x chunkSize bits, row-major
+// inside a chunk, chunks row-major), so a square region touches a few
+// contiguous runs instead of one run per row. Crates are sorted in the
+// same chunk order; the index holds each chunk's first crate. Without the
+// index, crate lookups scan the whole crate layer.
+
+#define LEVEL_MAGIC 0x564C474Du   // "MGLV"
+#define LEVEL_VERSION 1
+#define LEVEL_DEFAULT_CHUNK 64
+#define LEVEL_MAX_SIZE 65535
+#define LEVEL_PAGE 4096
+#define LEVEL_CHUNK_INDEX 1u      // header flag
+
+struct LevelHeader {
+    uint32_t magic;
+    uint32_t version;
+    int32_t size;
+    int32_t chunkSize;       // power of two, 8..256
+    uint32_t flags;
+    uint32_t spawnCount;
+    uint64_t crateCount;
+    uint64_t seed;           // generator seed of a baked map, 0 if authored
+    uint64_t spawnsOffset;
+    uint64_t tilesOffset;    // page aligned
+    uint64_t cratesOffset;
+    uint64_t indexOffset;    // chunkCount + 1 entries, or 0
+};
+
+struct LevelPoint {
+    uint16_t x, y;
+};
+
+inline bool levelChunkSizeValid(int chunk) {
+    return chunk >= 8 && chunk <= 256 && (chunk & (chunk - 1)) == 0;
+}
+
+// Chunk of a cell in file order
+inline int levelChunkOf(int x, int y, int chunkSize, int chunksPerSide) {
+    return (x / chunkSize) * chunksPerSide + y / chunkSize;
+}
+
+// A read-only view of a mapped level file
+struct LevelFile {
+    const uint8_t* base;
+    size_t length;
+    LevelHeader header;
+    int chunksPerSide;
+    size_t chunkBytes;
+
+    LevelFile() : base(nullptr), length(0), chunksPerSide(0), chunkBytes(0) {
+        memset(&header, 0, sizeof(header));
+    }
+    ~LevelFile() { close(); }
+    LevelFile(const LevelFile&) = delete;
+    LevelFile& operator=(const LevelFile&) = delete;
+
+    // Checks the header and that every section lies inside the file;
+    // reads nothing else
+    bool open(const std::string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(LevelHeader))) {
+            ::close(fd);
+            return false;
+        }
+        size_t size = static_cast<size_t>(st.st_size);
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) return false;
+        // Access follows the regions in play, not the file order
+        madvise(mapped, size, MADV_RANDOM);
+        base = static_cast<const uint8_t*>(mapped);
+        length = size;
+        memcpy(&header, base, sizeof(header));
+        if (!validate()) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (base) munmap(const_cast<uint8_t*>(base), length);
+        base = nullptr;
+        length = 0;
+    }
+
+    bool isOpen() const { return base != nullptr; }
+    int size() const { return header.size; }
+    int chunkCount() const { return chunksPerSide * chunksPerSide; }
+    bool hasChunkIndex() const { return (header.flags & LEVEL_CHUNK_INDEX) != 0; }
+    size_t crateCount() const { return static_cast<size_t>(header.crateCount); }
+    int spawnCount() const { return static_cast<int>(header.spawnCount); }
+
+    LevelPoint spawn(int i) const { return point(header.spawnsOffset, i); }
+    LevelPoint crate(size_t i) const { return point(header.cratesOffset, i); }
+
+    bool isWall(int x, int y) const {
+        int cs = header.chunkSize;
+        const uint8_t* chunk = base + header.tilesOffset + levelChunkOf(x, y, cs, chunksPerSide) * chunkBytes;
+        int bit = (x & (cs - 1)) * cs + (y & (cs - 1));
+        return (chunk[bit >> 3] >> (bit & 7)) & 1;
+    }
+
+    // Walls of the half-open window [x0, x1) x [y0, y1), row-major
+    void readRegion(int x0, int y0, int x1, int y1, std::vector<uint8_t>& cells) const {
+        cells.assign(static_cast<size_t>(x1 - x0) * (y1 - y0), CELL_FLOOR);
+        int cs = header.chunkSize;
+        for (int x = x0; x < x1; x++) {
+            uint8_t* out = &cells[static_cast<size_t>(x - x0) * (y1 - y0)];
+            // One chunk row at a time: its bits are contiguous
+            for (int y = y0; y < y1; y = (y / cs + 1) * cs) {
+                const uint8_t* row = base + header.tilesOffset + levelChunkOf(x, y, cs, chunksPerSide) * chunkBytes;
+                int bit = (x & (cs - 1)) * cs - (y / cs) * cs;
+                int end = std::min(y1, (y / cs + 1) * cs);
+                for (int c = y; c < end; c++) out[c - y0] = (row[(bit + c) >> 3] >> ((bit + c) & 7)) & 1;   // CELL_WALL is 1
+            }
+        }
+    }
+
+    // Calls fn(x, y) for every crate in the window; with the index only the
+    // chunks that overlap it are read
+    template <typename Fn>
+    void forEachCrate(int x0, int y0, int x1, int y1, Fn fn) const {
+        if (!hasChunkIndex()) {
+            for (size_t i = 0; i < crateCount(); i++) {
+                LevelPoint p = crate(i);
+                if (p.x >= x0 && p.x < x1 && p.y >= y0 && p.y < y1) fn(p.x, p.y);
+            }
+            return;
+        }
+        int cs = header.chunkSize;
+        for (int cx = x0 / cs; cx <= (x1 - 1) / cs; cx++) {
+            for (int cy = y0 / cs; cy <= (y1 - 1) / cs; cy++) {
+                int c = cx * chunksPerSide + cy;
+                uint64_t first = indexEntry(c), last = indexEntry(c + 1);
+                if (first > last || last > header.crateCount) continue;   // damaged index
+                for (uint64_t i = first; i < last; i++) {
+                    LevelPoint p = crate(static_cast<size_t>(i));
+                    if (p.x >= x0 && p.x < x1 && p.y >= y0 && p.y < y1) fn(p.x, p.y);
+                }
+            }
+        }
+    }
+
+private:
+    LevelPoint point(uint64_t offset, size_t i) const {
+        LevelPoint p;
+        memcpy(&p, base + offset + i * sizeof(LevelPoint), sizeof(p));
+        return p;
+    }
+
+    uint64_t indexEntry(int c) const {
+        uint64_t v;
+        memcpy(&v, base + header.indexOffset + static_cast<size_t>(c) * sizeof(v), sizeof(v));
+        return v;
+    }
+
+    bool section(uint64_t offset, uint64_t bytes) const {
+        return offset >= sizeof(LevelHeader) && offset <= length && bytes <= length - offset;
+    }
+
+    bool validate() {
+        if (header.magic != LEVEL_MAGIC || header.version != LEVEL_VERSION) return false;
+        if (header.size < 3 || header.size > LEVEL_MAX_SIZE || !levelChunkSizeValid(header.chunkSize)) return false;
+        chunksPerSide = (header.size + header.chunkSize - 1) / header.chunkSize;
+        chunkBytes = static_cast<size_t>(header.chunkSize) * header.chunkSize / 8;
+        uint64_t chunks = static_cast<uint64_t>(chunksPerSide) * chunksPerSide;
+        if (header.crateCount > static_cast<uint64_t>(header.size) * header.size) return false;
+        if (!section(header.spawnsOffset, header.spawnCount * sizeof(LevelPoint))) return false;
+        if (header.tilesOffset % LEVEL_PAGE || !section(header.tilesOffset, chunks * chunkBytes)) return false;
+        if (!section(header.cratesOffset, header.crateCount * sizeof(LevelPoint))) return false;
+        if (hasChunkIndex() && !section(header.indexOffset, (chunks + 1) * sizeof(uint64_t))) return false;
+        return true;
+    }
+};
+
+// Writes a level through a temporary file and a rename, like the save
+// files. walls is size x size row-major; crates and spawns are cells.
+inline bool writeLevelFile(const std::string& path, const GameMap& walls, const std::vector<LevelPoint>& crates,
+                           const std::vector<LevelPoint>& spawns, uint64_t seed, int chunkSize = LEVEL_DEFAULT_CHUNK,
+                           bool chunkIndex = true) {
+    int size = walls.size;
+    if (size < 3 || size > LEVEL_MAX_SIZE || !levelChunkSizeValid(chunkSize)) return false;
+    int perSide = (size + chunkSize - 1) / chunkSize;
+    size_t chunks = static_cast<size_t>(perSide) * perSide;
+    size_t chunkBytes = static_cast<size_t>(chunkSize) * chunkSize / 8;
+
+    LevelHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = LEVEL_MAGIC;
+    header.version = LEVEL_VERSION;
+    header.size = size;
+    header.chunkSize = chunkSize;
+    header.flags = chunkIndex ? LEVEL_CHUNK_INDEX : 0;
+    header.spawnCount = static_cast<uint32_t>(spawns.size());
+    header.crateCount = crates.size();
+    header.seed = seed;
+    header.spawnsOffset = sizeof(LevelHeader);
+    uint64_t spawnsEnd = header.spawnsOffset + spawns.size() * sizeof(LevelPoint);
+    header.tilesOffset = (spawnsEnd + LEVEL_PAGE - 1) / LEVEL_PAGE * LEVEL_PAGE;
+    header.cratesOffset = header.tilesOffset + chunks * chunkBytes;
+    uint64_t cratesEnd = header.cratesOffset + crates.size() * sizeof(LevelPoint);
+    header.indexOffset = chunkIndex ? (cratesEnd + 7) / 8 * 8 : 0;
+    uint64_t total = chunkIndex ? header.indexOffset + (chunks + 1) * sizeof(uint64_t) : cratesEnd;
+
+    std::vector<uint8_t> buf(static_cast<size_t>(total), 0);
+    memcpy(buf.data(), &header, sizeof(header));
+    if (!spawns.empty()) memcpy(&buf[header.spawnsOffset], spawns.data(), spawns.size() * sizeof(LevelPoint));
+
+    uint8_t* tiles = &buf[header.tilesOffset];
+    for (int x = 0; x < size; x++) {
+        for (int y = 0; y < size; y++) {
+            if (!walls.isWall(x, y)) continue;
+            int bit = (x & (chunkSize - 1)) * chunkSize + (y & (chunkSize - 1));
+            tiles[levelChunkOf(x, y, chunkSize, perSide) * chunkBytes + (bit >> 3)] |= static_cast<uint8_t>(1u << (bit & 7));
+        }
+    }
+
+    // Crates in chunk order, counted per chunk first
+    std::vector<uint64_t> starts(chunks + 1, 0);
+    for (size_t i = 0; i < crates.size(); i++) {
+        if (crates[i].x >= size || crates[i].y >= size) return false;
+        starts[levelChunkOf(crates[i].x, crates[i].y, chunkSize, perSide) + 1]++;
+    }
+    for (size_t c = 0; c < chunks; c++) starts[c + 1] += starts[c];
+    std::vector<uint64_t> next(starts.begin(), starts.end() - 1);
+    for (size_t i = 0; i < crates.size(); i++) {
+        size_t slot = static_cast<size_t>(next[levelChunkOf(crates[i].x, crates[i].y, chunkSize, perSide)]++);
+        memcpy(&buf[header.cratesOffset + slot * sizeof(LevelPoint)], &crates[i], sizeof(LevelPoint));
+    }
+    if (chunkIndex) memcpy(&buf[header.indexOffset], starts.data(), starts.size() * sizeof(uint64_t));
+
+    std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd < 0) return false;
+    size_t written = 0;
+    while (written < buf.size()) {
+        ssize_t n = ::write(fd, buf.data() + written, buf.size() - written);
+        if (n <= 0) break;
+        written += static_cast<size_t>(n);
+    }
+    bool ok = ::close(fd) == 0 && written == buf.size();
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Splits a generated map the way setupMatch uses it: the border is wall
+// tiles, interior walls become crates (or stay tiles with cratesInside off)
+inline void bakeLevelLayers(const GameMap& map, bool cratesInside, GameMap& walls, std::vector<LevelPoint>& crates) {
+    walls = map;
+    crates.clear();
+    if (!cratesInside) return;
+    for (int x = 1; x < map.size - 1; x++) {
+        for (int y = 1; y < map.size - 1; y++) {
+            if (!map.isWall(x, y)) continue;
+            walls.cells[x * map.size + y] = CELL_FLOOR;
+            LevelPoint p = {static_cast<uint16_t>(x), static_cast<uint16_t>(y)};
+            crates.push_back(p);
+        }
+    }
+}
+
+// Starts a match on a level that fits the game board. Interior walls are
+// played as crates; players start on the first spawn points. The match is
+// left untouched if the level does not fit or is inconsistent.
+inline bool setupMatchFromLevel(MatchState& match, const LevelFile& level, uint64_t seed) {
+    const int n = level.size();
+    if (n > MAX_GRID_SIZE || level.spawnCount() < TOTAL_PLAYERS) return false;
+    for (int x = 0; x < n; x++) {
+        if (!level.isWall(x, 0) || !level.isWall(x, n - 1) || !level.isWall(0, x) || !level.isWall(n - 1, x)) {
+            return false;
+        }
+    }
+    std::vector<uint8_t> blocked;
+    level.readRegion(0, 0, n, n, blocked);
+    bool bad = false;
+    level.forEachCrate(0, 0, n, n, [&](int x, int y) {
+        if (x < 1 || x > n - 2 || y < 1 || y > n - 2) bad = true;
+        else blocked[x * n + y] = CELL_WALL;
+    });
+    if (bad) return false;
+    for (int i = 0; i < TOTAL_PLAYERS; i++) {
+        LevelPoint s = level.spawn(i);
+        if (s.x < 1 || s.x > n - 2 || s.y < 1 || s.y > n - 2 || blocked[s.x * n + s.y] != CELL_FLOOR) return false;
+    }
+
+    match.gridSize = n;
+    match.seed = seed;
+    match.spawnRng = rngStream(seed, RNG_STREAM_SPAWN);
+    match.lastItemSpawnTime = 0;
+    match.itemsSpawned = 0;
+    match.clockOffset = 0;
+    match.resetWorld();
+    for (int i = 0; i < TOTAL_PLAYERS; i++) {
+        LevelPoint s = level.spawn(i);
+        match.playerPos(i).x = s.x;
+        match.playerPos(i).y = s.y;
+    }
+    for (int x = 1; x < n - 1; x++) {
+        for (int y = 1; y < n - 1; y++) {
+            if (blocked[x * n + y] != CELL_FLOOR) match.world.create(crateDesc(x, y));
+        }
+    }
+    match.rebuildOccupancy();
+    return true;
+}
+
+#endif
@@ -0,0 +1,114 @@
+// Bakes a generated map into a level file for ./prog --level, or prints
+// what a level file holds.
+// g++ -std=c++11 -O2 level_bake.cpp -o level_bake -pthread
+// ./level_bake --seed 7 arena.lvl                      25x25 with MAX_CRATES crates, like a normal start
+// ./level_bake --type caves --size 8192 big.lvl        walls stay tiles on caves and mazes
+// ./level_bake --info big.lvl
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "level.h"
+
+static int printInfo(const char* path) {
+    LevelFile level;
+    if (!level.open(path)) {
+        fprintf(stderr, "%s is not a level file\n", path);
+        return -1;
+    }
+    const LevelHeader& h = level.header;
+    printf("%s: %dx%d, %d-cell chunks (%d), %s, %zu crates, %d spawn points, seed %llu, %zu bytes\n", path, h.size,
+           h.size, h.chunkSize, level.chunkCount(), level.hasChunkIndex() ? "indexed" : "no index",
+           level.crateCount(), level.spawnCount(), static_cast<unsigned long long>(h.seed), level.length);
+    for (int i = 0; i < level.spawnCount(); i++) {
+        LevelPoint s = level.spawn(i);
+        printf("  spawn %d at %u,%u\n", i + 1, s.x, s.y);
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    MapConfig cfg;
+    cfg.size = 25;
+    cfg.seed = 1;
+    cfg.obstacleCount = MAX_CRATES;
+    cfg.threads = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    if (cfg.threads > MAPGEN_MAX_THREADS) cfg.threads = MAPGEN_MAX_THREADS;
+    int chunkSize = LEVEL_DEFAULT_CHUNK;
+    bool chunkIndex = true;
+    int cratesInside = -1;   // default: crates on random fill maps only
+    const char* out = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--info") == 0 && i + 1 < argc) {
+            return printInfo(argv[i + 1]);
+        } else if (strcmp(argv[i], "--type") == 0 && i + 1 < argc) {
+            const char* type = argv[++i];
+            if (strcmp(type, "random") == 0) cfg.type = MAP_RANDOM_FILL;
+            else if (strcmp(type, "caves") == 0) cfg.type = MAP_CAVES;
+            else if (strcmp(type, "maze") == 0) cfg.type = MAP_MAZE;
+            else {
+                fprintf(stderr, "Unknown map type %s (random, caves or maze)\n", type);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            cfg.size = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            cfg.seed = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--obstacles") == 0 && i + 1 < argc) {
+            cfg.obstacleCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--chunk") == 0 && i + 1 < argc) {
+            chunkSize = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--no-index") == 0) {
+            chunkIndex = false;
+        } else if (strcmp(argv[i], "--crates") == 0) {
+            cratesInside = 1;
+        } else if (strcmp(argv[i], "--tiles") == 0) {
+            cratesInside = 0;
+        } else {
+            out = argv[i];
+        }
+    }
+    if (!out) {
+        fprintf(stderr, "usage: %s [--type random|caves|maze] [--size n] [--seed n] [--obstacles n] [--chunk n]\n"
+                        "          [--no-index] [--crates|--tiles] <level file>\n"
+                        "       %s --info <level file>\n", argv[0], argv[0]);
+        return -1;
+    }
+    // GameMap indexes cells with an int
+    if (cfg.size < 5 || cfg.size > 46000) {
+        fprintf(stderr, "--size must be 5..46000\n");
+        return -1;
+    }
+    if (!levelChunkSizeValid(chunkSize)) {
+        fprintf(stderr, "--chunk must be a power of two from 8 to 256\n");
+        return -1;
+    }
+    if (cfg.type == MAP_CAVES) cfg.minComponentSize = 32;
+    cfg.starts.push_back(std::make_pair(1, 1));
+    cfg.starts.push_back(std::make_pair(cfg.size - 2, cfg.size - 2));
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    GameMap map = generateMap(cfg);
+    double genMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    GameMap walls;
+    std::vector<LevelPoint> crates;
+    bakeLevelLayers(map, cratesInside < 0 ? cfg.type == MAP_RANDOM_FILL : cratesInside == 1, walls, crates);
+    std::vector<LevelPoint> spawns;
+    for (size_t i = 0; i < cfg.starts.size(); i++) {
+        LevelPoint s = {static_cast<uint16_t>(cfg.starts[i].first), static_cast<uint16_t>(cfg.starts[i].second)};
+        spawns.push_back(s);
+    }
+
+    start = std::chrono::steady_clock::now();
+    if (!writeLevelFile(out, walls, crates, spawns, cfg.seed, chunkSize, chunkIndex)) {
+        fprintf(stderr, "Failed to write %s\n", out);
+        return -1;
+    }
+    double writeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("Generated in %.1f ms, written in %.1f ms\n", genMs, writeMs);
+    return printInfo(out);
+}
@@ -1,4 +1,5 @@
 #include <SFML/Graphics.hpp>
+#include <SFML/OpenGL.hpp>
 #include <tinyxml2.h>
 #include <pthread.h>
 #include <queue>
@@ -8,166 +9,307 @@
 #include <chrono>
 #include <iostream>
 #include <X11/Xlib.h> 
-
-#define TOTAL_PLAYERS 2
-#define MAX_ITEMS 40
-#define GAME_DURATION 60
-#define ITEM_SPAWN_INTERVAL 2
-#define MAX_CRATES 7
-
-// Structures
-struct Item {
-    int x, y;
-    bool collected;
-    sf::Sprite sprite;
-    float spawnTime;
-    
-    Item() : collected(false), spawnTime(0) {}
-};
-
-struct Crate {
-    int x, y;
-    sf::Sprite sprite;
-};
-
-struct PlayerData {
-    int x, y, score;
-    PlayerData() : x(1), y(1), score(0) {}
-};
-
-// Message structures for thread communication
-struct MoveMessage {
-    int playerID;
-    int newX;
-    int newY;
+#include <unistd.h>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include "game.h"
+#include "input.h"
+#include "atlas.h"
+#include "state_export.h"
+#include "savegame.h"
+#include "level.h"
+#include "systems.h"
+#include "capture.h"
+#include "metrics.h"
+#include "render_chunks.h"
+#include "threadconf.h"
+#include "eventlog.h"
+#include "netcode.h"
+#include "coro.h"
+
+#define HUD_TOP_PLAYERS 4   // leaderboard rows on the score line
+#define ACTOR_THREADS 2     // workers resuming the input, spawn and timer coroutines
+#define MAX_VIEWS 8         // split-screen viewports
+
+// Keys a player holds as of the last frame; changed wakes their input
+// coroutine when it is waiting for a key to go down
+struct PlayerInput {
+    std::atomic<unsigned> held;
+    CoEvent changed;
+
+    PlayerInput() : held(0) {}
 };
 
-struct GameState {
+struct GameState : MatchState {
     std::atomic<bool> gameRunning;
-    std::vector<PlayerData> players;
-    std::vector<Item> items;
-    std::vector<Crate> crates;
     std::queue<MoveMessage> moveQueue;
-    float lastItemSpawnTime;
     sf::Text gameOverText;
     sf::Text timerText;
     sf::Text scoreText;
+
+    // Input, spawn cadence and match timer run as coroutines on the actor
+    // scheduler and talk to the frame loop through these
+    PlayerInput input[TOTAL_PLAYERS];
+    std::atomic<bool> timeUp;
+    std::atomic<bool> spawnDue;     // raised by the cadence, cleared by the spawn system
+    CoEvent spawned;                // a due spawn happened (or the cadence was restarted)
+    std::atomic<unsigned> cadence;  // bumped on restore; older cadences end
+    std::atomic<unsigned> inputEpoch;   // bumped on restore, under queueMutex; owed moves are dropped
+    pthread_mutex_t queueMutex;
+    LatencyStats moveLatency[TOTAL_PLAYERS];
     
-    GameState() : gameRunning(true), lastItemSpawnTime(0) {
-        players.resize(TOTAL_PLAYERS);
+    GameState() : gameRunning(true), timeUp(false), spawnDue(false), cadence(0), inputEpoch(0) {
+        pthread_mutex_init(&queueMutex, nullptr);
+    }
+
+    ~GameState() {
+        pthread_mutex_destroy(&queueMutex);
     }
 };
 
-struct SubTexture {
-    std::string name;
-    int x, y, width, height;
+enum TileKind {
+    TILE_GROUND,
+    TILE_WALL,
+    TILE_KIND_COUNT
 };
 
-// Helper functions declarations
-bool isPositionOccupied(int x, int y, const std::vector<Crate>& crates);
-void generateCrates(std::vector<Crate>& crates, int N, const sf::Texture& crateTexture, int cellSize);
-bool trySpawnItem(GameState& gameState, int N, const sf::Texture& itemTexture, int cellSize, float currentTime);
-void* playerThread(void* arg);
-
-struct PlayerThreadData {
-    int playerNum;
-    GameState* gameState;
+// Atlas sprites and layout the render system draws the world with
+struct RenderData {
+    ChunkedSprites<sf::Vertex>* entities;   // crates, coins and players
+    ChunkedTiles<sf::Vertex>* tiles;        // ground and walls
+    ThreadPool* pool;                       // builds tile chunks on large boards, or nullptr
     int gridSize;
+    int cellSize;
+    TileUV sprites[SPRITE_PLAYER + TOTAL_PLAYERS];
 };
 
-std::vector<SubTexture> loadSubTextures(const std::string& xmlFile, const std::string& prefix) {
-    std::vector<SubTexture> subTextures;
-    tinyxml2::XMLDocument doc;
-    if (doc.LoadFile(xmlFile.c_str()) != tinyxml2::XML_SUCCESS) {
-        std::cerr << "Failed to load XML file!" << std::endl;
-        return subTextures;
-    }
-
-    tinyxml2::XMLElement* atlas = doc.FirstChildElement("TextureAtlas");
-    if (!atlas) return subTextures;
-
-    for (tinyxml2::XMLElement* elem = atlas->FirstChildElement("SubTexture"); elem != nullptr; elem = elem->NextSiblingElement("SubTexture")) {
-        SubTexture subTexture;
-        subTexture.name = elem->Attribute("name");
-        subTexture.x = elem->IntAttribute("x");
-        subTexture.y = elem->IntAttribute("y");
-        subTexture.width = elem->IntAttribute("width");
-        subTexture.height = elem->IntAttribute("height");
-        // subTextures.push_back(subTexture);
-        
-        if (subTexture.name.find(prefix) == 0) {
-            subTextures.push_back(subTexture);
-        }
-    }
-    return subTextures;
-}
+// Player 1 uses WASD, player 2 the arrow keys; a networked client takes either
+static const sf::Keyboard::Key playerKeys[TOTAL_PLAYERS][4] = {
+    {sf::Keyboard::W, sf::Keyboard::S, sf::Keyboard::A, sf::Keyboard::D},
+    {sf::Keyboard::Up, sf::Keyboard::Down, sf::Keyboard::Left, sf::Keyboard::Right}
+};
 
-int generateGridSize(int rollNo) {
-    srand(time(0));
-    int randomNum = 10 + rand() % 90;
+// Helper functions declarations
+void renderSystem(void* arg, World& world, Commands& cmds);
+void renderNetView(RenderData& rd, World& world, const NetView& view);
+unsigned heldDirections(int playerNum);
+CoTask playerInput(GameState& gameState, CoScheduler& actors, int playerNum, int keyDelayMs, int keyRepeatMs);
+CoTask spawnCadence(GameState& gameState, CoScheduler& actors, unsigned cadence, float firstDue);
+CoTask matchTimer(GameState& gameState, CoScheduler& actors);
+void publishState(StateExportWriter& writer, const GameState& gameState, int N, float currentTime, float remainingTime);
+bool writePng(const char* path, const uint8_t* rgba, int width, int height);
+
+int generateGridSize(int rollNo, Rng& rng) {
+    int randomNum = 10 + rng.below(90);
     float res = static_cast<float>(rollNo)/ (randomNum * (rollNo % 10));
     res = static_cast<int>(res) % 25;
     if (res < 10) res += 15;
     return static_cast<int>(res);
 }
 
-int main() {
+int main(int argc, char** argv) {
     XInitThreads();
 
+    // --seed <n> replays a previous run; otherwise a fresh seed is picked
+    uint64_t seed = static_cast<uint64_t>(time(0));
+    int keyDelayMs = INPUT_INITIAL_DELAY_MS;
+    int keyRepeatMs = INPUT_REPEAT_MS;
+    bool exportState = false;
+    const char* restorePath = nullptr;
+    float itemLifetime = 0;
+    int pickupRadius = 0;
+    int viewCount = 1;
+    const char* recordPath = nullptr;
+    CaptureFormat recordFormat = CAPTURE_PNG;
+    int encoderCount = CAPTURE_DEFAULT_ENCODERS;
+    const char* metricsSocket = nullptr;
+    const char* metricsFile = nullptr;
+    const char* eventLogPath = nullptr;
+    int eventLogMb = EVENTLOG_DEFAULT_FILE_BYTES >> 20;
+    const char* connectAddr = nullptr;
+    const char* levelPath = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--key-delay") == 0 && i + 1 < argc) {
+            keyDelayMs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--key-repeat") == 0 && i + 1 < argc) {
+            keyRepeatMs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--export") == 0) {
+            exportState = true;
+        } else if (strcmp(argv[i], "--restore") == 0 && i + 1 < argc) {
+            restorePath = argv[++i];
+        } else if (strcmp(argv[i], "--item-lifetime") == 0 && i + 1 < argc) {
+            itemLifetime = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--pickup-radius") == 0 && i + 1 < argc) {
+            pickupRadius = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--views") == 0 && i + 1 < argc) {
+            viewCount = atoi(argv[++i]);
+            if (viewCount < 1 || viewCount > MAX_VIEWS) {
+                std::cerr << "--views must be 1.." << MAX_VIEWS << std::endl;
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+            recordFormat = CAPTURE_PNG;
+        } else if (strcmp(argv[i], "--record-raw") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+            recordFormat = CAPTURE_RAW;
+        } else if (strcmp(argv[i], "--encoders") == 0 && i + 1 < argc) {
+            encoderCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+            metricsSocket = argv[++i];
+        } else if (strcmp(argv[i], "--metrics-file") == 0 && i + 1 < argc) {
+            metricsFile = argv[++i];
+        } else if (strcmp(argv[i], "--event-log") == 0 && i + 1 < argc) {
+            eventLogPath = argv[++i];
+        } else if (strcmp(argv[i], "--event-log-mb") == 0 && i + 1 < argc) {
+            eventLogMb = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--level") == 0 && i + 1 < argc) {
+            levelPath = argv[++i];
+        } else if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc) {
+            connectAddr = argv[++i];
+        } else if (isThreadOption(argv[i]) && i + 1 < argc) {
+            if (!parseThreadOption(argv[i], argv[i + 1])) {
+                std::cerr << "Bad " << argv[i] << " " << argv[i + 1] << " (expected render|sim|input|pool=<value>)" << std::endl;
+                return -1;
+            }
+            i++;
+        }
+    }
+    applyThreadRole(ROLE_RENDER, 0);
+
+    // Initialize game state; --restore <file> resumes a saved match, which
+    // brings its own seed, grid size and crates
+    GameState gameState;
+    if (restorePath) {
+        if (!loadMatchFile(gameState, restorePath, gameState.clockOffset)) {
+            std::cerr << "Failed to restore " << restorePath << std::endl;
+            return -1;
+        }
+        seed = gameState.seed;
+    }
+
+    // --level <file>: play a baked or authored level instead of a generated
+    // map; the seed still drives coin spawns
+    LevelFile level;
+    if (levelPath) {
+        if (restorePath || connectAddr) {
+            std::cerr << "--level cannot be used with --restore or --connect" << std::endl;
+            return -1;
+        }
+        if (!level.open(levelPath)) {
+            std::cerr << "Failed to open level " << levelPath << std::endl;
+            return -1;
+        }
+        if (level.size() > MAX_GRID_SIZE) {
+            std::cerr << levelPath << " is " << level.size() << "x" << level.size() << ", the board holds at most "
+                      << MAX_GRID_SIZE << "x" << MAX_GRID_SIZE << std::endl;
+            return -1;
+        }
+    }
+
+    // --connect <host>[:port]: the match runs on a net_server; this window
+    // sends the keys held and draws the snapshots it gets back. The welcome
+    // brings the seed and grid size, so the map is generated here as well.
+    NetClient net;
+    if (connectAddr) {
+        sockaddr_in serverAddr;
+        if (restorePath) {
+            std::cerr << "--restore cannot be used with --connect" << std::endl;
+            return -1;
+        }
+        if (!resolveNetAddr(connectAddr, serverAddr) || !net.connect(serverAddr, 5000)) {
+            std::cerr << "No answer from a server at " << connectAddr << std::endl;
+            return -1;
+        }
+        seed = net.seed;
+        std::cout << "Connected as player " << net.player + 1 << std::endl;
+    }
+    rngMasterSeed() = seed;
+    std::cout << "Seed: " << seed << std::endl;
+
     int rollNum = 0615;
-    int N = generateGridSize(rollNum);
+    Rng gridRng = rngStream(seed, RNG_STREAM_GRID);
+    int N = generateGridSize(rollNum, gridRng);
+    if (restorePath) N = gameState.gridSize;
+    if (level.isOpen()) N = level.size();
+    if (net.connected()) N = net.gridSize;
     int windowSize = 600;
     int cellSize = windowSize/N;
     
-    sf::RenderWindow window(sf::VideoMode(windowSize, windowSize), "MAGA FIGHT");
+    std::string title = "MAGA FIGHT";
+    if (net.connected()) title += " - Player " + std::to_string(net.player + 1);
+    sf::RenderWindow window(sf::VideoMode(windowSize, windowSize), title);
     
-    // Load textures
-    sf::Texture textureSheet, itemTexture, crateTexture;
-    if (!textureSheet.loadFromFile("resourcePack/Spritesheet/sokoban_spritesheet@2.png") ||
-        !itemTexture.loadFromFile("item.png") ||
-        !crateTexture.loadFromFile("crate.png")) {
-        std::cerr << "Failed to load textures!" << std::endl;
+    // Every sprite comes from one atlas texture built by atlas_pack, so the
+    // whole board is drawn with a single texture
+    sf::Texture atlasTexture;
+    if (!atlasTexture.loadFromFile(ATLAS_IMAGE)) {
+        std::cerr << "Failed to load " << ATLAS_IMAGE << " (build it with ./atlas_pack)" << std::endl;
         return -1;
     }
 
-    std::vector<SubTexture> groundTextures = loadSubTextures("resourcePack/Spritesheet/sokoban_spritesheet@2.xml", "ground");
-    std::vector<SubTexture> blockTextures = loadSubTextures("resourcePack/Spritesheet/sokoban_spritesheet@2.xml", "block");
-
-    // Create sprites for ground and walls
-    // std::vector<sf::Sprite> groundSprites;
-    // std::vector<sf::Sprite> blockSprites;
-    
-    // Initialize ground sprite
-    std::vector<sf::Sprite> groundSprites;
-    for (const auto& subTex : groundTextures) {
-        sf::Sprite sprite;
-        sprite.setTexture(textureSheet);
-        sprite.setTextureRect(sf::IntRect(subTex.x, subTex.y, subTex.width, subTex.height));
-        groundSprites.push_back(sprite);
+    std::vector<SubTexture> atlasTextures = loadSubTextures(ATLAS_INDEX, "");
+    std::vector<SubTexture> groundTextures = loadSubTextures(ATLAS_INDEX, "ground");
+    std::vector<SubTexture> blockTextures = loadSubTextures(ATLAS_INDEX, "block");
+    const SubTexture* itemTex = findSubTexture(atlasTextures, "item.png");
+    const SubTexture* crateTex = findSubTexture(atlasTextures, "crate.png");
+    const SubTexture* playerTex[TOTAL_PLAYERS] = {
+        findSubTexture(atlasTextures, "player_03.png"),
+        findSubTexture(atlasTextures, "player_06.png")
+    };
+    if (groundTextures.size() < 2 || blockTextures.empty() || !itemTex || !crateTex ||
+        !playerTex[0] || !playerTex[1]) {
+        std::cerr << "Sprites missing from " << ATLAS_INDEX << " (rebuild it with ./atlas_pack)" << std::endl;
+        return -1;
     }
 
-    std::vector<sf::Sprite> blockSprites;
-    for (const auto& subTex : blockTextures) {
-        sf::Sprite sprite;
-        sprite.setTexture(textureSheet);
-        sprite.setTextureRect(sf::IntRect(subTex.x, subTex.y, subTex.width, subTex.height));
-        blockSprites.push_back(sprite);
-    }
+    sf::RenderStates atlasStates(&atlasTexture);
 
-    sf::Texture playerTextures[TOTAL_PLAYERS];
-    if (!playerTextures[0].loadFromFile("player_03.png")) return EXIT_FAILURE;
-    if (!playerTextures[1].loadFromFile("player_06.png")) return EXIT_FAILURE;
-    
-    
-    std::vector<sf::Sprite> playerSprites(TOTAL_PLAYERS);
+    Rng visualRng = rngStream(seed, RNG_STREAM_VISUAL);
+    int blockSpIndex = visualRng.below(blockTextures.size());
+    int groundSpIndex = visualRng.below(groundTextures.size() - 1);
+
+    // Ground and walls are built in square chunks with a vertex buffer
+    // each; boards large enough to make that slow spread the chunks over a
+    // render pool
+    std::vector<uint8_t> tileKinds(N * N, TILE_GROUND);
+    for (int i = 0; i < N; ++i) {
+        for (int j = 0; j < N; ++j) {
+            if (i == 0 || i == N - 1 || j == 0 || j == N - 1) tileKinds[i * N + j] = TILE_WALL;
+        }
+    }
+    const SubTexture& groundTex = groundTextures[groundSpIndex];
+    const SubTexture& wallTex = blockTextures[blockSpIndex];
+    TileUV tileUVs[TILE_KIND_COUNT] = {
+        tileUV(groundTex.x, groundTex.y, groundTex.width, groundTex.height),
+        tileUV(wallTex.x, wallTex.y, wallTex.width, wallTex.height)
+    };
+    ChunkedTiles<sf::Vertex> boardTiles;
+    boardTiles.layout(N);
+    ChunkedSprites<sf::Vertex> boardSprites;
+    boardSprites.layout(N, static_cast<float>(cellSize));
+    boardTiles.tiles = tileKinds.data();
+    boardTiles.uvs = tileUVs;
+    boardTiles.cellSize = static_cast<float>(cellSize);
+    ThreadPool renderPool;
+    if (N * N >= RENDER_PARALLEL_MIN_CELLS) renderPool.start(static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN)));
+
+    RenderData renderData;
+    renderData.entities = &boardSprites;
+    renderData.tiles = &boardTiles;
+    renderData.pool = renderPool.size() > 0 ? &renderPool : nullptr;
+    renderData.gridSize = N;
+    renderData.cellSize = cellSize;
+    renderData.sprites[SPRITE_CRATE] = tileUV(crateTex->x, crateTex->y, crateTex->width, crateTex->height);
+    renderData.sprites[SPRITE_ITEM] = tileUV(itemTex->x, itemTex->y, itemTex->width, itemTex->height);
     for (int i = 0; i < TOTAL_PLAYERS; i++) {
-        playerSprites[i].setTexture(playerTextures[i]);  // Assign texture directly
-        playerSprites[i].setTextureRect(sf::IntRect(0, 0, 128, 128));
+        renderData.sprites[SPRITE_PLAYER + i] = tileUV(playerTex[i]->x, playerTex[i]->y, playerTex[i]->width,
+                                                       playerTex[i]->height);
     }
 
-    // Initialize game state
-    GameState gameState;
-    
     sf::Font font;
     if (!font.loadFromFile("arial.ttf")) {
         std::cerr << "Failed to load font!" << std::endl;
@@ -189,306 +331,534 @@ int main() {
     gameState.gameOverText.setFillColor(sf::Color::White);
     gameState.gameOverText.setPosition(windowSize/4, windowSize/2);
 
-    // Generate initial crates
-    generateCrates(gameState.crates, N, crateTexture, cellSize);
+    if (level.isOpen()) {
+        if (!setupMatchFromLevel(gameState, level, seed)) {
+            std::cerr << levelPath << " needs a walled border and " << TOTAL_PLAYERS << " free spawn points" << std::endl;
+            return -1;
+        }
+        gameState.itemLifetime = itemLifetime;
+    } else if (!restorePath) {
+        // Generate the map; every floor cell stays reachable from both starts
+        setupMatch(gameState, seed, N);
+        gameState.itemLifetime = itemLifetime;
+    }
 
-    // Initialize and start player threads
-    std::vector<PlayerThreadData> threadData(TOTAL_PLAYERS);
-    std::vector<pthread_t> playerThreads(TOTAL_PLAYERS);
-    
-    for (int i = 0; i < TOTAL_PLAYERS; i++) {
-        threadData[i].playerNum = i;
-        threadData[i].gameState = &gameState;
-        threadData[i].gridSize = N;
-        
-        if (pthread_create(&playerThreads[i], nullptr, playerThread, &threadData[i]) != 0) {
-            std::cerr << "Failed to create player thread " << i << std::endl;
+    // Movement, pickup, expiry, spawn and render run as ECS systems; those
+    // with no conflicting reads or writes share a stage and run in parallel
+    SystemScheduler systems;
+    addGameSystems(systems, renderSystem);
+    std::cout << "System stages: " << systems.describe() << std::endl;
+    FrameContext frame;
+    frame.match = &gameState;
+    frame.renderData = &renderData;
+    // --pickup-radius <cells>: coins within reach are pulled in, like a magnet
+    frame.pickupRadius = pickupRadius > 0 ? pickupRadius : 0;
+
+    // Player input, the spawn cadence and the match timer are coroutines
+    // resumed by a few input-role threads; the frame loop advances their
+    // clock (match time) and tick. A networked client reads its keys in the
+    // main loop instead and the server keeps time.
+    int localPlayers = net.connected() ? 0 : TOTAL_PLAYERS;
+    CoScheduler actors;
+    actors.role = ROLE_INPUT;
+    actors.advanceClock(gameState.clockOffset);
+    gameState.spawned.scheduler = &actors;
+    for (int i = 0; i < TOTAL_PLAYERS; i++) gameState.input[i].changed.scheduler = &actors;
+    if (localPlayers > 0) {
+        if (actors.start(ACTOR_THREADS) == 0) {
+            std::cerr << "Failed to create the input threads" << std::endl;
             return -1;
         }
+        for (int i = 0; i < localPlayers; i++) {
+            actors.spawn(playerInput(gameState, actors, i, keyDelayMs, keyRepeatMs));
+        }
+        actors.spawn(spawnCadence(gameState, actors, 0, gameState.lastItemSpawnTime + ITEM_SPAWN_INTERVAL));
+        actors.spawn(matchTimer(gameState, actors));
+        frame.spawnDue = &gameState.spawnDue;
+    }
+
+    for (int i = 0; i < TOTAL_PLAYERS; i++) {
+        std::cout << "Player " << i + 1 << " reachable area: "
+                  << gameState.connectivity.reachableArea(gameState.playerPos(i).x, gameState.playerPos(i).y)
+                  << " cells" << std::endl;
+    }
+
+    // Observers in other processes read each tick from shared memory
+    StateExportWriter stateExport;
+    if (exportState && !stateExport.open()) {
+        std::cerr << "Failed to create shared memory " << STATE_EXPORT_NAME << std::endl;
+        return -1;
     }
 
-    // Set initial player positions
-    gameState.players[0].x = 1;
-    gameState.players[0].y = 1;
-    gameState.players[1].x = N-2;
-    gameState.players[1].y = N-2;
+    // Engine counters are always collected; --metrics serves them on a Unix
+    // socket while the game runs
+    MetricsServer metricsServer;
+    if (metricsSocket && !metricsServer.start(metricsSocket)) {
+        std::cerr << "Failed to listen on " << metricsSocket << std::endl;
+        return -1;
+    }
+
+    // --event-log <file>: gameplay and thread events as binary records,
+    // rotated every --event-log-mb megabytes; read with eventlog_decode
+    if (eventLogPath && (eventLogMb < 1 || !eventLog().open(eventLogPath, static_cast<uint64_t>(eventLogMb) << 20))) {
+        std::cerr << "Failed to open event log " << eventLogPath << std::endl;
+        return -1;
+    }
+
+    // --record <dir> / --record-raw <file>: frames are drawn offscreen,
+    // shown in the window and read back for the encoder threads. Two targets
+    // alternate so each readback is of the previous frame, which the GPU
+    // has already finished.
+    FrameCapture capture;
+    sf::RenderTexture captureTargets[2];
+    if (recordPath) {
+        capture.bottomUp = true;
+        if (!captureTargets[0].create(windowSize, windowSize) || !captureTargets[1].create(windowSize, windowSize)) {
+            std::cerr << "Failed to create the offscreen capture target" << std::endl;
+            return -1;
+        }
+        if (!capture.open(recordPath, recordFormat, windowSize, windowSize, encoderCount, writePng)) {
+            std::cerr << "Failed to open " << recordPath << " for recording" << std::endl;
+            return -1;
+        }
+    }
+    const int64_t captureIntervalUs = 1000000 / CAPTURE_FPS;
+    int64_t nextCaptureUs = monotonicMicros();
+    uint64_t frameCount = 0;
+    uint64_t scoreVersion = ~0ull;
+    sf::View views[MAX_VIEWS];
+    views[0] = window.getDefaultView();
 
     // Game clock
     sf::Clock gameClock;
 
-    int blockSpIndex = rand() % blockTextures.size();
-    int groundSpIndex = rand() % (groundTextures.size() - 1);
-
     // Main game loop
     while (window.isOpen()) {
+        int64_t frameStartUs = monotonicMicros();
         sf::Event event;
         while (window.pollEvent(event)) {
             if (event.type == sf::Event::Closed)
                 window.close();
+
+            // F5 saves the match, F9 rolls back to the last save
+            if (event.type == sf::Event::KeyPressed && gameState.gameRunning && !net.connected()) {
+                float now = gameState.clockOffset + gameClock.getElapsedTime().asSeconds();
+                if (event.key.code == sf::Keyboard::F5) {
+                    if (saveMatchFile(gameState, now, SAVE_DEFAULT_FILE)) {
+                        std::cout << "Saved " << SAVE_DEFAULT_FILE << " at " << now << "s" << std::endl;
+                    } else {
+                        std::cerr << "Failed to save " << SAVE_DEFAULT_FILE << std::endl;
+                    }
+                } else if (event.key.code == sf::Keyboard::F9) {
+                    MatchState saved;
+                    float savedTime = 0;
+                    if (!loadMatchFile(saved, SAVE_DEFAULT_FILE, savedTime)) {
+                        std::cerr << "Failed to restore " << SAVE_DEFAULT_FILE << std::endl;
+                    } else if (saved.gridSize != N) {
+                        std::cerr << SAVE_DEFAULT_FILE << " is for a " << saved.gridSize << "x" << saved.gridSize
+                                  << " grid, this window is " << N << "x" << N << std::endl;
+                    } else {
+                        static_cast<MatchState&>(gameState) = saved;
+                        // Moves sampled against the old positions must not
+                        // land on the restored match
+                        pthread_mutex_lock(&gameState.queueMutex);
+                        std::queue<MoveMessage>().swap(gameState.moveQueue);
+                        gameState.inputEpoch++;
+                        pthread_mutex_unlock(&gameState.queueMutex);
+                        gameState.clockOffset = savedTime;
+                        gameClock.restart();
+                        // Timers are in match time; the spawn cadence
+                        // restarts from the saved match's last spawn
+                        actors.advanceClock(savedTime);
+                        gameState.spawnDue = false;
+                        unsigned cadence = ++gameState.cadence;
+                        gameState.spawned.notify();
+                        actors.spawn(spawnCadence(gameState, actors, cadence, saved.lastItemSpawnTime + ITEM_SPAWN_INTERVAL));
+                    }
+                }
+            }
         }
 
-        float currentTime = gameClock.getElapsedTime().asSeconds();
+        float currentTime = gameState.clockOffset + gameClock.getElapsedTime().asSeconds();
         float remainingTime = GAME_DURATION - currentTime;
+        actors.advanceClock(currentTime);
 
-        // Handle game over condition
-        if (remainingTime <= 0 && gameState.gameRunning) {
+        // Wake the input coroutines of players whose keys changed
+        for (int p = 0; p < localPlayers; p++) {
+            unsigned held = heldDirections(p);
+            if (gameState.input[p].held.exchange(held) != held) gameState.input[p].changed.notify();
+        }
+
+        // Networked: the server's clock and scores replace the local ones
+        NetView view;
+        bool haveView = false;
+        if (net.connected()) {
+            net.receive();
+            net.sendInput(heldDirections(-1));
+            haveView = net.view(monotonicMicros(), view);
+            remainingTime = haveView ? view.secondsLeft : GAME_DURATION;
+            currentTime = GAME_DURATION - remainingTime;
+            for (int p = 0; haveView && p < TOTAL_PLAYERS; p++) gameState.setScore(p, view.score[p]);
+        }
+
+        // Handle game over condition: the match timer fired, or the
+        // server's clock ran out
+        bool timeUp = net.connected() ? remainingTime <= 0 : gameState.timeUp.load();
+        if (timeUp && gameState.gameRunning) {
             gameState.gameRunning = false;
+            const Leaderboard& board = gameState.leaderboard;
+            int leader = board.at(0);
             std::string winnerText;
-            if (gameState.players[0].score > gameState.players[1].score) {
-                winnerText = "Player 1 Wins!\nScore: " + std::to_string(gameState.players[0].score);
-            } else if (gameState.players[1].score > gameState.players[0].score) {
-                winnerText = "Player 2 Wins!\nScore: " + std::to_string(gameState.players[1].score);
+            if (board.tiedForLead()) {
+                winnerText = "It's a Tie!\nScore: " + std::to_string(board.score(leader));
             } else {
-                winnerText = "It's a Tie!\nScore: " + std::to_string(gameState.players[0].score);
+                winnerText = "Player " + std::to_string(leader + 1) + " Wins!\nScore: " + std::to_string(board.score(leader));
             }
             gameState.gameOverText.setString(winnerText);
+            logEvent(EVENT_GAME_OVER, board.tiedForLead() ? -1 : leader, board.score(leader));
         }
 
-        // Process move messages from player threads
-        while (!gameState.moveQueue.empty()) {
-            MoveMessage msg = gameState.moveQueue.front();
-            gameState.moveQueue.pop();
-            
-            int newX = gameState.players[msg.playerID].x + msg.newX;
-            int newY = gameState.players[msg.playerID].y + msg.newY;
-            
-            if (newX > 0 && newX < N-1 && newY > 0 && newY < N-1 && 
-                !isPositionOccupied(newX, newY, gameState.crates)) {
-                gameState.players[msg.playerID].x = newX;
-                gameState.players[msg.playerID].y = newY;
-                
-                for (auto& item : gameState.items) {
-                    if (!item.collected && item.x == newX && item.y == newY) {
-                        item.collected = true;
-                        gameState.players[msg.playerID].score++;
-                    }
-                }
+        if (net.connected()) {
+            if (haveView) renderNetView(renderData, gameState.world, view);
+        } else {
+            // Collect move messages from the input coroutines
+            std::queue<MoveMessage> moves;
+            pthread_mutex_lock(&gameState.queueMutex);
+            moves.swap(gameState.moveQueue);
+            pthread_mutex_unlock(&gameState.queueMutex);
+            int64_t appliedUs = monotonicMicros();
+            observeMetric(METRIC_QUEUE_DEPTH, moves.size());
+            frame.moves.clear();
+            while (!moves.empty()) {
+                frame.moves.push_back(moves.front());
+                gameState.moveLatency[moves.front().playerID].record(appliedUs - moves.front().dueUs);
+                moves.pop();
             }
+
+            // Simulate and build this frame's vertices
+            frame.now = currentTime;
+            frame.running = gameState.gameRunning;
+            bool spawnWasDue = gameState.spawnDue;
+            systems.run(gameState.world, &frame);
+            if (spawnWasDue && !gameState.spawnDue) gameState.spawned.notify();
         }
 
-        // Spawn items periodically
-        if (gameState.gameRunning) {
-            float timeSinceLastSpawn = currentTime - gameState.lastItemSpawnTime;
-            if (timeSinceLastSpawn >= ITEM_SPAWN_INTERVAL) {
-                if (trySpawnItem(gameState, N, itemTexture, cellSize, currentTime)) {
-                    gameState.lastItemSpawnTime = currentTime;
-                }
-            }
+        if (exportState) {
+            publishState(stateExport, gameState, N, currentTime, remainingTime);
         }
 
         // Render
-        window.clear();
-        
-        // Draw ground and walls
-        for (int i = 0; i < N; ++i) {
-            for (int j = 0; j < N; ++j) {
-                if (i == 0 || i == N - 1 || j == 0 || j == N - 1) {
-                    blockSprites[blockSpIndex].setPosition(j * cellSize, i * cellSize);
-                    blockSprites[blockSpIndex].setScale(
-                        static_cast<float>(cellSize) / blockSprites[blockSpIndex].getTextureRect().width,
-                        static_cast<float>(cellSize) / blockSprites[blockSpIndex].getTextureRect().height
-                    );
-                    window.draw(blockSprites[blockSpIndex]);
-                } else {
-                    groundSprites[groundSpIndex].setPosition(j * cellSize, i * cellSize);
-                    groundSprites[groundSpIndex].setScale(
-                        static_cast<float>(cellSize) / groundSprites[groundSpIndex].getTextureRect().width,
-                        static_cast<float>(cellSize) / groundSprites[groundSpIndex].getTextureRect().height
-                    );
-                    window.draw(groundSprites[groundSpIndex]);
-                }
+        std::string timerString = "Time: " + std::to_string(static_cast<int>(remainingTime));
+        gameState.timerText.setString(timerString);
+        // The score line is rebuilt only when the leaderboard changed
+        if (gameState.leaderboard.version != scoreVersion) {
+            scoreVersion = gameState.leaderboard.version;
+            int ranked[HUD_TOP_PLAYERS];
+            int shown = gameState.leaderboard.top(HUD_TOP_PLAYERS, ranked);
+            std::string scoreString;
+            for (int r = 0; r < shown; r++) {
+                if (r) scoreString += " | ";
+                scoreString += "P" + std::to_string(ranked[r] + 1) + ": " + std::to_string(gameState.leaderboard.score(ranked[r]));
             }
+            gameState.scoreText.setString(scoreString);
         }
-
-        // Draw crates
-        for (const auto& crate : gameState.crates) {
-            window.draw(crate.sprite);
+        // --views <n>: view i follows player i % TOTAL_PLAYERS at one board
+        // pixel per screen pixel; a single view is the whole window. The
+        // tiles and sprites were built once above, and each view draws only
+        // the chunks inside its rectangle.
+        float boardPx = static_cast<float>(N * cellSize);
+        for (int v = 0; viewCount > 1 && v < viewCount; v++) {
+            int p = v % TOTAL_PLAYERS;
+            float row = haveView ? view.x[p] : static_cast<float>(gameState.playerPos(p).x);
+            float col = haveView ? view.y[p] : static_cast<float>(gameState.playerPos(p).y);
+            ViewportRect port = splitViewport(v, viewCount);
+            float w = port.width * windowSize, h = port.height * windowSize;
+            views[v].setSize(w, h);
+            views[v].setCenter(viewCentre((col + 0.5f) * cellSize, w, boardPx), viewCentre((row + 0.5f) * cellSize, h, boardPx));
+            views[v].setViewport(sf::FloatRect(port.left, port.top, port.width, port.height));
         }
-
-        // Draw items
-        for (const auto& item : gameState.items) {
-            if (!item.collected) {
-                window.draw(item.sprite);
+        auto drawScene = [&](sf::RenderTarget& target) {
+            target.clear();
+            for (int v = 0; v < viewCount; v++) {
+                target.setView(views[v]);
+                const sf::Vector2f& centre = views[v].getCenter();
+                const sf::Vector2f& size = views[v].getSize();
+                ChunkRange r = visibleChunks(boardTiles.chunkCells, boardTiles.chunksPerSide, boardTiles.cellSize,
+                                             centre.x - size.x / 2, centre.y - size.y / 2, size.x, size.y);
+                for (int cr = r.row0; cr < r.row1; cr++) {
+                    for (int cc = r.col0; cc < r.col1; cc++) {
+                        const std::vector<sf::Vertex>& chunk = boardTiles.chunks[cr * boardTiles.chunksPerSide + cc];
+                        target.draw(chunk.data(), chunk.size(), sf::Quads, atlasStates);
+                    }
+                }
+                for (int cr = r.row0; cr < r.row1; cr++) {
+                    for (int cc = r.col0; cc < r.col1; cc++) {
+                        const std::vector<sf::Vertex>& chunk = boardSprites.chunks[cr * boardSprites.chunksPerSide + cc];
+                        if (!chunk.empty()) target.draw(chunk.data(), chunk.size(), sf::Quads, atlasStates);
+                    }
+                }
             }
-        }
+            target.setView(target.getDefaultView());
 
-        // Draw players if game is running
-        if (gameState.gameRunning) {
-            for (int i = 0; i < TOTAL_PLAYERS; i++) {
-                playerSprites[i].setPosition(gameState.players[i].y * cellSize, gameState.players[i].x * cellSize);
-                playerSprites[i].setScale(
-                    static_cast<float>(cellSize) / playerSprites[i].getTextureRect().width,
-                    static_cast<float>(cellSize) / playerSprites[i].getTextureRect().height
-                );
-                window.draw(playerSprites[i]);
+            // Draw UI
+            if (gameState.gameRunning) {
+                target.draw(gameState.timerText);
+                target.draw(gameState.scoreText);
+            } else {
+                target.draw(gameState.gameOverText);
             }
-        }
-
-        // Draw UI
-        if (gameState.gameRunning) {
-            std::string timerString = "Time: " + std::to_string(static_cast<int>(remainingTime));
-            gameState.timerText.setString(timerString);
-            window.draw(gameState.timerText);
+        };
 
-            std::string scoreString = "P1: " + std::to_string(gameState.players[0].score) + 
-                                    " | P2: " + std::to_string(gameState.players[1].score);
-            gameState.scoreText.setString(scoreString);
-            window.draw(gameState.scoreText);
+        if (!capture.isOpen()) {
+            drawScene(window);
+            window.display();
         } else {
-            window.draw(gameState.gameOverText);
+            sf::RenderTexture& target = captureTargets[frameCount & 1];
+            drawScene(target);
+            target.display();
+            window.clear();
+            window.draw(sf::Sprite(target.getTexture()));
+            window.display();
+
+            int64_t nowUs = monotonicMicros();
+            if (frameCount > 0 && nowUs >= nextCaptureUs) {
+                CaptureFrame* shot = capture.acquire();
+                if (shot) {
+                    sf::RenderTexture& previous = captureTargets[(frameCount + 1) & 1];
+                    previous.setActive(true);
+                    glReadPixels(0, 0, windowSize, windowSize, GL_RGBA, GL_UNSIGNED_BYTE, shot->pixels.data());
+                    previous.setActive(false);
+                    capture.submit(shot);
+                }
+                capture.recordCost(monotonicMicros() - nowUs);
+                // Stay on the 60 fps grid, but do not try to catch up after a stall
+                nextCaptureUs += captureIntervalUs;
+                if (nextCaptureUs < nowUs) nextCaptureUs = nowUs + captureIntervalUs;
+            }
         }
+        frameCount++;
+        countMetric(METRIC_FRAMES);
+        observeMetric(METRIC_FRAME_TIME_US, static_cast<uint64_t>(monotonicMicros() - frameStartUs));
 
-        window.display();
+        // End of the tick: players holding keys sample input now, so their
+        // moves are waiting in the queue when the next frame starts
+        actors.advanceTick();
     }
 
-    // Clean up threads
+    // Clean up the actors; stop() destroys those still waiting
     gameState.gameRunning = false;
-    for (int i = 0; i < TOTAL_PLAYERS; i++) {
-        pthread_join(playerThreads[i], nullptr);
+    actors.stop();
+
+    for (int i = 0; i < localPlayers; i++) {
+        const LatencyStats& lat = gameState.moveLatency[i];
+        std::cout << "Player " << i + 1 << " input-to-move latency: mean " << lat.meanUs() / 1000.0
+                  << " ms, max " << lat.maxUs / 1000.0 << " ms over " << lat.count << " moves" << std::endl;
+    }
+
+    if (net.connected()) {
+        const LatencyHistogram& lat = net.tickToScreen;
+        std::cout << "Received " << net.snapshots << " snapshots (" << net.fullSnapshots << " full, "
+                  << net.traffic.bytesIn << " bytes), server tick to screen p50 " << lat.percentile(0.5) / 1e6
+                  << " ms, p99 " << lat.percentile(0.99) / 1e6 << " ms" << std::endl;
+        net.close();
+    }
+
+    metricsServer.stop();
+    if (metricsFile && !writeMetricsFile(metricsFile)) {
+        std::cerr << "Failed to write " << metricsFile << std::endl;
+    }
+    if (eventLogPath) {
+        eventLog().close();
+        std::cout << "Event log: " << eventLog().recordsWritten << " records in " << eventLogPath << ", dropped "
+                  << eventLog().dropped() << ", rotated " << eventLog().rotations << " times" << std::endl;
+    }
+
+    if (capture.isOpen()) {
+        capture.close();
+        std::cout << "Recorded " << capture.written << " frames to " << recordPath << ", dropped "
+                  << capture.dropped << ", failed " << capture.failed << std::endl;
+        std::cout << "Capture cost on the render thread: mean " << capture.meanCostUs() << " us, max "
+                  << capture.costMaxUs << " us" << std::endl;
+        if (recordFormat == CAPTURE_RAW) {
+            std::cout << "Convert with: ffmpeg -f rawvideo -pixel_format rgba -video_size " << windowSize << "x"
+                      << windowSize << " -framerate " << CAPTURE_FPS << " -i " << recordPath << " match.mp4" << std::endl;
+        }
     }
 
     return 0;
 }
 
 // Helper function implementations
-bool isPositionOccupied(int x, int y, const std::vector<Crate>& crates) {
-    for (const auto& crate : crates) {
-        if (crate.x == x && crate.y == y) {
-            return true;
+// Ground and walls into their chunks, then crates and coins, then players
+// on top, binned into the same chunks
+void renderSystem(void* arg, World& world, Commands&) {
+    FrameContext* frame = static_cast<FrameContext*>(arg);
+    RenderData* rd = static_cast<RenderData*>(frame->renderData);
+    ChunkedSprites<sf::Vertex>& entities = *rd->entities;
+
+    buildTileChunks(*rd->tiles, rd->pool);
+
+    entities.clear();
+
+    auto drawArchetype = [&](Archetype& a) {
+        for (int r = 0; r < a.size(); r++) {
+            entities.add(a.positions[r].x, a.positions[r].y, rd->sprites[a.sprites[r].id]);
         }
-    }
-    return false;
-}
+    };
+    world.each(COMP_POSITION | COMP_SPRITE, COMP_SCORE, drawArchetype);
 
-void generateCrates(std::vector<Crate>& crates, int N, const sf::Texture& crateTexture, int cellSize) {
-    for (int i = 0; i < MAX_CRATES; i++) {
-        Crate crate;
-        do {
-            crate.x = 1 + (rand() % (N - 2));
-            crate.y = 1 + (rand() % (N - 2));
-        } while (isPositionOccupied(crate.x, crate.y, crates));
-
-        crate.sprite.setTexture(crateTexture);
-        crate.sprite.setTextureRect(sf::IntRect(0, 0, 64, 64));
-        crate.sprite.setPosition(crate.y * cellSize, crate.x * cellSize);
-        crate.sprite.setScale(
-            static_cast<float>(cellSize) / 64,
-            static_cast<float>(cellSize) / 64
-        );
-        
-        crates.push_back(crate);
+    // Draw players if game is running
+    if (frame->running) {
+        world.each(COMP_POSITION | COMP_SPRITE | COMP_SCORE, 0, drawArchetype);
     }
 }
 
-bool trySpawnItem(GameState& gameState, int N, const sf::Texture& itemTexture, int cellSize, float currentTime) {
-    if (gameState.items.size() >= MAX_ITEMS) {
-        return false;
-    }
-
-    Item item;
-    bool validPosition;
-    int attempts = 0;
-    const int maxAttempts = 10;
+// The networked counterpart of renderSystem: crates from the local world
+// (generated from the same seed as the server's), coins and players from
+// the interpolated snapshot view
+void renderNetView(RenderData& rd, World& world, const NetView& view) {
+    ChunkedSprites<sf::Vertex>& entities = *rd.entities;
 
-    do {
-        validPosition = true;
-        item.x = 1 + (rand() % (N - 2));
-        item.y = 1 + (rand() % (N - 2));
+    buildTileChunks(*rd.tiles, rd.pool);
 
-        if (isPositionOccupied(item.x, item.y, gameState.crates)) {
-            validPosition = false;
-            continue;
+    entities.clear();
+    world.each(COMP_POSITION | COMP_OBSTACLE | COMP_SPRITE, 0, [&](Archetype& a) {
+        for (int r = 0; r < a.size(); r++) {
+            entities.add(a.positions[r].x, a.positions[r].y, rd.sprites[a.sprites[r].id]);
+        }
+    });
+    for (int c = 0; c < view.coinCount; c++) {
+        entities.add(view.coins[c] / rd.gridSize, view.coins[c] % rd.gridSize, rd.sprites[SPRITE_ITEM]);
+    }
+    if (view.running) {
+        for (int p = 0; p < TOTAL_PLAYERS; p++) {
+            entities.add(view.x[p], view.y[p], rd.sprites[SPRITE_PLAYER + p]);
         }
+    }
+}
 
-        for (const auto& existingItem : gameState.items) {
-            if (!existingItem.collected && existingItem.x == item.x && existingItem.y == item.y) {
-                validPosition = false;
-                break;
-            }
+// Directions held on a player's keys; -1 for either player's keys
+unsigned heldDirections(int playerNum) {
+    unsigned held = 0;
+    for (int p = 0; p < TOTAL_PLAYERS; p++) {
+        if (playerNum >= 0 && p != playerNum) continue;
+        for (int d = DIR_UP; d <= DIR_RIGHT; d++) {
+            if (sf::Keyboard::isKeyPressed(playerKeys[p][d])) held |= DIR_BIT(d);
         }
+    }
+    return held;
+}
 
-        attempts++;
-    } while (!validPosition && attempts < maxAttempts);
-
-    if (validPosition) {
-        item.sprite.setTexture(itemTexture);
-        item.sprite.setTextureRect(sf::IntRect(0, 0, 64, 64));
-        item.sprite.setPosition(item.y * cellSize, item.x * cellSize);
-        item.sprite.setScale(
-            static_cast<float>(cellSize) / 64,
-            static_cast<float>(cellSize) / 64
-        );
-        item.spawnTime = currentTime;
-        gameState.items.push_back(item);
-        return true;
+void publishState(StateExportWriter& writer, const GameState& gameState, int N, float currentTime, float remainingTime) {
+    ExportSnapshot* snap = writer.begin();
+    snap->elapsed = currentTime;
+    snap->timeRemaining = remainingTime > 0 ? remainingTime : 0;
+    snap->gridSize = N;
+    snap->running = gameState.gameRunning ? 1 : 0;
+
+    const World& world = gameState.world;
+    int count = 0;
+    for (int i = 0; i < TOTAL_PLAYERS && count < EXPORT_MAX_PLAYERS; i++, count++) {
+        const Position& pos = world.get<Position>(gameState.players[i]);
+        snap->players[count].x = pos.x;
+        snap->players[count].y = pos.y;
+        snap->players[count].score = world.get<Score>(gameState.players[i]).value;
     }
+    snap->playerCount = count;
+
+    count = 0;
+    world.each(COMP_POSITION | COMP_COLLECTIBLE, 0, [&](const Archetype& a) {
+        for (int r = 0; r < a.size() && count < EXPORT_MAX_ITEMS; r++, count++) {
+            snap->items[count].x = static_cast<int16_t>(a.positions[r].x);
+            snap->items[count].y = static_cast<int16_t>(a.positions[r].y);
+            snap->items[count].spawnTime = a.collectibles[r].spawnTime;
+        }
+    });
+    snap->itemCount = count;
+
+    count = 0;
+    world.each(COMP_POSITION | COMP_OBSTACLE, 0, [&](const Archetype& a) {
+        for (int r = 0; r < a.size() && count < EXPORT_MAX_CRATES; r++, count++) {
+            snap->crates[count].x = static_cast<int16_t>(a.positions[r].x);
+            snap->crates[count].y = static_cast<int16_t>(a.positions[r].y);
+        }
+    });
+    snap->crateCount = count;
 
-    return false;
+    writer.publish();
 }
 
-void* playerThread(void* arg) {
-    auto* threadData = static_cast<PlayerThreadData*>(arg);
-    int playerNum = threadData->playerNum;
-    GameState* gameState = threadData->gameState;
-    
-    while (gameState->gameRunning) {
-        bool moved = false;
-        
-        // Handle player 1 (WASD)
-        if (playerNum == 0) {
-            if (sf::Keyboard::isKeyPressed(sf::Keyboard::W)) {
-                MoveMessage msg = {playerNum, -1, 0};
-                gameState->moveQueue.push(msg);
-                moved = true;
-            }
-            else if (sf::Keyboard::isKeyPressed(sf::Keyboard::S)) {
-                MoveMessage msg = {playerNum, 1, 0};
-                gameState->moveQueue.push(msg);
-                moved = true;
-            }
-            else if (sf::Keyboard::isKeyPressed(sf::Keyboard::A)) {
-                MoveMessage msg = {playerNum, 0, -1};
-                gameState->moveQueue.push(msg);
-                moved = true;
-            }
-            else if (sf::Keyboard::isKeyPressed(sf::Keyboard::D)) {
-                MoveMessage msg = {playerNum, 0, 1};
-                gameState->moveQueue.push(msg);
-                moved = true;
-            }
+// sf::Image encodes PNG through its own writer, which is safe to call from
+// several encoder threads at once
+bool writePng(const char* path, const uint8_t* rgba, int width, int height) {
+    sf::Image image;
+    image.create(width, height, rgba);
+    return image.saveToFile(path);
+}
+
+// Samples a player's keys once per tick while a key is held or a move is
+// owed, and sleeps on their input event otherwise, so a pressed key moves
+// the player as soon as the frame loop sees it
+CoTask playerInput(GameState& gameState, CoScheduler& actors, int playerNum, int keyDelayMs, int keyRepeatMs) {
+    InputScheduler scheduler(keyDelayMs, keyRepeatMs);
+    PlayerInput& input = gameState.input[playerNum];
+    unsigned epoch = gameState.inputEpoch;
+
+    while (gameState.gameRunning) {
+        uint64_t seen = input.changed.version();
+        if (input.held == 0 && scheduler.idle()) {
+            co_await input.changed.wait(seen);
+        } else {
+            co_await actors.nextTick();
         }
-        // Handle player 2 (Arrow keys)
-        else if (playerNum == 1) {
-            if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up)) {
-                MoveMessage msg = {playerNum, -1, 0};
-                gameState->moveQueue.push(msg);
-                moved = true;
-            }
-            else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Down)) {
-                MoveMessage msg = {playerNum, 1, 0};
-                gameState->moveQueue.push(msg);
-                moved = true;
-            }
-            else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left)) {
-                MoveMessage msg = {playerNum, 0, -1};
-                gameState->moveQueue.push(msg);
-                moved = true;
-            }
-            else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right)) {
-                MoveMessage msg = {playerNum, 0, 1};
-                gameState->moveQueue.push(msg);
-                moved = true;
+
+        // A restore since the last step voids any move still owed
+        int64_t now = monotonicMicros();
+        if (gameState.inputEpoch != epoch) {
+            epoch = gameState.inputEpoch;
+            scheduler.dropPending(now);
+        }
+        int dir = scheduler.update(heldDirections(playerNum), now);
+        if (dir != DIR_NONE) {
+            MoveMessage msg;
+            msg.playerID = playerNum;
+            dirToDelta(dir, msg.newX, msg.newY);
+            msg.dueUs = scheduler.lastDue;
+
+            // Checked again under the lock: the restore may have landed
+            // while this step ran
+            pthread_mutex_lock(&gameState.queueMutex);
+            bool stale = gameState.inputEpoch != epoch;
+            if (!stale) gameState.moveQueue.push(msg);
+            pthread_mutex_unlock(&gameState.queueMutex);
+            if (stale) {
+                epoch = gameState.inputEpoch;
+                scheduler.dropPending(now);
+            } else {
+                countMetric(METRIC_MOVES_ENQUEUED);
             }
         }
-        
-        // Add a small delay after movement to prevent too rapid updates
-        if (moved) {
-            sf::sleep(sf::milliseconds(100));
-        } else {
-            // Small sleep to prevent CPU hogging when not moving
-            sf::sleep(sf::milliseconds(10));
+    }
+}
+
+// Raises spawnDue every ITEM_SPAWN_INTERVAL seconds of match time, counted
+// from the last spawn; ends when a restore starts a newer cadence
+CoTask spawnCadence(GameState& gameState, CoScheduler& actors, unsigned cadence, float firstDue) {
+    co_await actors.sleepUntil(firstDue);
+    while (gameState.gameRunning && gameState.cadence == cadence) {
+        uint64_t seen = gameState.spawned.version();
+        gameState.spawnDue = true;
+        while (gameState.spawnDue && gameState.cadence == cadence) {
+            co_await gameState.spawned.wait(seen);
+            seen = gameState.spawned.version();
         }
+        if (gameState.cadence != cadence) break;
+        co_await actors.sleepFor(ITEM_SPAWN_INTERVAL);
     }
-    
-    return nullptr;
-}
\ No newline at end of file
+}
+
+// Ends the match GAME_DURATION seconds into match time
+CoTask matchTimer(GameState& gameState, CoScheduler& actors) {
+    co_await actors.sleepUntil(GAME_DURATION);
+    gameState.timeUp = true;
+}
@@ -0,0 +1,468 @@
+#ifndef MAPGEN_H
+#define MAPGEN_H
+
+#include <pthread.h>
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include "rng.h"
+
+#define CELL_FLOOR 0
+#define CELL_WALL 1
+
+#define MAPGEN_DEFAULT_REGION 256
+#define MAPGEN_MAX_THREADS 64
+
+enum MapType {
+    MAP_RANDOM_FILL,
+    MAP_CAVES,
+    MAP_MAZE
+};
+
+struct MapConfig {
+    MapType type;
+    int size;
+    uint64_t seed;
+    int obstacleCount;      // MAP_RANDOM_FILL: exact number of interior obstacles
+    int fillPercent;        // MAP_CAVES: initial wall density
+    int smoothSteps;        // MAP_CAVES: cellular automaton iterations
+    int minComponentSize;   // pockets smaller than this are filled instead of connected
+    int regionSize;         // side of one independently generated region
+    int threads;
+    std::vector<std::pair<int, int> > starts;  // player starts, kept floor and connected
+
+    MapConfig() : type(MAP_RANDOM_FILL), size(0), seed(0), obstacleCount(0), fillPercent(45),
+                  smoothSteps(4), minComponentSize(0), regionSize(MAPGEN_DEFAULT_REGION), threads(1) {}
+};
+
+// Row-major grid, x is the row and y the column (same as the game board).
+// The outer ring is always wall.
+struct GameMap {
+    int size;
+    std::vector<uint8_t> cells;
+
+    GameMap() : size(0) {}
+    bool isWall(int x, int y) const { return cells[x * size + y] != CELL_FLOOR; }
+    bool isBorder(int x, int y) const { return x == 0 || y == 0 || x == size - 1 || y == size - 1; }
+};
+
+// Every region draws from its own stream so the result does not depend on
+// how regions are spread over threads.
+inline Rng regionRng(uint64_t seed, uint64_t region) {
+    return rngStream(seed, RNG_STREAM_MAPGEN, region);
+}
+
+// Interior regions, regionSize x regionSize, in row-major region order
+struct MapRegion {
+    int index;
+    int x0, y0, x1, y1;  // half-open interior bounds
+};
+
+inline std::vector<MapRegion> splitRegions(int size, int regionSize) {
+    std::vector<MapRegion> regions;
+    if (regionSize < 2) regionSize = 2;
+    for (int x = 1; x < size - 1; x += regionSize) {
+        for (int y = 1; y < size - 1; y += regionSize) {
+            MapRegion r;
+            r.index = static_cast<int>(regions.size());
+            r.x0 = x;
+            r.y0 = y;
+            r.x1 = std::min(x + regionSize, size - 1);
+            r.y1 = std::min(y + regionSize, size - 1);
+            regions.push_back(r);
+        }
+    }
+    return regions;
+}
+
+// Union-find over cell indices
+struct CellUnionFind {
+    std::vector<int> parent;
+
+    explicit CellUnionFind(int n = 0) : parent(n) {
+        for (int i = 0; i < n; i++) parent[i] = i;
+    }
+
+    int find(int a) {
+        while (parent[a] != a) {
+            parent[a] = parent[parent[a]];
+            a = parent[a];
+        }
+        return a;
+    }
+
+    void unite(int a, int b) {
+        a = find(a);
+        b = find(b);
+        if (a == b) return;
+        if (a < b) parent[b] = a; else parent[a] = b;
+    }
+};
+
+// Runs fn(ctx, regionIndex) for every region on up to cfg.threads pthreads.
+// Regions are handed out round-robin so the work split is fixed.
+struct RegionJob {
+    void (*fn)(void* ctx, int region);
+    void* ctx;
+    int regionCount;
+    int stride;
+    int first;
+};
+
+inline void* regionWorker(void* arg) {
+    RegionJob* job = static_cast<RegionJob*>(arg);
+    for (int r = job->first; r < job->regionCount; r += job->stride) {
+        job->fn(job->ctx, r);
+    }
+    return nullptr;
+}
+
+inline void forEachRegion(int regionCount, int threads, void (*fn)(void*, int), void* ctx) {
+    if (threads > MAPGEN_MAX_THREADS) threads = MAPGEN_MAX_THREADS;
+    if (threads > regionCount) threads = regionCount;
+    if (threads <= 1) {
+        for (int r = 0; r < regionCount; r++) fn(ctx, r);
+        return;
+    }
+
+    std::vector<RegionJob> jobs(threads);
+    std::vector<pthread_t> workers(threads);
+    for (int t = 0; t < threads; t++) {
+        jobs[t].fn = fn;
+        jobs[t].ctx = ctx;
+        jobs[t].regionCount = regionCount;
+        jobs[t].stride = threads;
+        jobs[t].first = t;
+    }
+    int started = 1;
+    for (int t = 1; t < threads; t++, started++) {
+        if (pthread_create(&workers[t], nullptr, regionWorker, &jobs[t]) != 0) break;
+    }
+    // Any worker that failed to start is run on the calling thread
+    for (int t = started; t < threads; t++) regionWorker(&jobs[t]);
+    regionWorker(&jobs[0]);
+    for (int t = 1; t < started; t++) pthread_join(workers[t], nullptr);
+}
+
+struct MapGenContext {
+    const MapConfig* cfg;
+    GameMap* map;
+    std::vector<MapRegion> regions;
+    std::vector<uint8_t> scratch;
+    std::vector<int> quota;
+    std::vector<uint8_t> reserved;
+    CellUnionFind uf;
+};
+
+inline void fillRegionExact(void* arg, int r) {
+    MapGenContext* ctx = static_cast<MapGenContext*>(arg);
+    const MapRegion& reg = ctx->regions[r];
+    int size = ctx->map->size;
+    Rng rng = regionRng(ctx->cfg->seed, r);
+
+    std::vector<int> free;
+    free.reserve((reg.x1 - reg.x0) * (reg.y1 - reg.y0));
+    for (int x = reg.x0; x < reg.x1; x++) {
+        for (int y = reg.y0; y < reg.y1; y++) {
+            if (!ctx->reserved[x * size + y]) free.push_back(x * size + y);
+        }
+    }
+
+    // Partial Fisher-Yates: sample without replacement, no retries
+    int want = std::min(ctx->quota[r], static_cast<int>(free.size()));
+    for (int i = 0; i < want; i++) {
+        int j = i + static_cast<int>(rng.below(static_cast<uint32_t>(free.size() - i)));
+        std::swap(free[i], free[j]);
+        ctx->map->cells[free[i]] = CELL_WALL;
+    }
+}
+
+inline void fillRegionNoise(void* arg, int r) {
+    MapGenContext* ctx = static_cast<MapGenContext*>(arg);
+    const MapRegion& reg = ctx->regions[r];
+    int size = ctx->map->size;
+    Rng rng = regionRng(ctx->cfg->seed, r);
+    uint32_t threshold = static_cast<uint32_t>(ctx->cfg->fillPercent);
+
+    for (int x = reg.x0; x < reg.x1; x++) {
+        for (int y = reg.y0; y < reg.y1; y++) {
+            ctx->map->cells[x * size + y] = rng.below(100) < threshold ? CELL_WALL : CELL_FLOOR;
+        }
+    }
+}
+
+// One 4-5 rule step, reading map->cells and writing scratch
+inline void smoothRegion(void* arg, int r) {
+    MapGenContext* ctx = static_cast<MapGenContext*>(arg);
+    const MapRegion& reg = ctx->regions[r];
+    int size = ctx->map->size;
+    const uint8_t* src = &ctx->map->cells[0];
+    uint8_t* dst = &ctx->scratch[0];
+
+    for (int x = reg.x0; x < reg.x1; x++) {
+        for (int y = reg.y0; y < reg.y1; y++) {
+            int walls = 0;
+            for (int dx = -1; dx <= 1; dx++) {
+                const uint8_t* row = src + (x + dx) * size + y;
+                walls += row[-1] + row[0] + row[1];
+            }
+            dst[x * size + y] = walls >= 5 ? CELL_WALL : CELL_FLOOR;
+        }
+    }
+}
+
+// Recursive backtracker on the odd lattice inside one region. Region
+// origins sit on odd coordinates, so neighbouring regions share lattice.
+inline void carveRegionMaze(void* arg, int r) {
+    MapGenContext* ctx = static_cast<MapGenContext*>(arg);
+    const MapRegion& reg = ctx->regions[r];
+    int size = ctx->map->size;
+    uint8_t* cells = &ctx->map->cells[0];
+    Rng rng = regionRng(ctx->cfg->seed, r);
+
+    for (int x = reg.x0; x < reg.x1; x++) {
+        for (int y = reg.y0; y < reg.y1; y++) cells[x * size + y] = CELL_WALL;
+    }
+
+    // Last lattice row/column that still has its wall ring inside the board
+    int xEnd = reg.x1, yEnd = reg.y1;
+    if (xEnd > size - 2) xEnd = size - 2;
+    if (yEnd > size - 2) yEnd = size - 2;
+
+    static const int DX[4] = {-2, 2, 0, 0};
+    static const int DY[4] = {0, 0, -2, 2};
+
+    std::vector<int> stack;
+    stack.push_back(reg.x0 * size + reg.y0);
+    cells[reg.x0 * size + reg.y0] = CELL_FLOOR;
+    while (!stack.empty()) {
+        int cur = stack.back();
+        int cx = cur / size, cy = cur % size;
+        int options[4];
+        int count = 0;
+        for (int d = 0; d < 4; d++) {
+            int nx = cx + DX[d], ny = cy + DY[d];
+            if (nx < reg.x0 || nx > xEnd || ny < reg.y0 || ny > yEnd) continue;
+            if (nx >= reg.x1 || ny >= reg.y1) continue;
+            if (cells[nx * size + ny] == CELL_FLOOR) continue;
+            options[count++] = d;
+        }
+        if (count == 0) {
+            stack.pop_back();
+            continue;
+        }
+        int d = options[rng.below(count)];
+        int nx = cx + DX[d], ny = cy + DY[d];
+        cells[(cx + DX[d] / 2) * size + (cy + DY[d] / 2)] = CELL_FLOOR;
+        cells[nx * size + ny] = CELL_FLOOR;
+        stack.push_back(nx * size + ny);
+    }
+}
+
+// Unions floor cells whose edges lie entirely inside the region. Roots
+// always end up as the smallest index, which keeps them inside the region.
+inline void uniteRegion(void* arg, int r) {
+    MapGenContext* ctx = static_cast<MapGenContext*>(arg);
+    const MapRegion& reg = ctx->regions[r];
+    int size = ctx->map->size;
+    const uint8_t* cells = &ctx->map->cells[0];
+
+    for (int x = reg.x0; x < reg.x1; x++) {
+        for (int y = reg.y0; y < reg.y1; y++) {
+            int c = x * size + y;
+            if (cells[c] != CELL_FLOOR) continue;
+            if (y + 1 < reg.y1 && cells[c + 1] == CELL_FLOOR) ctx->uf.unite(c, c + 1);
+            if (x + 1 < reg.x1 && cells[c + size] == CELL_FLOOR) ctx->uf.unite(c, c + size);
+        }
+    }
+}
+
+inline void uniteSeams(MapGenContext& ctx) {
+    int size = ctx.map->size;
+    const uint8_t* cells = &ctx.map->cells[0];
+    for (size_t i = 0; i < ctx.regions.size(); i++) {
+        const MapRegion& reg = ctx.regions[i];
+        // Right and bottom edges; the outer ring is wall so bounds hold
+        for (int x = reg.x0; x < reg.x1; x++) {
+            int c = x * size + reg.y1 - 1;
+            if (cells[c] == CELL_FLOOR && cells[c + 1] == CELL_FLOOR) ctx.uf.unite(c, c + 1);
+        }
+        for (int y = reg.y0; y < reg.y1; y++) {
+            int c = (reg.x1 - 1) * size + y;
+            if (cells[c] == CELL_FLOOR && cells[c + size] == CELL_FLOOR) ctx.uf.unite(c, c + size);
+        }
+    }
+}
+
+// Opens a cell and merges it with its floor neighbours
+inline void openCell(MapGenContext& ctx, int c) {
+    int size = ctx.map->size;
+    uint8_t* cells = &ctx.map->cells[0];
+    cells[c] = CELL_FLOOR;
+    const int offsets[4] = {-size, size, -1, 1};
+    for (int d = 0; d < 4; d++) {
+        if (cells[c + offsets[d]] == CELL_FLOOR) ctx.uf.unite(c, c + offsets[d]);
+    }
+}
+
+// Every floor cell must be reachable from every start. Pockets below
+// minComponentSize are filled, the rest get an L-shaped corridor carved
+// toward the first start until they touch its component.
+inline void connectMap(MapGenContext& ctx) {
+    GameMap& map = *ctx.map;
+    int size = map.size;
+    const MapConfig& cfg = *ctx.cfg;
+
+    ctx.uf = CellUnionFind(size * size);
+    forEachRegion(static_cast<int>(ctx.regions.size()), cfg.threads, uniteRegion, &ctx);
+    uniteSeams(ctx);
+
+    if (cfg.starts.empty()) return;
+    int target = cfg.starts[0].first * size + cfg.starts[0].second;
+
+    std::vector<int> componentSize(size * size, 0);
+    for (int c = 0; c < size * size; c++) {
+        if (map.cells[c] == CELL_FLOOR) componentSize[ctx.uf.find(c)]++;
+    }
+
+    // Pockets holding a start are never filled
+    if (cfg.minComponentSize > 0) {
+        for (size_t s = 0; s < cfg.starts.size(); s++) {
+            componentSize[ctx.uf.find(cfg.starts[s].first * size + cfg.starts[s].second)] = size * size;
+        }
+        std::vector<int> filled;
+        for (int c = 0; c < size * size; c++) {
+            if (map.cells[c] == CELL_FLOOR && componentSize[ctx.uf.find(c)] < cfg.minComponentSize) {
+                map.cells[c] = CELL_WALL;
+                filled.push_back(c);
+            }
+        }
+        // Whole pockets are gone, so their cells can leave the union-find
+        for (size_t i = 0; i < filled.size(); i++) ctx.uf.parent[filled[i]] = filled[i];
+    }
+
+    std::vector<int> pending;
+    for (size_t i = 1; i < cfg.starts.size(); i++) {
+        pending.push_back(cfg.starts[i].first * size + cfg.starts[i].second);
+    }
+    for (int c = 0; c < size * size; c++) {
+        if (map.cells[c] == CELL_FLOOR && ctx.uf.find(c) == c) pending.push_back(c);
+    }
+
+    for (size_t i = 0; i < pending.size(); i++) {
+        int c = pending[i];
+        if (ctx.uf.find(c) == ctx.uf.find(target)) continue;
+
+        int x = c / size, y = c % size;
+        int tx = target / size, ty = target % size;
+        while (ctx.uf.find(x * size + y) != ctx.uf.find(target)) {
+            if (y != ty) y += (ty > y) ? 1 : -1;
+            else x += (tx > x) ? 1 : -1;
+            openCell(ctx, x * size + y);
+        }
+    }
+}
+
+inline GameMap generateMap(const MapConfig& cfg) {
+    GameMap map;
+    map.size = cfg.size;
+    map.cells.assign(cfg.size * cfg.size, CELL_WALL);
+
+    MapGenContext ctx;
+    ctx.cfg = &cfg;
+    ctx.map = &map;
+    int regionSize = cfg.regionSize;
+    if (cfg.type == MAP_MAZE && regionSize % 2) regionSize++;
+    ctx.regions = splitRegions(cfg.size, regionSize);
+    int regionCount = static_cast<int>(ctx.regions.size());
+
+    for (int x = 1; x < cfg.size - 1; x++) {
+        for (int y = 1; y < cfg.size - 1; y++) map.cells[x * cfg.size + y] = CELL_FLOOR;
+    }
+
+    if (cfg.type == MAP_RANDOM_FILL) {
+        ctx.reserved.assign(cfg.size * cfg.size, 0);
+        for (size_t i = 0; i < cfg.starts.size(); i++) {
+            ctx.reserved[cfg.starts[i].first * cfg.size + cfg.starts[i].second] = 1;
+        }
+        // Obstacles are shared out by region area, remainder to the first regions
+        long long interior = static_cast<long long>(cfg.size - 2) * (cfg.size - 2);
+        ctx.quota.assign(regionCount, 0);
+        int assigned = 0;
+        for (int r = 0; r < regionCount; r++) {
+            const MapRegion& reg = ctx.regions[r];
+            long long area = static_cast<long long>(reg.x1 - reg.x0) * (reg.y1 - reg.y0);
+            ctx.quota[r] = interior > 0 ? static_cast<int>(cfg.obstacleCount * area / interior) : 0;
+            assigned += ctx.quota[r];
+        }
+        for (int r = 0; assigned < cfg.obstacleCount && regionCount > 0; r = (r + 1) % regionCount, assigned++) {
+            ctx.quota[r]++;
+        }
+        forEachRegion(regionCount, cfg.threads, fillRegionExact, &ctx);
+    } else if (cfg.type == MAP_CAVES) {
+        forEachRegion(regionCount, cfg.threads, fillRegionNoise, &ctx);
+        ctx.scratch = map.cells;
+        for (int step = 0; step < cfg.smoothSteps; step++) {
+            forEachRegion(regionCount, cfg.threads, smoothRegion, &ctx);
+            map.cells.swap(ctx.scratch);
+        }
+    } else {
+        forEachRegion(regionCount, cfg.threads, carveRegionMaze, &ctx);
+        // Link each region to its right and lower neighbour through one gap
+        int perRow = 0;
+        for (int r = 0; r < regionCount && ctx.regions[r].x0 == 1; r++) perRow++;
+        for (int r = 0; r < regionCount; r++) {
+            const MapRegion& reg = ctx.regions[r];
+            Rng rng = regionRng(cfg.seed, regionCount + r);
+            if (reg.y1 <= cfg.size - 2 && r + 1 < regionCount && ctx.regions[r + 1].x0 == reg.x0) {
+                int span = (std::min(reg.x1, cfg.size - 2) - reg.x0 + 1) / 2;
+                int x = reg.x0 + 2 * static_cast<int>(rng.below(span));
+                map.cells[x * cfg.size + reg.y1 - 1] = CELL_FLOOR;
+            }
+            if (reg.x1 <= cfg.size - 2 && r + perRow < regionCount) {
+                int span = (std::min(reg.y1, cfg.size - 2) - reg.y0 + 1) / 2;
+                int y = reg.y0 + 2 * static_cast<int>(rng.below(span));
+                map.cells[(reg.x1 - 1) * cfg.size + y] = CELL_FLOOR;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < cfg.starts.size(); i++) {
+        map.cells[cfg.starts[i].first * cfg.size + cfg.starts[i].second] = CELL_FLOOR;
+    }
+    connectMap(ctx);
+    return map;
+}
+
+// Flood fill from one cell; used to check the reachability guarantee
+inline int countReachable(const GameMap& map, int sx, int sy) {
+    int size = map.size;
+    if (map.isWall(sx, sy)) return 0;
+    std::vector<uint8_t> seen(size * size, 0);
+    std::vector<int> stack(1, sx * size + sy);
+    seen[sx * size + sy] = 1;
+    int count = 0;
+    const int offsets[4] = {-size, size, -1, 1};
+    while (!stack.empty()) {
+        int c = stack.back();
+        stack.pop_back();
+        count++;
+        for (int d = 0; d < 4; d++) {
+            int n = c + offsets[d];
+            if (!seen[n] && map.cells[n] == CELL_FLOOR) {
+                seen[n] = 1;
+                stack.push_back(n);
+            }
+        }
+    }
+    return count;
+}
+
+inline int countFloor(const GameMap& map) {
+    int count = 0;
+    for (size_t i = 0; i < map.cells.size(); i++) count += map.cells[i] == CELL_FLOOR;
+    return count;
+}
+
+#endif
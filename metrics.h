@@ -0,0 +1,295 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <pthread.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// Engine counters and histograms. Every thread that records gets its own
+// cache-line aligned shard and is its only writer, so recording is a plain
+// relaxed load and store with no lock prefix and no shared cache line.
+// Readers sum the shards on demand. A shard outlives its thread: when the
+// thread exits the shard goes back to a free list with its counts intact,
+// and the next new thread keeps adding to it.
+//
+// The totals are rendered as Prometheus text, served over a local Unix
+// socket by MetricsServer or written to a file with writeMetricsFile.
+
+#define METRICS_MAX_THREADS 64
+#define METRICS_HISTOGRAM_BUCKETS 21   // values 0, <= 1, <= 3, <= 7, ... <= 2^19 - 1, then +Inf
+
+enum MetricCounter {
+    METRIC_MOVES_ENQUEUED,
+    METRIC_MOVES_REJECTED,   // target cell was a wall or crate
+    METRIC_PICKUPS,
+    METRIC_SPAWNS,
+    METRIC_SPAWN_FAILURES,   // no reachable free cell
+    METRIC_FRAMES,
+    METRIC_COUNTER_COUNT
+};
+
+enum MetricHistogram {
+    METRIC_QUEUE_DEPTH,      // moves waiting when a frame starts
+    METRIC_FRAME_TIME_US,
+    METRIC_HISTOGRAM_COUNT
+};
+
+struct MetricInfo {
+    const char* name;
+    const char* help;
+};
+
+inline const MetricInfo& counterInfo(int c) {
+    static const MetricInfo info[METRIC_COUNTER_COUNT] = {
+        {"maga_moves_enqueued_total", "Moves queued by player or bot threads"},
+        {"maga_moves_rejected_total", "Moves into a wall or crate"},
+        {"maga_pickups_total", "Coins collected"},
+        {"maga_spawns_total", "Coins spawned"},
+        {"maga_spawn_failures_total", "Coin spawns skipped for lack of a reachable free cell"},
+        {"maga_frames_total", "Simulation frames or server ticks"}
+    };
+    return info[c];
+}
+
+inline const MetricInfo& histogramInfo(int h) {
+    static const MetricInfo info[METRIC_HISTOGRAM_COUNT] = {
+        {"maga_move_queue_depth", "Moves waiting in the queue at the start of a frame"},
+        {"maga_frame_time_us", "Frame or tick time in microseconds"}
+    };
+    return info[h];
+}
+
+struct alignas(64) MetricShard {
+    std::atomic<uint64_t> counters[METRIC_COUNTER_COUNT];
+    std::atomic<uint64_t> buckets[METRIC_HISTOGRAM_COUNT][METRICS_HISTOGRAM_BUCKETS];
+    std::atomic<uint64_t> sums[METRIC_HISTOGRAM_COUNT];
+    bool shared;   // the overflow shard, written by several threads
+};
+
+// Single writer, so a relaxed read-modify-write without an atomic add
+inline void metricAdd(MetricShard& shard, std::atomic<uint64_t>& cell, uint64_t n) {
+    if (shard.shared) {
+        cell.fetch_add(n, std::memory_order_relaxed);
+    } else {
+        cell.store(cell.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+}
+
+// Bucket b holds values up to 2^b - 1; the last one takes everything above
+inline int metricBucket(uint64_t v) {
+    int b = v ? 64 - __builtin_clzll(v) : 0;
+    return b < METRICS_HISTOGRAM_BUCKETS - 1 ? b : METRICS_HISTOGRAM_BUCKETS - 1;
+}
+
+struct MetricsRegistry {
+    MetricShard shards[METRICS_MAX_THREADS + 1];   // the last one is shared overflow
+    int freeSlots[METRICS_MAX_THREADS];
+    int freeCount;
+    int used;
+    pthread_mutex_t lock;
+
+    MetricsRegistry() : freeCount(0), used(0) {
+        memset(static_cast<void*>(shards), 0, sizeof(shards));
+        shards[METRICS_MAX_THREADS].shared = true;
+        pthread_mutex_init(&lock, nullptr);
+    }
+
+    MetricShard* claim() {
+        pthread_mutex_lock(&lock);
+        int slot = METRICS_MAX_THREADS;
+        if (freeCount > 0) {
+            slot = freeSlots[--freeCount];
+        } else if (used < METRICS_MAX_THREADS) {
+            slot = used++;
+        }
+        pthread_mutex_unlock(&lock);
+        return &shards[slot];
+    }
+
+    void release(MetricShard* shard) {
+        if (shard->shared) return;
+        pthread_mutex_lock(&lock);
+        freeSlots[freeCount++] = static_cast<int>(shard - shards);
+        pthread_mutex_unlock(&lock);
+    }
+
+    uint64_t counter(int c) const {
+        uint64_t n = 0;
+        for (int s = 0; s <= METRICS_MAX_THREADS; s++) n += shards[s].counters[c].load(std::memory_order_relaxed);
+        return n;
+    }
+};
+
+inline MetricsRegistry& metricsRegistry() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+// Claims a shard on first use and hands it back when the thread exits
+struct MetricThreadShard {
+    MetricShard* shard;
+    MetricThreadShard() : shard(metricsRegistry().claim()) {}
+    ~MetricThreadShard() { metricsRegistry().release(shard); }
+};
+
+inline MetricShard& metricShard() {
+    static thread_local MetricThreadShard local;
+    return *local.shard;
+}
+
+inline void countMetric(MetricCounter c, uint64_t n = 1) {
+    MetricShard& shard = metricShard();
+    metricAdd(shard, shard.counters[c], n);
+}
+
+inline void observeMetric(MetricHistogram h, uint64_t v) {
+    MetricShard& shard = metricShard();
+    metricAdd(shard, shard.buckets[h][metricBucket(v)], 1);
+    metricAdd(shard, shard.sums[h], v);
+}
+
+// Prometheus text exposition format; histogram buckets are cumulative
+inline std::string renderMetrics() {
+    const MetricsRegistry& reg = metricsRegistry();
+    std::string out;
+    char line[256];
+    for (int c = 0; c < METRIC_COUNTER_COUNT; c++) {
+        const MetricInfo& info = counterInfo(c);
+        snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", info.name, info.help,
+                 info.name, info.name, static_cast<unsigned long long>(reg.counter(c)));
+        out += line;
+    }
+    for (int h = 0; h < METRIC_HISTOGRAM_COUNT; h++) {
+        const MetricInfo& info = histogramInfo(h);
+        snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s histogram\n", info.name, info.help, info.name);
+        out += line;
+        uint64_t cumulative = 0, sum = 0;
+        for (int b = 0; b < METRICS_HISTOGRAM_BUCKETS; b++) {
+            for (int s = 0; s <= METRICS_MAX_THREADS; s++) {
+                cumulative += reg.shards[s].buckets[h][b].load(std::memory_order_relaxed);
+            }
+            if (b == METRICS_HISTOGRAM_BUCKETS - 1) {
+                snprintf(line, sizeof(line), "%s_bucket{le=\"+Inf\"} %llu\n", info.name,
+                         static_cast<unsigned long long>(cumulative));
+            } else {
+                snprintf(line, sizeof(line), "%s_bucket{le=\"%llu\"} %llu\n", info.name,
+                         static_cast<unsigned long long>((1ull << b) - 1), static_cast<unsigned long long>(cumulative));
+            }
+            out += line;
+        }
+        for (int s = 0; s <= METRICS_MAX_THREADS; s++) sum += reg.shards[s].sums[h].load(std::memory_order_relaxed);
+        snprintf(line, sizeof(line), "%s_sum %llu\n%s_count %llu\n", info.name, static_cast<unsigned long long>(sum),
+                 info.name, static_cast<unsigned long long>(cumulative));
+        out += line;
+    }
+    return out;
+}
+
+inline bool writeMetricsFile(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    std::string text = renderMetrics();
+    bool ok = fwrite(text.data(), 1, text.size(), f) == text.size();
+    return fclose(f) == 0 && ok;
+}
+
+// Answers every connection on a Unix socket with the current metrics. An
+// HTTP request gets an HTTP response, so both of these work:
+//   curl --unix-socket /tmp/maga_fight.metrics http://localhost/metrics
+//   socat - UNIX-CONNECT:/tmp/maga_fight.metrics
+struct MetricsServer {
+    std::string path;
+    int listenFd;
+    pthread_t thread;
+    std::atomic<bool> stopping;
+
+    MetricsServer() : listenFd(-1), stopping(false) {}
+    ~MetricsServer() { stop(); }
+
+    bool start(const char* socketPath) {
+        sockaddr_un addr;
+        if (listenFd >= 0 || strlen(socketPath) >= sizeof(addr.sun_path)) return false;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, socketPath);
+
+        listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenFd < 0) return false;
+        unlink(socketPath);   // left over from a previous run
+        if (bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listenFd, 8) != 0) {
+            close(listenFd);
+            listenFd = -1;
+            return false;
+        }
+        path = socketPath;
+        stopping = false;
+        if (pthread_create(&thread, nullptr, serve, this) != 0) {
+            close(listenFd);
+            listenFd = -1;
+            unlink(socketPath);
+            return false;
+        }
+        return true;
+    }
+
+    void stop() {
+        if (listenFd < 0) return;
+        stopping = true;
+        pthread_join(thread, nullptr);
+        close(listenFd);
+        listenFd = -1;
+        unlink(path.c_str());
+    }
+
+private:
+    static void reply(int fd) {
+        // Read whatever request arrives promptly; a bare connect gets the
+        // text straight away
+        char request[1024];
+        ssize_t n = 0;
+        pollfd p = {fd, POLLIN, 0};
+        if (poll(&p, 1, 100) > 0) n = read(fd, request, sizeof(request));
+        std::string body = renderMetrics();
+        std::string out;
+        if (n >= 4 && memcmp(request, "GET ", 4) == 0) {
+            out = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                  std::to_string(body.size()) + "\r\n\r\n";
+        }
+        out += body;
+        const char* data = out.data();
+        size_t left = out.size();
+        // MSG_NOSIGNAL: a client that hung up gets EPIPE and is dropped,
+        // instead of SIGPIPE taking the whole process down
+        while (left > 0) {
+            ssize_t w = send(fd, data, left, MSG_NOSIGNAL);
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) break;
+            data += w;
+            left -= static_cast<size_t>(w);
+        }
+    }
+
+    static void* serve(void* arg) {
+        MetricsServer* server = static_cast<MetricsServer*>(arg);
+        while (!server->stopping) {
+            // Wake up now and then to notice stop()
+            pollfd p = {server->listenFd, POLLIN, 0};
+            if (poll(&p, 1, 200) <= 0) continue;
+            int fd = accept(server->listenFd, nullptr, nullptr);
+            if (fd < 0) continue;
+            reply(fd);
+            close(fd);
+        }
+        return nullptr;
+    }
+};
+
+#endif
@@ -0,0 +1,81 @@
+// Authoritative match server for networked games: clients connect with
+// ./prog --connect <host>[:port] and are seated two to a match.
+// g++ -std=c++11 -O2 net_server.cpp -o net_server -pthread
+// ./net_server                      127.0.0.1:47000 until interrupted
+// ./net_server --port 5000 --public listen on every interface
+// ./net_server --seconds 120        stop after two minutes
+#include <signal.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include "netcode.h"
+#include "threadconf.h"
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void onSignal(int) { interrupted = 1; }
+
+int main(int argc, char** argv) {
+    int port = NET_DEFAULT_PORT;
+    bool loopbackOnly = true;
+    int seconds = 0;
+    NetServer server;
+    server.seed = static_cast<uint64_t>(time(0));
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--public") == 0) {
+            loopbackOnly = false;
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            server.seed = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--full-snapshots") == 0) {
+            server.deltas = false;
+        } else if (isThreadOption(argv[i]) && i + 1 < argc) {
+            if (!parseThreadOption(argv[i], argv[i + 1])) {
+                fprintf(stderr, "Bad %s %s (expected render|sim|input|pool=<value>)\n", argv[i], argv[i + 1]);
+                return -1;
+            }
+            i++;
+        }
+    }
+    if (port < 0 || port > 65535) {
+        fprintf(stderr, "--port must be 0..65535\n");
+        return -1;
+    }
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    if (!server.start(port, loopbackOnly)) {
+        fprintf(stderr, "Failed to listen on UDP port %d\n", port);
+        return -1;
+    }
+    printf("Listening on %s:%d, %d ticks/s, seed %llu\n", loopbackOnly ? "127.0.0.1" : "0.0.0.0", server.port,
+           NET_TICK_HZ, static_cast<unsigned long long>(server.seed));
+    fflush(stdout);
+
+    uint64_t lastOut = 0, lastIn = 0;
+    for (int s = 1; !interrupted && (seconds == 0 || s <= seconds); s++) {
+        sleep(1);
+        uint64_t out = server.traffic.bytesOut, in = server.traffic.bytesIn;
+        int clients = server.clientCount;
+        printf("%4ds  clients %3d  tick %8llu  out %7.1f kB/s  in %6.1f kB/s  per client %5.0f B/s\n", s, clients,
+               static_cast<unsigned long long>(server.ticks.load()), (out - lastOut) / 1000.0, (in - lastIn) / 1000.0,
+               clients ? static_cast<double>(out - lastOut) / clients : 0.0);
+        fflush(stdout);
+        lastOut = out;
+        lastIn = in;
+    }
+    server.stop();
+
+    const LatencyHistogram& cost = server.tickCost;
+    printf("\n%llu ticks, snapshots %llu delta / %llu full\n", static_cast<unsigned long long>(server.ticks.load()),
+           static_cast<unsigned long long>(server.deltaSnapshots.load()),
+           static_cast<unsigned long long>(server.fullSnapshots.load()));
+    printf("tick cost    p50 %.1f us  p99 %.1f us  max %.1f us\n", cost.percentile(0.5) / 1000.0,
+           cost.percentile(0.99) / 1000.0, cost.maxNs / 1000.0);
+    return 0;
+}
@@ -0,0 +1,809 @@
+#ifndef NETCODE_H
+#define NETCODE_H
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "game.h"
+#include "systems.h"
+#include "bot.h"
+#include "input.h"
+#include "metrics.h"
+#include "threadconf.h"
+
+// Authoritative match server and its clients over UDP.
+//
+// The server owns the simulation: clients send the directions they hold
+// and the server runs key repeat (InputScheduler) and the game systems for
+// them, NET_TICK_HZ times a second. Two clients share a match; a seat
+// with nobody in it is played by the greedy bot. After every tick each
+// client gets a snapshot of its match encoded as a delta against the last
+// snapshot it acknowledged, or a full one if that is too old. Inputs carry
+// the acknowledgement and are resent every frame, so a lost packet of
+// either kind is covered by the next one.
+//
+// Walls and crates are never sent: the welcome carries the match seed and
+// grid size, and the client generates the same map from them.
+//
+// Clients draw NET_INTERP_TICKS behind the newest snapshot, interpolating
+// player positions between the two snapshots around the drawn time.
+
+#define NET_DEFAULT_PORT 47000
+#define NET_MAGIC 0x4147414Du      // "MAGA"
+#define NET_VERSION 1
+#define NET_TICK_HZ 60
+#define NET_BOT_MOVE_TICKS (INPUT_REPEAT_MS * NET_TICK_HZ / 1000)
+#define NET_HISTORY 64             // snapshots kept as delta bases, power of two
+#define NET_INTERP_TICKS 2         // clients draw this many ticks behind
+#define NET_MAX_PACKET 1200
+#define NET_MAX_CLIENTS 256
+#define NET_CLIENT_TIMEOUT_MS 5000
+#define NET_HELLO_RETRY_MS 200
+
+enum NetPacketType {
+    NET_HELLO = 1,   // client -> server: magic, version
+    NET_WELCOME,     // server -> client: client id, seat, map, match ticks
+    NET_INPUT,       // client -> server: held directions, newest snapshot tick
+    NET_SNAPSHOT,    // server -> client: tick, base distance, server time, delta
+    NET_BYE          // client -> server
+};
+
+// Delta field bits
+#define NET_DELTA_PLAYERS 1u
+#define NET_DELTA_COINS 2u
+
+struct NetPlayerState {
+    uint8_t x, y;
+    uint16_t score;
+};
+
+// Everything a client needs to draw its match at one tick
+struct NetState {
+    uint32_t tick;       // 0 = empty slot
+    uint64_t serverUs;   // server monotonic time the tick finished
+    NetPlayerState players[TOTAL_PLAYERS];
+    uint8_t coinCount;
+    uint16_t coins[MAX_ITEMS];   // cells (x * gridSize + y), ascending
+};
+
+inline void captureNetState(const MatchState& match, uint32_t tick, uint64_t serverUs, NetState& out) {
+    out.tick = tick;
+    out.serverUs = serverUs;
+    for (int p = 0; p < TOTAL_PLAYERS; p++) {
+        const Position& pos = match.world.get<Position>(match.players[p]);
+        out.players[p].x = static_cast<uint8_t>(pos.x);
+        out.players[p].y = static_cast<uint8_t>(pos.y);
+        out.players[p].score = static_cast<uint16_t>(match.playerScore(p));
+    }
+    int count = 0;
+    match.world.each(COMP_POSITION | COMP_COLLECTIBLE, 0, [&](const Archetype& a) {
+        for (int r = 0; r < a.size() && count < MAX_ITEMS; r++) {
+            out.coins[count++] = static_cast<uint16_t>(a.positions[r].x * match.gridSize + a.positions[r].y);
+        }
+    });
+    std::sort(out.coins, out.coins + count);
+    out.coinCount = static_cast<uint8_t>(count);
+}
+
+// Little-endian packet writer; ok goes false instead of overflowing
+struct NetWriter {
+    uint8_t* data;
+    size_t capacity;
+    size_t size;
+    bool ok;
+
+    NetWriter(uint8_t* buffer, size_t cap) : data(buffer), capacity(cap), size(0), ok(true) {}
+
+    void put(uint64_t v, int bytes) {
+        if (size + bytes > capacity) {
+            ok = false;
+            return;
+        }
+        for (int i = 0; i < bytes; i++) data[size++] = static_cast<uint8_t>(v >> (8 * i));
+    }
+    void put8(uint32_t v) { put(v, 1); }
+    void put16(uint32_t v) { put(v, 2); }
+    void put32(uint32_t v) { put(v, 4); }
+    void put64(uint64_t v) { put(v, 8); }
+};
+
+struct NetReader {
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+    bool ok;
+
+    NetReader(const uint8_t* buffer, size_t len) : data(buffer), size(len), pos(0), ok(true) {}
+
+    uint64_t get(int bytes) {
+        if (pos + bytes > size) {
+            ok = false;
+            return 0;
+        }
+        uint64_t v = 0;
+        for (int i = 0; i < bytes; i++) v |= static_cast<uint64_t>(data[pos++]) << (8 * i);
+        return v;
+    }
+    uint32_t get8() { return static_cast<uint32_t>(get(1)); }
+    uint32_t get16() { return static_cast<uint32_t>(get(2)); }
+    uint32_t get32() { return static_cast<uint32_t>(get(4)); }
+    uint64_t get64() { return get(8); }
+};
+
+// cur as changes from base (nullptr: from nothing). Only players that
+// moved or scored are sent, and coins as the cells removed and added.
+inline void writeNetDelta(NetWriter& w, const NetState* base, const NetState& cur) {
+    unsigned playerMask = 0;
+    for (int p = 0; p < TOTAL_PLAYERS; p++) {
+        if (!base || memcmp(&base->players[p], &cur.players[p], sizeof(NetPlayerState)) != 0) playerMask |= 1u << p;
+    }
+    uint16_t removed[MAX_ITEMS], added[MAX_ITEMS];
+    int removedCount = 0, addedCount = 0;
+    int baseCount = base ? base->coinCount : 0;
+    int i = 0, j = 0;
+    while (i < baseCount || j < cur.coinCount) {
+        if (j == cur.coinCount || (i < baseCount && base->coins[i] < cur.coins[j])) {
+            removed[removedCount++] = base->coins[i++];
+        } else if (i == baseCount || cur.coins[j] < base->coins[i]) {
+            added[addedCount++] = cur.coins[j++];
+        } else {
+            i++;
+            j++;
+        }
+    }
+
+    unsigned fields = (playerMask ? NET_DELTA_PLAYERS : 0) | (removedCount || addedCount ? NET_DELTA_COINS : 0);
+    w.put8(fields);
+    if (fields & NET_DELTA_PLAYERS) {
+        w.put8(playerMask);
+        for (int p = 0; p < TOTAL_PLAYERS; p++) {
+            if (!(playerMask & (1u << p))) continue;
+            w.put8(cur.players[p].x);
+            w.put8(cur.players[p].y);
+            w.put16(cur.players[p].score);
+        }
+    }
+    if (fields & NET_DELTA_COINS) {
+        w.put8(removedCount);
+        for (int k = 0; k < removedCount; k++) w.put16(removed[k]);
+        w.put8(addedCount);
+        for (int k = 0; k < addedCount; k++) w.put16(added[k]);
+    }
+}
+
+// Applies a delta written against base (nullptr: from nothing) into out
+inline bool readNetDelta(NetReader& r, const NetState* base, NetState& out) {
+    if (base) {
+        out = *base;
+    } else {
+        memset(&out, 0, sizeof(out));
+    }
+    unsigned fields = r.get8();
+    if (fields & NET_DELTA_PLAYERS) {
+        unsigned playerMask = r.get8();
+        for (int p = 0; p < TOTAL_PLAYERS; p++) {
+            if (!(playerMask & (1u << p))) continue;
+            out.players[p].x = static_cast<uint8_t>(r.get8());
+            out.players[p].y = static_cast<uint8_t>(r.get8());
+            out.players[p].score = static_cast<uint16_t>(r.get16());
+        }
+    }
+    if (fields & NET_DELTA_COINS) {
+        unsigned removedCount = r.get8();
+        for (unsigned k = 0; k < removedCount && r.ok; k++) {
+            uint16_t cell = static_cast<uint16_t>(r.get16());
+            uint16_t* end = out.coins + out.coinCount;
+            uint16_t* at = std::lower_bound(out.coins, end, cell);
+            if (at == end || *at != cell) return false;
+            std::copy(at + 1, end, at);
+            out.coinCount--;
+        }
+        unsigned addedCount = r.get8();
+        for (unsigned k = 0; k < addedCount && r.ok; k++) {
+            uint16_t cell = static_cast<uint16_t>(r.get16());
+            if (out.coinCount >= MAX_ITEMS) return false;
+            uint16_t* end = out.coins + out.coinCount;
+            uint16_t* at = std::lower_bound(out.coins, end, cell);
+            std::copy_backward(at, end, end + 1);
+            *at = cell;
+            out.coinCount++;
+        }
+    }
+    return r.ok;
+}
+
+inline bool sameNetState(const NetState& a, const NetState& b) {
+    return a.tick == b.tick && memcmp(a.players, b.players, sizeof(a.players)) == 0 && a.coinCount == b.coinCount &&
+           std::equal(a.coins, a.coins + a.coinCount, b.coins);
+}
+
+inline bool sameNetAddr(const sockaddr_in& a, const sockaddr_in& b) {
+    return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+}
+
+// "host" or "host:port", numeric or by name
+inline bool resolveNetAddr(const char* text, sockaddr_in& addr) {
+    char host[256];
+    int port = NET_DEFAULT_PORT;
+    const char* colon = strrchr(text, ':');
+    size_t len = colon ? static_cast<size_t>(colon - text) : strlen(text);
+    if (len == 0 || len >= sizeof(host)) return false;
+    memcpy(host, text, len);
+    host[len] = 0;
+    if (colon) {
+        char* end;
+        long p = strtol(colon + 1, &end, 10);
+        if (end == colon + 1 || *end || p <= 0 || p > 65535) return false;
+        port = static_cast<int>(p);
+    }
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* found = nullptr;
+    if (getaddrinfo(host, nullptr, &hints, &found) != 0 || !found) return false;
+    memcpy(&addr, found->ai_addr, sizeof(addr));
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    freeaddrinfo(found);
+    return true;
+}
+
+// Per-client traffic; written by the thread that owns the socket
+struct NetTraffic {
+    std::atomic<uint64_t> bytesIn, bytesOut;
+    std::atomic<uint64_t> packetsIn, packetsOut;
+
+    NetTraffic() : bytesIn(0), bytesOut(0), packetsIn(0), packetsOut(0) {}
+
+    void sent(size_t bytes) {
+        bytesOut.store(bytesOut.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+        packetsOut.store(packetsOut.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    void received(size_t bytes) {
+        bytesIn.store(bytesIn.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+        packetsIn.store(packetsIn.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+};
+
+struct NetMatch {
+    MatchState state;
+    SystemScheduler systems;
+    FrameContext frame;
+    InputScheduler input[TOTAL_PLAYERS];
+    int seats[TOTAL_PLAYERS];   // client id, or -1 for the bot
+    Rng botRng;
+    uint32_t startTick, endTick;
+    NetState history[NET_HISTORY];
+
+    bool hasClients() const {
+        for (int p = 0; p < TOTAL_PLAYERS; p++) {
+            if (seats[p] >= 0) return true;
+        }
+        return false;
+    }
+};
+
+struct NetPeer {
+    bool active;
+    sockaddr_in addr;
+    int match, player;
+    unsigned held;        // directions held as of the newest input
+    uint32_t inputSeq;
+    uint32_t ackTick;     // newest snapshot the client has decoded
+    int64_t lastHeardUs;
+};
+
+struct NetServer {
+    int fd;
+    int port;
+    uint64_t seed;
+    bool deltas;          // false sends every snapshot in full, for comparison
+    pthread_t thread;
+    std::atomic<bool> stopping;
+
+    std::vector<NetMatch*> matches;   // nullptr once every client has left
+    std::vector<NetPeer> peers;       // indexed by client id
+    uint32_t tick;
+    int64_t periodUs;
+
+    // Written by the server thread; the atomics may be read while it runs,
+    // the histogram once it has stopped
+    NetTraffic traffic;
+    std::atomic<uint64_t> ticks;
+    std::atomic<uint64_t> fullSnapshots;
+    std::atomic<uint64_t> deltaSnapshots;
+    std::atomic<int> clientCount;
+    LatencyHistogram tickCost;   // simulate and send, ns
+
+    NetServer() : fd(-1), port(0), seed(0), deltas(true), stopping(false), tick(0), periodUs(1000000 / NET_TICK_HZ),
+                  ticks(0), fullSnapshots(0), deltaSnapshots(0), clientCount(0) {}
+
+    ~NetServer() {
+        stop();
+        for (size_t m = 0; m < matches.size(); m++) delete matches[m];
+    }
+
+    // Listens on 127.0.0.1:port, or every interface; port 0 picks a free one
+    bool start(int listenPort, bool loopbackOnly = true) {
+        fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd < 0) return false;
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(loopbackOnly ? INADDR_LOOPBACK : INADDR_ANY);
+        addr.sin_port = htons(static_cast<uint16_t>(listenPort));
+        socklen_t len = sizeof(addr);
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len) != 0) {
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+        port = ntohs(addr.sin_port);
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        stopping = false;
+        if (createRoleThread(&thread, ROLE_SIMULATION, 0, serverMain, this) != 0) {
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+        return true;
+    }
+
+    void stop() {
+        if (fd < 0) return;
+        stopping = true;
+        pthread_join(thread, nullptr);
+        ::close(fd);
+        fd = -1;
+    }
+
+private:
+    void send(const uint8_t* data, size_t size, const sockaddr_in& to) {
+        if (sendto(fd, data, size, 0, reinterpret_cast<const sockaddr*>(&to), sizeof(to)) == static_cast<ssize_t>(size)) {
+            traffic.sent(size);
+        }
+    }
+
+    void sendWelcome(int id) {
+        const NetPeer& peer = peers[id];
+        const NetMatch& m = *matches[peer.match];
+        uint8_t buf[32];
+        NetWriter w(buf, sizeof(buf));
+        w.put8(NET_WELCOME);
+        w.put16(static_cast<uint32_t>(id));
+        w.put8(static_cast<uint32_t>(peer.player));
+        w.put8(static_cast<uint32_t>(m.state.gridSize));
+        w.put64(m.state.seed);
+        w.put32(m.startTick);
+        w.put32(m.endTick);
+        w.put8(NET_TICK_HZ);
+        send(buf, w.size, peer.addr);
+    }
+
+    // A seat in a match that has a client and is still running, or a new match
+    void seat(NetPeer& peer, int id) {
+        for (size_t m = 0; m < matches.size(); m++) {
+            NetMatch* match = matches[m];
+            if (!match || !match->hasClients() || tick >= match->endTick) continue;
+            for (int p = 0; p < TOTAL_PLAYERS; p++) {
+                if (match->seats[p] >= 0) continue;
+                match->seats[p] = id;
+                match->input[p] = InputScheduler();
+                peer.match = static_cast<int>(m);
+                peer.player = p;
+                return;
+            }
+        }
+        size_t slot = std::find(matches.begin(), matches.end(), static_cast<NetMatch*>(nullptr)) - matches.begin();
+        if (slot == matches.size()) matches.push_back(nullptr);
+        NetMatch* match = new NetMatch;
+        uint64_t matchSeed = rngStream(seed, RNG_STREAM_MATCH, slot * 1000003ull + tick).next();
+        Rng sizeRng = rngStream(matchSeed, RNG_STREAM_GRID);
+        setupMatch(match->state, matchSeed, 15 + static_cast<int>(sizeRng.below(11)));
+        addGameSystems(match->systems, nullptr);
+        match->systems.parallel = false;
+        match->frame.match = &match->state;
+        match->frame.logSource = static_cast<uint32_t>(slot);
+        match->botRng = rngStream(matchSeed, RNG_STREAM_PLAYER);
+        match->startTick = tick;
+        match->endTick = tick + GAME_DURATION * NET_TICK_HZ;
+        for (int p = 0; p < TOTAL_PLAYERS; p++) match->seats[p] = -1;
+        for (int h = 0; h < NET_HISTORY; h++) match->history[h].tick = 0;
+        match->seats[0] = id;
+        matches[slot] = match;
+        peer.match = static_cast<int>(slot);
+        peer.player = 0;
+    }
+
+    void leave(int id) {
+        NetPeer& peer = peers[id];
+        if (!peer.active) return;
+        peer.active = false;
+        clientCount--;
+        NetMatch*& match = matches[peer.match];
+        match->seats[peer.player] = -1;
+        if (!match->hasClients()) {
+            delete match;
+            match = nullptr;
+        }
+    }
+
+    void handlePacket(const uint8_t* data, size_t size, const sockaddr_in& from, int64_t nowUs) {
+        NetReader r(data, size);
+        unsigned type = r.get8();
+        if (type == NET_HELLO) {
+            if (r.get32() != NET_MAGIC || r.get8() != NET_VERSION || !r.ok) return;
+            for (size_t i = 0; i < peers.size(); i++) {
+                if (peers[i].active && sameNetAddr(peers[i].addr, from)) {
+                    sendWelcome(static_cast<int>(i));   // the first welcome was lost
+                    return;
+                }
+            }
+            size_t id = 0;
+            while (id < peers.size() && peers[id].active) id++;
+            if (id == NET_MAX_CLIENTS) return;
+            if (id == peers.size()) peers.push_back(NetPeer());
+            NetPeer& peer = peers[id];
+            memset(&peer, 0, sizeof(peer));
+            peer.active = true;
+            peer.addr = from;
+            peer.lastHeardUs = nowUs;
+            seat(peer, static_cast<int>(id));
+            clientCount++;
+            sendWelcome(static_cast<int>(id));
+            return;
+        }
+
+        size_t id = r.get16();
+        if (!r.ok || id >= peers.size() || !peers[id].active || !sameNetAddr(peers[id].addr, from)) return;
+        NetPeer& peer = peers[id];
+        peer.lastHeardUs = nowUs;
+        if (type == NET_INPUT) {
+            uint32_t seq = r.get32();
+            unsigned held = r.get8();
+            uint32_t ack = r.get32();
+            if (!r.ok || seq <= peer.inputSeq) return;   // late or duplicate
+            peer.inputSeq = seq;
+            peer.held = held & (DIR_BIT(DIR_UP) | DIR_BIT(DIR_DOWN) | DIR_BIT(DIR_LEFT) | DIR_BIT(DIR_RIGHT));
+            if (ack > peer.ackTick && ack <= tick) peer.ackTick = ack;
+        } else if (type == NET_BYE) {
+            leave(static_cast<int>(id));
+        }
+    }
+
+    void receive(int64_t nowUs) {
+        uint8_t buf[NET_MAX_PACKET];
+        for (;;) {
+            sockaddr_in from;
+            socklen_t len = sizeof(from);
+            ssize_t n = recvfrom(fd, buf, sizeof(buf), 0, reinterpret_cast<sockaddr*>(&from), &len);
+            if (n < 0) break;
+            traffic.received(static_cast<size_t>(n));
+            handlePacket(buf, static_cast<size_t>(n), from, nowUs);
+        }
+    }
+
+    void simulate(NetMatch& m, int64_t nowUs) {
+        m.frame.moves.clear();
+        if (tick < m.endTick) {
+            for (int p = 0; p < TOTAL_PLAYERS; p++) {
+                int dir = DIR_NONE;
+                if (m.seats[p] >= 0) {
+                    dir = m.input[p].update(peers[m.seats[p]].held, nowUs);
+                } else if ((tick - m.startTick) % NET_BOT_MOVE_TICKS == 0) {
+                    dir = greedyBotMove(m.state, p, m.botRng);
+                }
+                if (dir == DIR_NONE) continue;
+                MoveMessage msg = {p, 0, 0, 0};
+                dirToDelta(dir, msg.newX, msg.newY);
+                m.frame.moves.push_back(msg);
+                countMetric(METRIC_MOVES_ENQUEUED);
+            }
+            m.frame.now = static_cast<float>(tick - m.startTick) / NET_TICK_HZ;
+            m.frame.running = true;
+            m.systems.run(m.state.world, &m.frame);
+        } else if (tick == m.endTick) {
+            const Leaderboard& board = m.state.leaderboard;
+            logEvent(EVENT_GAME_OVER, board.tiedForLead() ? -1 : board.at(0), board.score(board.at(0)), 0, 0,
+                     m.frame.logSource);
+        }
+        captureNetState(m.state, tick, static_cast<uint64_t>(monotonicMicros()), m.history[tick & (NET_HISTORY - 1)]);
+    }
+
+    void sendSnapshot(const NetPeer& peer) {
+        const NetMatch& m = *matches[peer.match];
+        const NetState& cur = m.history[tick & (NET_HISTORY - 1)];
+        const NetState* base = nullptr;
+        if (deltas && peer.ackTick != 0 && tick - peer.ackTick < NET_HISTORY) {
+            const NetState& acked = m.history[peer.ackTick & (NET_HISTORY - 1)];
+            if (acked.tick == peer.ackTick) base = &acked;
+        }
+        uint8_t buf[NET_MAX_PACKET];
+        NetWriter w(buf, sizeof(buf));
+        w.put8(NET_SNAPSHOT);
+        w.put32(tick);
+        w.put8(base ? tick - base->tick : 0);            // < NET_HISTORY
+        w.put32(static_cast<uint32_t>(cur.serverUs));   // wraps every 71 minutes
+        writeNetDelta(w, base, cur);
+        if (!w.ok) return;
+        send(buf, w.size, peer.addr);
+        if (base) {
+            deltaSnapshots.store(deltaSnapshots.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        } else {
+            fullSnapshots.store(fullSnapshots.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+
+    void runTick(int64_t nowUs) {
+        int64_t begin = monotonicMicros();
+        tick++;
+        for (size_t i = 0; i < peers.size(); i++) {
+            if (peers[i].active && nowUs - peers[i].lastHeardUs > NET_CLIENT_TIMEOUT_MS * 1000LL) {
+                leave(static_cast<int>(i));
+            }
+        }
+        for (size_t m = 0; m < matches.size(); m++) {
+            if (matches[m]) simulate(*matches[m], nowUs);
+        }
+        for (size_t i = 0; i < peers.size(); i++) {
+            if (peers[i].active) sendSnapshot(peers[i]);
+        }
+        uint64_t costUs = static_cast<uint64_t>(monotonicMicros() - begin);
+        tickCost.record(costUs * 1000);
+        ticks.store(tick, std::memory_order_relaxed);
+        countMetric(METRIC_FRAMES);
+        observeMetric(METRIC_FRAME_TIME_US, costUs);
+    }
+
+    // Ticks on a fixed grid and waits for packets in between
+    static void* serverMain(void* arg) {
+        NetServer& server = *static_cast<NetServer*>(arg);
+        int64_t dueUs = monotonicMicros() + server.periodUs;
+        while (!server.stopping) {
+            int64_t nowUs = monotonicMicros();
+            if (nowUs >= dueUs) {
+                server.runTick(nowUs);
+                dueUs += server.periodUs;
+                if (dueUs < nowUs) dueUs = nowUs + server.periodUs;   // no catching up after a stall
+                continue;
+            }
+            pollfd pfd = {server.fd, POLLIN, 0};
+            int waitMs = static_cast<int>((dueUs - nowUs + 999) / 1000);
+            if (poll(&pfd, 1, waitMs) > 0) server.receive(monotonicMicros());
+        }
+        return nullptr;
+    }
+};
+
+// A client's view of its match at the time being drawn
+struct NetView {
+    uint32_t tick;
+    float x[TOTAL_PLAYERS], y[TOTAL_PLAYERS];   // interpolated cells
+    int score[TOTAL_PLAYERS];
+    int coinCount;
+    uint16_t coins[MAX_ITEMS];
+    bool running;
+    float secondsLeft;
+};
+
+struct NetClient {
+    int fd;
+    int clientId;
+    int player;
+    int gridSize;
+    uint64_t seed;
+    uint32_t startTick, endTick;
+    int tickHz;
+
+    NetState states[NET_HISTORY];   // decoded snapshots by tick
+    uint32_t newestTick;
+    uint32_t inputSeq;
+    int64_t clockOffsetUs;          // local minus server clock, smallest seen
+    int64_t lastServerUs;
+    bool haveOffset;
+    uint32_t shownTick;             // newest tick a view has included
+    unsigned dropEvery;             // test hook: discard every n-th snapshot
+
+    NetTraffic traffic;
+    uint64_t snapshots, fullSnapshots, discarded;
+    LatencyHistogram tickToScreen;  // server tick done to first view showing it, ns (same host)
+
+    NetClient() : fd(-1), clientId(-1), player(-1), gridSize(0), seed(0), startTick(0), endTick(0), tickHz(NET_TICK_HZ),
+                  newestTick(0), inputSeq(0), clockOffsetUs(0), lastServerUs(0), haveOffset(false), shownTick(0), dropEvery(0),
+                  snapshots(0), fullSnapshots(0), discarded(0) {
+        for (int h = 0; h < NET_HISTORY; h++) states[h].tick = 0;
+    }
+
+    ~NetClient() { close(); }
+
+    bool connected() const { return fd >= 0 && clientId >= 0; }
+
+    // Says hello until welcomed or timeoutMs runs out
+    bool connect(const sockaddr_in& server, int timeoutMs) {
+        fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd < 0) return false;
+        if (::connect(fd, reinterpret_cast<const sockaddr*>(&server), sizeof(server)) != 0) {
+            close();
+            return false;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        int64_t deadline = monotonicMicros() + timeoutMs * 1000LL;
+        while (monotonicMicros() < deadline) {
+            uint8_t buf[16];
+            NetWriter w(buf, sizeof(buf));
+            w.put8(NET_HELLO);
+            w.put32(NET_MAGIC);
+            w.put8(NET_VERSION);
+            send(buf, w.size);
+            pollfd pfd = {fd, POLLIN, 0};
+            if (poll(&pfd, 1, NET_HELLO_RETRY_MS) > 0) {
+                receive();
+                if (clientId >= 0) return true;
+            }
+        }
+        close();
+        return false;
+    }
+
+    void close() {
+        if (fd < 0) return;
+        if (clientId >= 0) {
+            uint8_t buf[4];
+            NetWriter w(buf, sizeof(buf));
+            w.put8(NET_BYE);
+            w.put16(static_cast<uint32_t>(clientId));
+            send(buf, w.size);
+        }
+        ::close(fd);
+        fd = -1;
+        clientId = -1;
+    }
+
+    // Sent every frame whether or not anything changed; it doubles as the ack
+    void sendInput(unsigned held) {
+        if (!connected()) return;
+        uint8_t buf[16];
+        NetWriter w(buf, sizeof(buf));
+        w.put8(NET_INPUT);
+        w.put16(static_cast<uint32_t>(clientId));
+        w.put32(++inputSeq);
+        w.put8(held);
+        w.put32(newestTick);
+        send(buf, w.size);
+    }
+
+    // Reads every waiting packet; returns how many snapshots were new
+    int receive() {
+        int fresh = 0;
+        uint8_t buf[NET_MAX_PACKET];
+        for (;;) {
+            ssize_t n = recv(fd, buf, sizeof(buf), 0);
+            if (n < 0) break;
+            traffic.received(static_cast<size_t>(n));
+            NetReader r(buf, static_cast<size_t>(n));
+            unsigned type = r.get8();
+            if (type == NET_WELCOME && clientId < 0) {
+                int id = static_cast<int>(r.get16());
+                player = static_cast<int>(r.get8());
+                gridSize = static_cast<int>(r.get8());
+                seed = r.get64();
+                startTick = r.get32();
+                endTick = r.get32();
+                tickHz = static_cast<int>(r.get8());
+                if (r.ok && tickHz > 0 && player < TOTAL_PLAYERS) clientId = id;
+            } else if (type == NET_SNAPSHOT && clientId >= 0) {
+                if (readSnapshot(r)) fresh++;
+            }
+        }
+        return fresh;
+    }
+
+    // Interpolated state for the local time nowUs; false until the first
+    // snapshot arrives
+    bool view(int64_t nowUs, NetView& out) {
+        if (newestTick == 0) return false;
+        int64_t drawUs = nowUs - clockOffsetUs - NET_INTERP_TICKS * 1000000LL / tickHz;
+        // Newest snapshot at or before the drawn time, and the one after it
+        const NetState* a = nullptr;
+        const NetState* b = nullptr;
+        for (uint32_t t = newestTick; t > 0 && newestTick - t < NET_HISTORY; t--) {
+            const NetState& s = states[t & (NET_HISTORY - 1)];
+            if (s.tick != t) continue;
+            if (static_cast<int64_t>(s.serverUs) <= drawUs) {
+                a = &s;
+                break;
+            }
+            b = &s;
+        }
+        if (!a) a = b;       // everything is newer: show the oldest
+        if (!b) b = a;       // nothing newer: hold the newest
+        float f = 0;
+        if (b != a && b->serverUs > a->serverUs) {
+            f = static_cast<float>(drawUs - static_cast<int64_t>(a->serverUs)) / (b->serverUs - a->serverUs);
+        }
+
+        out.tick = a->tick;
+        for (int p = 0; p < TOTAL_PLAYERS; p++) {
+            out.x[p] = a->players[p].x + (b->players[p].x - a->players[p].x) * f;
+            out.y[p] = a->players[p].y + (b->players[p].y - a->players[p].y) * f;
+            out.score[p] = a->players[p].score;
+        }
+        out.coinCount = a->coinCount;
+        std::copy(a->coins, a->coins + a->coinCount, out.coins);
+        out.running = a->tick < endTick;
+        out.secondsLeft = a->tick < endTick ? static_cast<float>(endTick - a->tick) / tickHz : 0;
+
+        // The first view that shows any of a tick puts it on screen
+        uint32_t shown = f > 0 ? b->tick : a->tick;
+        uint32_t first = shown - shownTick < NET_HISTORY ? shownTick + 1 : shown - NET_HISTORY + 1;
+        for (uint32_t t = first; t <= shown && shownTick != 0; t++) {
+            const NetState& s = states[t & (NET_HISTORY - 1)];
+            int64_t latencyUs = nowUs - static_cast<int64_t>(s.serverUs);
+            if (s.tick == t && latencyUs >= 0) tickToScreen.record(static_cast<uint64_t>(latencyUs) * 1000);
+        }
+        if (shown > shownTick) shownTick = shown;
+        return true;
+    }
+
+private:
+    void send(const uint8_t* data, size_t size) {
+        if (::send(fd, data, size, 0) == static_cast<ssize_t>(size)) traffic.sent(size);
+    }
+
+    bool readSnapshot(NetReader& r) {
+        uint32_t tick = r.get32();
+        uint32_t baseDistance = r.get8();
+        uint32_t serverLowUs = r.get32();
+        if (!r.ok || tick <= newestTick || baseDistance >= NET_HISTORY) return false;   // late or duplicate
+        uint32_t baseTick = baseDistance ? tick - baseDistance : 0;
+        snapshots++;
+        if (dropEvery && snapshots % dropEvery == 0) {
+            discarded++;
+            return false;
+        }
+        const NetState* base = nullptr;
+        if (baseTick != 0) {
+            base = &states[baseTick & (NET_HISTORY - 1)];
+            if (base->tick != baseTick) {
+                discarded++;   // base overwritten; the server will fall back to a full one
+                return false;
+            }
+        } else {
+            fullSnapshots++;
+        }
+        NetState decoded;
+        if (!readNetDelta(r, base, decoded)) {
+            discarded++;
+            return false;
+        }
+        // Widen the server time around the previous one (or our own clock,
+        // which is the same clock on one host)
+        int64_t ref = lastServerUs ? lastServerUs : monotonicMicros();
+        int64_t serverUs = ref + static_cast<int32_t>(serverLowUs - static_cast<uint32_t>(ref));
+        lastServerUs = serverUs;
+        decoded.tick = tick;
+        decoded.serverUs = static_cast<uint64_t>(serverUs);
+        states[tick & (NET_HISTORY - 1)] = decoded;
+        if (shownTick == 0) shownTick = tick - 1;
+        newestTick = tick;
+
+        int64_t offset = monotonicMicros() - serverUs;
+        if (!haveOffset || offset < clockOffsetUs) clockOffsetUs = offset;
+        haveOffset = true;
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,212 @@
+#ifndef RENDER_CHUNKS_H
+#define RENDER_CHUNKS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "threadpool.h"
+
+// Board tile geometry split into square chunks, each with its own vertex
+// buffer. Chunks are independent, so on large boards they are built in
+// parallel on a thread pool and the render thread only submits the
+// finished buffers. Chunk boundaries depend on the grid size alone, so the
+// output is the same for any thread count.
+//
+// Sprites are binned into the same chunks each frame. With split screen,
+// tiles and sprites are built once and every view draws only the chunks
+// inside its own rectangle.
+//
+// Vertex is any type with position.x/y and texCoords.x/y members, such as
+// sf::Vertex, so this header stays free of SFML.
+
+#define RENDER_CHUNK_CELLS 64                   // a chunk is 64x64 cells
+#define RENDER_PARALLEL_MIN_CELLS (256 * 256)   // smaller boards build inline
+
+// Atlas rectangle of one tile kind, in texels
+struct TileUV {
+    float u0, v0, u1, v1;
+};
+
+inline TileUV tileUV(int x, int y, int width, int height) {
+    TileUV t = {static_cast<float>(x), static_cast<float>(y), static_cast<float>(x + width), static_cast<float>(y + height)};
+    return t;
+}
+
+// One textured cell-sized quad (4 vertices, Quads), written in place
+template<class Vertex>
+inline void setTileQuad(Vertex* q, float left, float top, float size, const TileUV& t) {
+    q[0].position.x = left;        q[0].position.y = top;        q[0].texCoords.x = t.u0; q[0].texCoords.y = t.v0;
+    q[1].position.x = left + size; q[1].position.y = top;        q[1].texCoords.x = t.u1; q[1].texCoords.y = t.v0;
+    q[2].position.x = left + size; q[2].position.y = top + size; q[2].texCoords.x = t.u1; q[2].texCoords.y = t.v1;
+    q[3].position.x = left;        q[3].position.y = top + size; q[3].texCoords.x = t.u0; q[3].texCoords.y = t.v1;
+}
+
+template<class Vertex>
+struct ChunkedTiles {
+    int gridSize;
+    int chunkCells;
+    int chunksPerSide;
+    const uint8_t* tiles;   // tile kind of each cell, gridSize * gridSize, row major
+    const TileUV* uvs;      // indexed by tile kind
+    float cellSize;
+    std::vector<std::vector<Vertex> > chunks;
+
+    ChunkedTiles() : gridSize(0), chunkCells(RENDER_CHUNK_CELLS), chunksPerSide(0), tiles(nullptr),
+                     uvs(nullptr), cellSize(0) {}
+
+    void layout(int size, int cells = RENDER_CHUNK_CELLS) {
+        gridSize = size;
+        chunkCells = cells > 0 ? cells : RENDER_CHUNK_CELLS;
+        chunksPerSide = (size + chunkCells - 1) / chunkCells;
+        chunks.resize(static_cast<size_t>(chunksPerSide) * chunksPerSide);
+    }
+
+    int chunkCount() const { return static_cast<int>(chunks.size()); }
+
+    // Cells are x = row, y = column and drawn at (y, x) * cellSize, like
+    // the rest of the board
+    void buildChunk(int c) {
+        int firstRow = c / chunksPerSide * chunkCells, firstCol = c % chunksPerSide * chunkCells;
+        int lastRow = firstRow + chunkCells < gridSize ? firstRow + chunkCells : gridSize;
+        int lastCol = firstCol + chunkCells < gridSize ? firstCol + chunkCells : gridSize;
+        std::vector<Vertex>& out = chunks[c];
+        out.resize(static_cast<size_t>(lastRow - firstRow) * (lastCol - firstCol) * 4);
+        Vertex* q = out.data();
+        for (int i = firstRow; i < lastRow; i++) {
+            const uint8_t* row = tiles + static_cast<size_t>(i) * gridSize;
+            for (int j = firstCol; j < lastCol; j++, q += 4) {
+                setTileQuad(q, j * cellSize, i * cellSize, cellSize, uvs[row[j]]);
+            }
+        }
+    }
+};
+
+// Sprite quads (crates, coins, players) binned into the same chunks as
+// the tiles, in the order they were added. A sprite covers one cell, so
+// it lies inside one chunk and a view only draws the chunks it overlaps.
+template<class Vertex>
+struct ChunkedSprites {
+    int chunkCells;
+    int chunksPerSide;
+    float cellSize;
+    std::vector<std::vector<Vertex> > chunks;
+    std::vector<int> used;   // chunks holding quads, so clear() skips the rest
+
+    ChunkedSprites() : chunkCells(RENDER_CHUNK_CELLS), chunksPerSide(0), cellSize(0) {}
+
+    void layout(int size, float cell, int cells = RENDER_CHUNK_CELLS) {
+        chunkCells = cells > 0 ? cells : RENDER_CHUNK_CELLS;
+        chunksPerSide = (size + chunkCells - 1) / chunkCells;
+        cellSize = cell;
+        chunks.assign(static_cast<size_t>(chunksPerSide) * chunksPerSide, std::vector<Vertex>());
+        used.clear();
+    }
+
+    int chunkCount() const { return static_cast<int>(chunks.size()); }
+
+    void clear() {
+        for (size_t i = 0; i < used.size(); i++) chunks[used[i]].clear();
+        used.clear();
+    }
+
+    // Cell (row, col) is drawn at (col, row) * cellSize, like the tiles
+    void add(int row, int col, const TileUV& t) {
+        addAt(row / chunkCells * chunksPerSide + col / chunkCells, col * cellSize, row * cellSize, t);
+    }
+
+    // A sprite between cells, such as an interpolated player: binned by
+    // the cell it starts in and drawn where it is. It may reach one cell
+    // into the next chunk, which visibleChunks() allows for.
+    void add(float row, float col, const TileUV& t) {
+        int r = std::min(std::max(static_cast<int>(std::floor(row)), 0), chunksPerSide * chunkCells - 1);
+        int c = std::min(std::max(static_cast<int>(std::floor(col)), 0), chunksPerSide * chunkCells - 1);
+        addAt(r / chunkCells * chunksPerSide + c / chunkCells, col * cellSize, row * cellSize, t);
+    }
+
+private:
+    void addAt(int c, float left, float top, const TileUV& t) {
+        std::vector<Vertex>& out = chunks[c];
+        if (out.empty()) used.push_back(c);
+        out.resize(out.size() + 4);
+        setTileQuad(&out[out.size() - 4], left, top, cellSize, t);
+    }
+};
+
+// Chunks a view of the board can see: columns [col0, col1) and rows
+// [row0, row1), in chunks
+struct ChunkRange {
+    int col0, row0, col1, row1;
+};
+
+// left, top, width and height are the view's world rectangle in pixels.
+// The range starts a cell early, for sprites binned in the chunk before
+// that reach into the view.
+inline ChunkRange visibleChunks(int chunkCells, int chunksPerSide, float cellSize, float left, float top, float width,
+                                float height) {
+    float chunkPx = chunkCells * cellSize;
+    ChunkRange r = {static_cast<int>(std::floor((left - cellSize) / chunkPx)),
+                    static_cast<int>(std::floor((top - cellSize) / chunkPx)),
+                    static_cast<int>(std::ceil((left + width) / chunkPx)),
+                    static_cast<int>(std::ceil((top + height) / chunkPx))};
+    r.col0 = std::max(r.col0, 0);
+    r.row0 = std::max(r.row0, 0);
+    r.col1 = std::min(r.col1, chunksPerSide);
+    r.row1 = std::min(r.row1, chunksPerSide);
+    return r;
+}
+
+// Window fraction of view i out of n: a grid as close to square as fits,
+// filled row by row, with the last row's views stretched to full width
+struct ViewportRect {
+    float left, top, width, height;
+};
+
+inline ViewportRect splitViewport(int i, int n) {
+    int cols = 1;
+    while (cols * cols < n) cols++;
+    int rows = (n + cols - 1) / cols;
+    int row = i / cols, col = i % cols;
+    int inRow = row == rows - 1 ? n - row * cols : cols;
+    ViewportRect v = {static_cast<float>(col) / inRow, static_cast<float>(row) / rows, 1.0f / inRow, 1.0f / rows};
+    return v;
+}
+
+// Centre of a view of viewPx pixels that follows the cell at focusPx
+// without showing past the board's edge, on one axis
+inline float viewCentre(float focusPx, float viewPx, float boardPx) {
+    if (viewPx >= boardPx) return boardPx / 2;
+    return std::min(std::max(focusPx, viewPx / 2), boardPx - viewPx / 2);
+}
+
+template<class Vertex>
+struct TileChunkTask {
+    ChunkedTiles<Vertex>* grid;
+    int chunk;
+};
+
+template<class Vertex>
+inline void buildTileChunkTask(void* arg) {
+    TileChunkTask<Vertex>* task = static_cast<TileChunkTask<Vertex>*>(arg);
+    task->grid->buildChunk(task->chunk);
+}
+
+// Rebuilds every chunk; on pool when given and the board is large enough
+// to be worth waking it. Must not be called from one of pool's own tasks.
+template<class Vertex>
+inline void buildTileChunks(ChunkedTiles<Vertex>& grid, ThreadPool* pool) {
+    int count = grid.chunkCount();
+    if (!pool || count < 2 || grid.gridSize * grid.gridSize < RENDER_PARALLEL_MIN_CELLS) {
+        for (int c = 0; c < count; c++) grid.buildChunk(c);
+        return;
+    }
+    std::vector<TileChunkTask<Vertex> > tasks(count);
+    for (int c = 0; c < count; c++) {
+        tasks[c].grid = &grid;
+        tasks[c].chunk = c;
+        pool->submit(buildTileChunkTask<Vertex>, &tasks[c]);
+    }
+    pool->waitIdle();
+}
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <atomic>
+#include <cstdint>
+
+// Every random decision in the game draws from a stream derived from one
+// master seed, so a run can be replayed from the seed alone. Streams are
+// keyed by what they are used for (and by region, player, ...), never by
+// which thread happens to run the work.
+enum RngStreamId {
+    RNG_STREAM_GRID = 1,
+    RNG_STREAM_MAPGEN,
+    RNG_STREAM_SPAWN,
+    RNG_STREAM_VISUAL,
+    RNG_STREAM_PLAYER,
+    RNG_STREAM_MATCH,
+    RNG_STREAM_ROLLOUT,
+    RNG_STREAM_THREAD = 0x1000
+};
+
+inline uint64_t splitMix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// xoshiro256**
+struct Rng {
+    uint64_t s[4];
+
+    explicit Rng(uint64_t seed = 0) { reseed(seed); }
+
+    void reseed(uint64_t seed) {
+        for (int i = 0; i < 4; i++) s[i] = splitMix64(seed);
+    }
+
+    uint64_t next() {
+        uint64_t result = rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    // Uniform in [0, bound), multiply-shift instead of a modulo
+    uint32_t below(uint32_t bound) {
+        return static_cast<uint32_t>(((next() >> 32) * bound) >> 32);
+    }
+
+    // Uniform in [0, 1)
+    double uniform() {
+        return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+private:
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+};
+
+// Independent stream for (stream, index) under a master seed
+inline Rng rngStream(uint64_t masterSeed, uint64_t stream, uint64_t index = 0) {
+    uint64_t mix = masterSeed;
+    uint64_t a = splitMix64(mix) ^ (stream * 0xD1B54A32D192ED03ULL);
+    uint64_t b = splitMix64(a) ^ (index * 0x8CB92BA72F3D8DD7ULL);
+    return Rng(splitMix64(b));
+}
+
+inline uint64_t& rngMasterSeed() {
+    static uint64_t seed = 0;
+    return seed;
+}
+
+// Per-thread stream. Threads whose draws affect the game call bindThreadRng
+// with a stable key (player number, worker slot) first; unbound threads get
+// the next free key, which is only reproducible if threads start in order.
+struct ThreadRngSlot {
+    bool bound;
+    Rng rng;
+    ThreadRngSlot() : bound(false) {}
+};
+
+inline ThreadRngSlot& threadRngSlot() {
+    static thread_local ThreadRngSlot slot;
+    return slot;
+}
+
+inline Rng& threadRng() {
+    static std::atomic<uint64_t> nextKey(0);
+    ThreadRngSlot& slot = threadRngSlot();
+    if (!slot.bound) {
+        slot.rng = rngStream(rngMasterSeed(), RNG_STREAM_THREAD, nextKey++);
+        slot.bound = true;
+    }
+    return slot.rng;
+}
+
+inline void bindThreadRng(uint64_t stream, uint64_t index) {
+    ThreadRngSlot& slot = threadRngSlot();
+    slot.rng = rngStream(rngMasterSeed(), stream, index);
+    slot.bound = true;
+}
+
+#endif
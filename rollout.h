@@ -0,0 +1,259 @@
+#ifndef ROLLOUT_H
+#define ROLLOUT_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <type_traits>
+#include <vector>
+#include "game.h"
+#include "input.h"
+#include "threadpool.h"
+
+// Monte Carlo bot. The search copies a compact, trivially copyable snapshot
+// of the match (one Board plus a few scalars, ~560 bytes) for every
+// rollout, plays it forward with a cheap randomized greedy policy for both
+// players and scores the result. At the root each legal first move is a
+// bandit arm picked by UCB1; the most visited arm is played.
+//
+// Rollouts are split into fixed chunks, each with its own RNG stream, and
+// the chunks are spread over a thread pool. The result depends only on the
+// seed and the chunk count, not on how many threads ran them.
+
+#define ROLLOUT_DEFAULT_COUNT 512
+#define ROLLOUT_DEFAULT_DEPTH 30          // moves per player, 3 s at key-repeat pace
+#define ROLLOUT_DEFAULT_CHUNKS 16
+#define ROLLOUT_EPSILON_PERCENT 25        // chance the policy moves at random
+#define ROLLOUT_STEP_SECONDS (INPUT_REPEAT_MS / 1000.0f)
+#define ROLLOUT_UCB_C 1.4
+
+struct RolloutState {
+    Board<MAX_GRID_SIZE> board;
+    Rng spawnRng;
+    float now;
+    float lastItemSpawnTime;
+    int16_t itemsSpawned;
+    int16_t score[TOTAL_PLAYERS];
+    int8_t px[TOTAL_PLAYERS];
+    int8_t py[TOTAL_PLAYERS];
+};
+
+static_assert(std::is_trivially_copyable<RolloutState>::value, "rollouts clone the state with a plain copy");
+
+inline RolloutState rolloutFromMatch(const MatchState& match, float now) {
+    RolloutState s;
+    s.board = match.board;
+    s.board.clearPlayers();
+    for (int i = 0; i < TOTAL_PLAYERS; i++) {
+        const Position& pos = match.world.get<Position>(match.players[i]);
+        s.px[i] = static_cast<int8_t>(pos.x);
+        s.py[i] = static_cast<int8_t>(pos.y);
+        s.score[i] = static_cast<int16_t>(match.world.get<Score>(match.players[i]).value);
+        s.board.addPlayer(pos.x, pos.y);
+    }
+    s.spawnRng = match.spawnRng;
+    s.now = now;
+    s.lastItemSpawnTime = match.lastItemSpawnTime;
+    s.itemsSpawned = static_cast<int16_t>(match.itemsSpawned);
+    return s;
+}
+
+// One move for every player (DIR_NONE stands still), then pickups and the
+// spawn timer, like one key-repeat interval of the real game. Spawns pick
+// any free open cell; every floor cell is reachable on generated maps.
+inline void rolloutStep(RolloutState& s, const int* dirs) {
+    s.board.clearPlayers();
+    for (int p = 0; p < TOTAL_PLAYERS; p++) {
+        if (dirs[p] != DIR_NONE) {
+            int dx, dy;
+            dirToDelta(dirs[p], dx, dy);
+            if (s.board.isOpen(s.px[p] + dx, s.py[p] + dy)) {
+                s.px[p] = static_cast<int8_t>(s.px[p] + dx);
+                s.py[p] = static_cast<int8_t>(s.py[p] + dy);
+            }
+        }
+        if (s.board.pickup(s.px[p], s.py[p])) s.score[p]++;
+        s.board.addPlayer(s.px[p], s.py[p]);
+    }
+
+    s.now += ROLLOUT_STEP_SECONDS;
+    if (s.now - s.lastItemSpawnTime >= ITEM_SPAWN_INTERVAL && s.itemsSpawned < MAX_ITEMS) {
+        int x, y;
+        if (s.board.pickSpawn(static_cast<uint32_t>(s.spawnRng.next() >> 32), x, y, true)) {
+            s.board.setItem(x, y);
+            s.itemsSpawned++;
+            s.lastItemSpawnTime = s.now;
+        }
+    }
+}
+
+// Manhattan distance from (x, y) to the nearest coin, or -1 if none
+inline int nearestCoinDistance(const RolloutState& s, int x, int y, int& coinX, int& coinY) {
+    int best = -1;
+    for (int r = 1; r < s.board.size - 1; r++) {
+        uint64_t row = s.board.items[r];
+        if (!row) continue;
+        int dx = std::abs(r - x);
+        if (best >= 0 && dx >= best) continue;
+        while (row) {
+            int c = lowestBit(row);
+            row &= row - 1;
+            int d = dx + std::abs(c - y);
+            if (best < 0 || d < best) {
+                best = d;
+                coinX = r;
+                coinY = c;
+            }
+        }
+    }
+    return best;
+}
+
+// Randomized greedy: usually an open step that closes in on the nearest
+// coin, otherwise a random open step
+inline int rolloutPolicy(const RolloutState& s, int p, Rng& rng) {
+    unsigned open = s.board.openNeighbours(s.px[p], s.py[p]);
+    if (!open) return DIR_NONE;
+    if (rng.below(100) >= ROLLOUT_EPSILON_PERCENT) {
+        int cx, cy;
+        if (nearestCoinDistance(s, s.px[p], s.py[p], cx, cy) >= 0) {
+            unsigned closer = 0;
+            if (cx < s.px[p]) closer |= DIR_BIT(DIR_UP);
+            if (cx > s.px[p]) closer |= DIR_BIT(DIR_DOWN);
+            if (cy < s.py[p]) closer |= DIR_BIT(DIR_LEFT);
+            if (cy > s.py[p]) closer |= DIR_BIT(DIR_RIGHT);
+            if (closer & open) open &= closer;
+        }
+    }
+    return selectBit(open, static_cast<int>(rng.below(popCount(open))));
+}
+
+struct RolloutConfig {
+    int rollouts;
+    int depth;
+    int chunks;
+    uint64_t seed;
+
+    RolloutConfig() : rollouts(ROLLOUT_DEFAULT_COUNT), depth(ROLLOUT_DEFAULT_DEPTH),
+                      chunks(ROLLOUT_DEFAULT_CHUNKS), seed(0) {}
+};
+
+struct RolloutArm {
+    double total;
+    int visits;
+};
+
+struct RolloutChunk {
+    const RolloutState* root;
+    const RolloutConfig* cfg;
+    int player;
+    int index;
+    int rollouts;
+    unsigned legal;
+    RolloutArm arms[4];
+};
+
+// Score difference at the end of the rollout, nudged toward being close
+// to a coin so equal scores still prefer useful positions
+inline double rolloutValue(const RolloutState& s, int player) {
+    double value = 0;
+    for (int p = 0; p < TOTAL_PLAYERS; p++) value += p == player ? s.score[p] : -s.score[p];
+    int cx, cy;
+    int d = nearestCoinDistance(s, s.px[player], s.py[player], cx, cy);
+    if (d >= 0) value -= 0.01 * d;
+    return value;
+}
+
+inline void runRolloutChunk(void* arg) {
+    RolloutChunk& chunk = *static_cast<RolloutChunk*>(arg);
+    const RolloutConfig& cfg = *chunk.cfg;
+    Rng rng = rngStream(cfg.seed, RNG_STREAM_ROLLOUT, static_cast<uint64_t>(chunk.index));
+    for (int d = 0; d < 4; d++) {
+        chunk.arms[d].total = 0;
+        chunk.arms[d].visits = 0;
+    }
+
+    int horizon = cfg.depth;
+    int left = static_cast<int>((GAME_DURATION - chunk.root->now) / ROLLOUT_STEP_SECONDS);
+    if (left < horizon) horizon = left > 1 ? left : 1;
+
+    for (int r = 0; r < chunk.rollouts; r++) {
+        // UCB1 over the legal first moves; untried arms first
+        int arm = -1;
+        double bestScore = 0;
+        for (int d = 0; d < 4; d++) {
+            if (!(chunk.legal & DIR_BIT(d))) continue;
+            const RolloutArm& a = chunk.arms[d];
+            double score = a.visits == 0 ? 1e9 : a.total / a.visits + ROLLOUT_UCB_C * std::sqrt(std::log(r + 1.0) / a.visits);
+            if (arm < 0 || score > bestScore) {
+                arm = d;
+                bestScore = score;
+            }
+        }
+
+        RolloutState s = *chunk.root;
+        s.spawnRng.reseed(rng.next());   // the real spawns are not known in advance
+        int dirs[TOTAL_PLAYERS];
+        for (int step = 0; step < horizon; step++) {
+            for (int p = 0; p < TOTAL_PLAYERS; p++) {
+                dirs[p] = step == 0 && p == chunk.player ? arm : rolloutPolicy(s, p, rng);
+            }
+            rolloutStep(s, dirs);
+        }
+        chunk.arms[arm].total += rolloutValue(s, chunk.player);
+        chunk.arms[arm].visits++;
+    }
+}
+
+struct RolloutStats {
+    long long rollouts;
+    RolloutArm arms[4];
+};
+
+// Picks the move for player; runs on pool when given, else inline. Must
+// not be called from one of pool's own tasks (it waits for the pool).
+inline int rolloutBotMove(const RolloutState& root, int player, const RolloutConfig& cfg,
+                          ThreadPool* pool, RolloutStats* stats = nullptr) {
+    unsigned legal = root.board.openNeighbours(root.px[player], root.py[player]);
+    if (!legal) return DIR_NONE;
+
+    int chunks = cfg.chunks > 0 ? cfg.chunks : 1;
+    std::vector<RolloutChunk> work(chunks);
+    for (int c = 0; c < chunks; c++) {
+        work[c].root = &root;
+        work[c].cfg = &cfg;
+        work[c].player = player;
+        work[c].index = c;
+        work[c].rollouts = cfg.rollouts / chunks + (c < cfg.rollouts % chunks ? 1 : 0);
+        work[c].legal = legal;
+    }
+    if (pool) {
+        for (int c = 0; c < chunks; c++) pool->submit(runRolloutChunk, &work[c]);
+        pool->waitIdle();
+    } else {
+        for (int c = 0; c < chunks; c++) runRolloutChunk(&work[c]);
+    }
+
+    RolloutArm arms[4] = {{0, 0}, {0, 0}, {0, 0}, {0, 0}};
+    for (int c = 0; c < chunks; c++) {
+        for (int d = 0; d < 4; d++) {
+            arms[d].total += work[c].arms[d].total;
+            arms[d].visits += work[c].arms[d].visits;
+        }
+    }
+    int best = DIR_NONE;
+    for (int d = 0; d < 4; d++) {
+        if (!(legal & DIR_BIT(d))) continue;
+        if (best == DIR_NONE || arms[d].visits > arms[best].visits ||
+            (arms[d].visits == arms[best].visits && arms[d].total > arms[best].total)) {
+            best = d;
+        }
+    }
+    if (stats) {
+        stats->rollouts += cfg.rollouts;
+        for (int d = 0; d < 4; d++) stats->arms[d] = arms[d];
+    }
+    return best;
+}
+
+#endif
@@ -0,0 +1,224 @@
+#ifndef SAVEGAME_H
+#define SAVEGAME_H
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "game.h"
+
+// Binary save format for a whole match: a fixed header followed by packed
+// player, crate and item arrays. Only the authored state is stored; board
+// and connectivity are rebuilt from the crates and items on restore, so the
+// map generator never runs again. The same bytes serve as an in-memory
+// snapshot for rollback and for forking a match into what-if copies.
+
+#define SAVE_MAGIC 0x5653474Du   // "MGSV"
+#define SAVE_VERSION 2
+#define SAVE_DEFAULT_FILE "match.sav"
+
+struct SaveHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t seed;
+    uint64_t rng[4];
+    int32_t gridSize;
+    float elapsed;
+    float lastItemSpawnTime;
+    float itemLifetime;
+    int32_t itemsSpawned;
+    int32_t playerCount;
+    int32_t crateCount;
+    int32_t itemCount;
+};
+
+struct SavePlayer {
+    int32_t x, y, score;
+};
+
+struct SaveCrate {
+    int16_t x, y;
+};
+
+// Only coins still on the board are saved
+struct SaveItem {
+    int16_t x, y;
+    int32_t value;
+    float spawnTime;
+    float expiresAt;   // 0 if the coin has no lifetime
+};
+
+inline size_t savedSize(int players, int crates, int items) {
+    return sizeof(SaveHeader) + players * sizeof(SavePlayer) + crates * sizeof(SaveCrate) +
+           items * sizeof(SaveItem);
+}
+
+// Serializes the match into buf, reusing its capacity; elapsed is the
+// match time at the moment of the snapshot
+inline void snapshotMatch(const MatchState& match, float elapsed, std::vector<char>& buf) {
+    const World& world = match.world;
+    int crates = world.count(COMP_POSITION | COMP_OBSTACLE);
+    int items = world.count(COMP_POSITION | COMP_COLLECTIBLE);
+    buf.resize(savedSize(TOTAL_PLAYERS, crates, items));
+    char* out = buf.data();
+
+    SaveHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SAVE_MAGIC;
+    header.version = SAVE_VERSION;
+    header.seed = match.seed;
+    for (int i = 0; i < 4; i++) header.rng[i] = match.spawnRng.s[i];
+    header.gridSize = match.gridSize;
+    header.elapsed = elapsed;
+    header.lastItemSpawnTime = match.lastItemSpawnTime;
+    header.itemLifetime = match.itemLifetime;
+    header.itemsSpawned = match.itemsSpawned;
+    header.playerCount = TOTAL_PLAYERS;
+    header.crateCount = crates;
+    header.itemCount = items;
+    memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+
+    for (int i = 0; i < TOTAL_PLAYERS; i++) {
+        const Position& pos = world.get<Position>(match.players[i]);
+        SavePlayer sp = {pos.x, pos.y, world.get<Score>(match.players[i]).value};
+        memcpy(out, &sp, sizeof(sp));
+        out += sizeof(sp);
+    }
+    world.each(COMP_POSITION | COMP_OBSTACLE, 0, [&](const Archetype& a) {
+        for (int r = 0; r < a.size(); r++) {
+            SaveCrate sc = {static_cast<int16_t>(a.positions[r].x), static_cast<int16_t>(a.positions[r].y)};
+            memcpy(out, &sc, sizeof(sc));
+            out += sizeof(sc);
+        }
+    });
+    world.each(COMP_POSITION | COMP_COLLECTIBLE, 0, [&](const Archetype& a) {
+        for (int r = 0; r < a.size(); r++) {
+            SaveItem si = {static_cast<int16_t>(a.positions[r].x), static_cast<int16_t>(a.positions[r].y),
+                           a.collectibles[r].value, a.collectibles[r].spawnTime,
+                           (a.mask & COMP_LIFETIME) ? a.lifetimes[r].expiresAt : 0.0f};
+            memcpy(out, &si, sizeof(si));
+            out += sizeof(si);
+        }
+    });
+}
+
+// Restores a match from a snapshot; the match is left untouched if the
+// data is truncated, from another version or does not fit this build
+inline bool restoreMatch(MatchState& match, const void* data, size_t size, float& elapsed) {
+    if (size < sizeof(SaveHeader)) return false;
+    const char* in = static_cast<const char*>(data);
+    SaveHeader header;
+    memcpy(&header, in, sizeof(header));
+    in += sizeof(header);
+
+    if (header.magic != SAVE_MAGIC || header.version != SAVE_VERSION) return false;
+    if (header.gridSize < 3 || header.gridSize > MAX_GRID_SIZE) return false;
+    if (header.playerCount != TOTAL_PLAYERS || header.crateCount < 0 || header.itemCount < 0 ||
+        header.itemCount > MAX_ITEMS || header.crateCount > header.gridSize * header.gridSize) {
+        return false;
+    }
+    if (size < savedSize(header.playerCount, header.crateCount, header.itemCount)) return false;
+
+    // Everything is checked before the match is touched: positions inside
+    // the border, crates and coins on distinct cells
+    const int n = header.gridSize;
+    const char* body = in;
+    std::vector<char> used(n * n, 0);
+    for (int i = 0; i < header.playerCount; i++, in += sizeof(SavePlayer)) {
+        SavePlayer sp;
+        memcpy(&sp, in, sizeof(sp));
+        if (sp.x < 1 || sp.x > n - 2 || sp.y < 1 || sp.y > n - 2) return false;
+    }
+    for (int i = 0; i < header.crateCount; i++, in += sizeof(SaveCrate)) {
+        SaveCrate sc;
+        memcpy(&sc, in, sizeof(sc));
+        if (sc.x < 1 || sc.x > n - 2 || sc.y < 1 || sc.y > n - 2 || used[sc.x * n + sc.y]) return false;
+        used[sc.x * n + sc.y] = 1;
+    }
+    for (int i = 0; i < header.itemCount; i++, in += sizeof(SaveItem)) {
+        SaveItem si;
+        memcpy(&si, in, sizeof(si));
+        if (si.x < 1 || si.x > n - 2 || si.y < 1 || si.y > n - 2 || used[si.x * n + si.y]) return false;
+        used[si.x * n + si.y] = 1;
+    }
+
+    match.gridSize = n;
+    match.seed = header.seed;
+    for (int i = 0; i < 4; i++) match.spawnRng.s[i] = header.rng[i];
+    match.lastItemSpawnTime = header.lastItemSpawnTime;
+    match.itemLifetime = header.itemLifetime;
+    match.itemsSpawned = header.itemsSpawned;
+    match.resetWorld();
+
+    in = body;
+    for (int i = 0; i < header.playerCount; i++, in += sizeof(SavePlayer)) {
+        SavePlayer sp;
+        memcpy(&sp, in, sizeof(sp));
+        match.playerPos(i).x = sp.x;
+        match.playerPos(i).y = sp.y;
+        match.setScore(i, sp.score);
+    }
+    for (int i = 0; i < header.crateCount; i++, in += sizeof(SaveCrate)) {
+        SaveCrate sc;
+        memcpy(&sc, in, sizeof(sc));
+        match.world.create(crateDesc(sc.x, sc.y));
+    }
+    for (int i = 0; i < header.itemCount; i++, in += sizeof(SaveItem)) {
+        SaveItem si;
+        memcpy(&si, in, sizeof(si));
+        EntityDesc d = itemDesc(si.x, si.y, si.spawnTime, 0);
+        d.collectible.value = si.value;
+        if (si.expiresAt > 0) {
+            d.mask |= COMP_LIFETIME;
+            d.lifetime.expiresAt = si.expiresAt;
+        }
+        match.world.create(d);
+    }
+    match.rebuildOccupancy();
+    elapsed = header.elapsed;
+    return true;
+}
+
+// Writes to a temporary file and renames it, so a crash never leaves a
+// half-written save behind
+inline bool saveMatchFile(const MatchState& match, float elapsed, const std::string& path) {
+    std::vector<char> buf;
+    snapshotMatch(match, elapsed, buf);
+
+    std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd < 0) return false;
+    bool ok = ::write(fd, buf.data(), buf.size()) == static_cast<ssize_t>(buf.size());
+    ok = ::close(fd) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Maps the file read-only and restores straight out of the page cache
+inline bool loadMatchFile(MatchState& match, const std::string& path, float& elapsed) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(SaveHeader))) {
+        ::close(fd);
+        return false;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    void* base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) return false;
+    bool ok = restoreMatch(match, base, size, elapsed);
+    munmap(base, size);
+    return ok;
+}
+
+#endif
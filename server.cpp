@@ -0,0 +1,349 @@
+// Hosts many independent bot matches in one process, ticked by a shared
+// work-stealing thread pool. Each match tick is one task; a match waiting
+// for its next tick sits in a timer heap and costs nothing.
+// g++ -std=c++11 -O2 server.cpp -o server -pthread
+// ./server --matches 500 --threads 8 --seconds 10          60 ticks/s per match, real time
+// ./server --matches 500 --threads 8 --seconds 10 --fast   back-to-back ticks (capacity test)
+// ./server --mc-bot                                        player 1 uses the Monte Carlo bot
+// ./server --metrics /tmp/maga_server.metrics              Prometheus text on a Unix socket
+// ./server --pin pool=1-7 --pin sim=0                      pin workers and the tick dispatcher
+// ./server --event-log /tmp/server.evlog                   binary event log, see eventlog_decode
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <queue>
+#include <vector>
+#include "game.h"
+#include "systems.h"
+#include "input.h"
+#include "bot.h"
+#include "rollout.h"
+#include "threadpool.h"
+#include "metrics.h"
+#include "threadconf.h"
+#include "eventlog.h"
+
+#define SERVER_TICK_HZ 60
+#define BOT_MOVE_TICKS (INPUT_REPEAT_MS * SERVER_TICK_HZ / 1000)   // bots move as fast as key repeat
+
+// Written only by its own worker; the counters are read by the reporter
+struct alignas(64) WorkerStats {
+    LatencyHistogram tickCost;
+    LatencyHistogram lag;   // due time to tick start, real-time mode only
+    std::atomic<long long> ticks;
+    std::atomic<long long> matchesDone;
+    std::atomic<long long> results[TOTAL_PLAYERS + 1];   // wins per player, then ties
+
+    WorkerStats() : ticks(0), matchesDone(0) {
+        for (int i = 0; i <= TOTAL_PLAYERS; i++) results[i] = 0;
+    }
+};
+
+struct Server;
+
+struct ServerMatch {
+    int slot;
+    int played;          // matches finished in this slot
+    MatchState state;
+    SystemScheduler systems;
+    FrameContext frame;
+    Rng botRng;
+    int tick;
+    int64_t dueUs;
+    Server* server;
+};
+
+struct Server {
+    uint64_t seed;
+    bool fast;
+    bool mcBot;
+    RolloutConfig rollout;
+    int64_t periodUs;
+    std::atomic<bool> stopping;
+    ThreadPool pool;
+    std::vector<WorkerStats> stats;
+    std::vector<ServerMatch> matches;
+
+    // Matches waiting for their next tick, earliest first
+    pthread_mutex_t timerLock;
+    pthread_cond_t timerCond;
+    std::priority_queue<std::pair<int64_t, int>, std::vector<std::pair<int64_t, int> >,
+                        std::greater<std::pair<int64_t, int> > > timers;
+
+    Server() : seed(0), fast(false), mcBot(false), periodUs(1000000 / SERVER_TICK_HZ), stopping(false) {
+        pthread_mutex_init(&timerLock, nullptr);
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&timerCond, &attr);
+        pthread_condattr_destroy(&attr);
+    }
+
+    ~Server() {
+        pthread_cond_destroy(&timerCond);
+        pthread_mutex_destroy(&timerLock);
+    }
+};
+
+void startMatch(ServerMatch& m) {
+    uint64_t matchSeed = rngStream(m.server->seed, RNG_STREAM_MATCH,
+                                   (static_cast<uint64_t>(m.slot) << 32) | static_cast<uint32_t>(m.played)).next();
+    Rng sizeRng = rngStream(matchSeed, RNG_STREAM_GRID);
+    setupMatch(m.state, matchSeed, 15 + static_cast<int>(sizeRng.below(11)));
+    m.botRng = rngStream(matchSeed, RNG_STREAM_PLAYER);
+    m.tick = 0;
+}
+
+void tickMatch(void* arg) {
+    ServerMatch& m = *static_cast<ServerMatch*>(arg);
+    Server& server = *m.server;
+    WorkerStats& stats = server.stats[poolWorkerSlot().index];
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    if (!server.fast) {
+        int64_t lagUs = monotonicMicros() - m.dueUs;
+        stats.lag.record(lagUs > 0 ? static_cast<uint64_t>(lagUs) * 1000 : 0);
+    }
+
+    m.frame.moves.clear();
+    if (m.tick % BOT_MOVE_TICKS == 0) {
+        for (int p = 0; p < TOTAL_PLAYERS; p++) {
+            int dir;
+            if (p == 0 && server.mcBot) {
+                // Already on a pool worker, so the rollouts run inline
+                RolloutConfig cfg = server.rollout;
+                cfg.seed = m.botRng.next();
+                dir = rolloutBotMove(rolloutFromMatch(m.state, static_cast<float>(m.tick) / SERVER_TICK_HZ), p, cfg, nullptr);
+            } else {
+                dir = greedyBotMove(m.state, p, m.botRng);
+            }
+            if (dir == DIR_NONE) continue;
+            MoveMessage msg = {p, 0, 0, 0};
+            dirToDelta(dir, msg.newX, msg.newY);
+            m.frame.moves.push_back(msg);
+            countMetric(METRIC_MOVES_ENQUEUED);
+        }
+    }
+    observeMetric(METRIC_QUEUE_DEPTH, m.frame.moves.size());
+    m.frame.now = static_cast<float>(m.tick) / SERVER_TICK_HZ;
+    m.systems.run(m.state.world, &m.frame);
+    m.tick++;
+
+    if (m.tick >= GAME_DURATION * SERVER_TICK_HZ) {
+        const Leaderboard& board = m.state.leaderboard;
+        int winner = board.tiedForLead() ? -1 : board.at(0);
+        stats.results[winner < 0 ? TOTAL_PLAYERS : winner]++;
+        logEvent(EVENT_GAME_OVER, winner, board.score(board.at(0)), 0, 0, m.frame.logSource);
+        m.played++;
+        stats.matchesDone++;
+        startMatch(m);
+    }
+
+    uint64_t costNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+    stats.tickCost.record(costNs);
+    stats.ticks++;
+    countMetric(METRIC_FRAMES);
+    observeMetric(METRIC_FRAME_TIME_US, costNs / 1000);
+
+    if (server.stopping) return;
+    if (server.fast) {
+        server.pool.submit(tickMatch, &m);
+        return;
+    }
+    m.dueUs += server.periodUs;
+    pthread_mutex_lock(&server.timerLock);
+    bool earliest = server.timers.empty() || m.dueUs < server.timers.top().first;
+    server.timers.push(std::make_pair(m.dueUs, m.slot));
+    if (earliest) pthread_cond_signal(&server.timerCond);
+    pthread_mutex_unlock(&server.timerLock);
+}
+
+// Hands every due match to the pool until deadlineUs
+void dispatchUntil(Server& server, int64_t deadlineUs) {
+    std::vector<int> due;
+    pthread_mutex_lock(&server.timerLock);
+    for (;;) {
+        int64_t now = monotonicMicros();
+        if (now >= deadlineUs) break;
+        while (!server.timers.empty() && server.timers.top().first <= now) {
+            due.push_back(server.timers.top().second);
+            server.timers.pop();
+        }
+        if (!due.empty()) {
+            pthread_mutex_unlock(&server.timerLock);
+            for (size_t i = 0; i < due.size(); i++) server.pool.submit(tickMatch, &server.matches[due[i]]);
+            due.clear();
+            pthread_mutex_lock(&server.timerLock);
+            continue;
+        }
+        int64_t wakeUs = server.timers.empty() ? deadlineUs : std::min(deadlineUs, server.timers.top().first);
+        timespec ts;
+        ts.tv_sec = wakeUs / 1000000;
+        ts.tv_nsec = (wakeUs % 1000000) * 1000;
+        pthread_cond_timedwait(&server.timerCond, &server.timerLock, &ts);
+    }
+    pthread_mutex_unlock(&server.timerLock);
+}
+
+long long totalTicks(const Server& server) {
+    long long n = 0;
+    for (size_t i = 0; i < server.stats.size(); i++) n += server.stats[i].ticks;
+    return n;
+}
+
+long long totalMatches(const Server& server) {
+    long long n = 0;
+    for (size_t i = 0; i < server.stats.size(); i++) n += server.stats[i].matchesDone;
+    return n;
+}
+
+int main(int argc, char** argv) {
+    int matchCount = 100;
+    int threads = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    int seconds = 10;
+    const char* metricsSocket = nullptr;
+    const char* metricsFile = nullptr;
+    const char* eventLogPath = nullptr;
+    int eventLogMb = EVENTLOG_DEFAULT_FILE_BYTES >> 20;
+    Server server;
+    server.seed = static_cast<uint64_t>(time(0));
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--matches") == 0 && i + 1 < argc) {
+            matchCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            server.seed = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--fast") == 0) {
+            server.fast = true;
+        } else if (strcmp(argv[i], "--mc-bot") == 0) {
+            server.mcBot = true;
+        } else if (strcmp(argv[i], "--rollouts") == 0 && i + 1 < argc) {
+            server.rollout.rollouts = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+            metricsSocket = argv[++i];
+        } else if (strcmp(argv[i], "--metrics-file") == 0 && i + 1 < argc) {
+            metricsFile = argv[++i];
+        } else if (strcmp(argv[i], "--event-log") == 0 && i + 1 < argc) {
+            eventLogPath = argv[++i];
+        } else if (strcmp(argv[i], "--event-log-mb") == 0 && i + 1 < argc) {
+            eventLogMb = atoi(argv[++i]);
+        } else if (isThreadOption(argv[i]) && i + 1 < argc) {
+            if (!parseThreadOption(argv[i], argv[i + 1])) {
+                fprintf(stderr, "Bad %s %s (expected render|sim|input|pool=<value>)\n", argv[i], argv[i + 1]);
+                return -1;
+            }
+            i++;
+        }
+    }
+    applyThreadRole(ROLE_SIMULATION, 0);   // this thread dispatches the ticks
+    if (matchCount < 1 || seconds < 1) {
+        fprintf(stderr, "--matches and --seconds must be positive\n");
+        return -1;
+    }
+
+    MetricsServer metricsServer;
+    if (metricsSocket && !metricsServer.start(metricsSocket)) {
+        fprintf(stderr, "Failed to listen on %s\n", metricsSocket);
+        return -1;
+    }
+    if (eventLogPath && (eventLogMb < 1 || !eventLog().open(eventLogPath, static_cast<uint64_t>(eventLogMb) << 20))) {
+        fprintf(stderr, "Failed to open event log %s\n", eventLogPath);
+        return -1;
+    }
+
+    threads = server.pool.start(threads);
+    if (threads == 0) {
+        fprintf(stderr, "Failed to start worker threads\n");
+        return -1;
+    }
+    server.stats = std::vector<WorkerStats>(threads);
+    printf("Seed: %llu  matches %d  threads %d  %s\n", static_cast<unsigned long long>(server.seed),
+           matchCount, threads, server.fast ? "fast" : "real time");
+
+    server.matches.resize(matchCount);
+    for (int i = 0; i < matchCount; i++) {
+        ServerMatch& m = server.matches[i];
+        m.slot = i;
+        m.played = 0;
+        m.server = &server;
+        addGameSystems(m.systems, nullptr);
+        m.systems.parallel = false;   // the pool already spreads matches over cores
+        m.frame.match = &m.state;
+        m.frame.logSource = static_cast<uint32_t>(i);
+        startMatch(m);
+    }
+
+    // Ticks are staggered over one period so they do not all land at once
+    int64_t startUs = monotonicMicros();
+    for (int i = 0; i < matchCount; i++) {
+        ServerMatch& m = server.matches[i];
+        m.dueUs = startUs + server.periodUs * i / matchCount;
+        if (server.fast) {
+            server.pool.submit(tickMatch, &m);
+        } else {
+            server.timers.push(std::make_pair(m.dueUs, i));
+        }
+    }
+
+    long long lastTicks = 0, lastMatches = 0;
+    for (int s = 1; s <= seconds; s++) {
+        if (server.fast) {
+            int64_t wait = startUs + s * 1000000LL - monotonicMicros();
+            if (wait > 0) usleep(static_cast<useconds_t>(wait));
+        } else {
+            dispatchUntil(server, startUs + s * 1000000LL);
+        }
+        long long ticks = totalTicks(server), done = totalMatches(server);
+        printf("%3ds  ticks/s %8lld  matches/s %6lld  steals %lld\n", s, ticks - lastTicks, done - lastMatches,
+               static_cast<long long>(server.pool.steals));
+        fflush(stdout);
+        lastTicks = ticks;
+        lastMatches = done;
+    }
+    double elapsed = (monotonicMicros() - startUs) / 1e6;
+    server.stopping = true;
+    server.pool.waitIdle();
+    server.pool.stop();
+
+    LatencyHistogram cost, lag;
+    for (int t = 0; t < threads; t++) {
+        cost.merge(server.stats[t].tickCost);
+        lag.merge(server.stats[t].lag);
+    }
+    long long ticks = totalTicks(server), done = totalMatches(server);
+    long long results[TOTAL_PLAYERS + 1] = {0};
+    for (int t = 0; t < threads; t++) {
+        for (int r = 0; r <= TOTAL_PLAYERS; r++) results[r] += server.stats[t].results[r];
+    }
+    printf("\n%lld ticks, %lld matches finished in %.1fs\n", ticks, done, elapsed);
+    printf("throughput   %.0f ticks/s, %.2f matches/s\n", ticks / elapsed, done / elapsed);
+    printf("tick cost    p50 %.1f us  p99 %.1f us  max %.1f us\n", cost.percentile(0.5) / 1000.0,
+           cost.percentile(0.99) / 1000.0, cost.maxNs / 1000.0);
+    printf("results      P1 (%s) %lld  P2 (greedy) %lld  ties %lld\n", server.mcBot ? "Monte Carlo" : "greedy",
+           results[0], results[1], results[2]);
+    if (!server.fast) {
+        printf("tick lag     p50 %.1f us  p99 %.1f us  max %.1f us  (due time to tick start)\n",
+               lag.percentile(0.5) / 1000.0, lag.percentile(0.99) / 1000.0, lag.maxNs / 1000.0);
+    }
+    metricsServer.stop();
+    if (metricsFile && !writeMetricsFile(metricsFile)) {
+        fprintf(stderr, "Failed to write %s\n", metricsFile);
+    }
+    if (eventLogPath) {
+        eventLog().close();
+        printf("event log    %llu records, %llu dropped, %llu rotations\n",
+               static_cast<unsigned long long>(eventLog().recordsWritten),
+               static_cast<unsigned long long>(eventLog().dropped()),
+               static_cast<unsigned long long>(eventLog().rotations));
+    }
+    return 0;
+}
@@ -0,0 +1,296 @@
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Sparse spatial hash: values at integer cells, grouped into square
+// buckets of (1 << shift) cells a side. Only buckets holding something
+// exist, in an open-addressed table, so memory follows the number of
+// values and not the size of the world. Insert, remove and move are O(1).
+//
+// A second, coarser table keeps one 64-bit mask per block of 8x8 buckets
+// saying which of them are occupied. A rectangle query probes the blocks
+// it overlaps and then only the occupied buckets inside, so its cost is
+// the number of results plus the buckets holding them plus one probe per
+// block: (8 << shift) cells a side, 64x64 cells by default. On huge, very
+// sparse windows that last term still grows with the area; once it
+// exceeds the number of occupied blocks the query walks those instead.
+//
+// insert() returns a handle that stays valid until the value is removed.
+
+#define SPATIAL_DEFAULT_SHIFT 3
+#define SPATIAL_NONE 0xFFFFFFFFu
+#define SPATIAL_BLOCK_SHIFT 3   // a block is 8x8 buckets, one bit each
+#define SPATIAL_DIRECT_BUCKETS 16   // rectangles over this few buckets skip the blocks
+
+// Open-addressed table of bucket or block keys, power-of-two sized and at
+// most half full. Slot is a struct with int32_t bx, by and vacant().
+template <typename Slot>
+struct SpatialTable {
+    std::vector<Slot> slots;
+    size_t used;
+
+    SpatialTable() : used(0) {}
+
+    void clear() {
+        slots.clear();
+        used = 0;
+    }
+
+    size_t find(int bx, int by) const {
+        if (slots.empty()) return SIZE_MAX;
+        for (size_t s = home(bx, by);; s = (s + 1) & (slots.size() - 1)) {
+            if (slots[s].vacant()) return SIZE_MAX;
+            if (slots[s].bx == bx && slots[s].by == by) return s;
+        }
+    }
+
+    // Claims a slot for a key that is not in the table; the caller fills
+    // in the payload, which makes it no longer vacant
+    size_t claim(int bx, int by, const Slot& blank) {
+        if ((used + 1) * 2 > slots.size()) grow(blank);
+        size_t s = home(bx, by);
+        while (!slots[s].vacant()) s = (s + 1) & (slots.size() - 1);
+        slots[s] = blank;
+        slots[s].bx = bx;
+        slots[s].by = by;
+        used++;
+        return s;
+    }
+
+    // Backward-shift deletion keeps every probe run unbroken
+    void erase(size_t s, const Slot& blank) {
+        size_t mask = slots.size() - 1;
+        used--;
+        slots[s] = blank;
+        for (size_t next = (s + 1) & mask; !slots[next].vacant(); next = (next + 1) & mask) {
+            size_t h = home(slots[next].bx, slots[next].by);
+            // Move next into the hole unless its home lies in (s, next]
+            if (((next - h) & mask) >= ((next - s) & mask)) {
+                slots[s] = slots[next];
+                slots[next] = blank;
+                s = next;
+            }
+        }
+    }
+
+    size_t home(int bx, int by) const {
+        uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(bx)) << 32) | static_cast<uint32_t>(by);
+        return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & (slots.size() - 1);
+    }
+
+private:
+    void grow(const Slot& blank) {
+        std::vector<Slot> old;
+        old.swap(slots);
+        slots.assign(old.empty() ? 16 : old.size() * 2, blank);
+        for (size_t s = 0; s < old.size(); s++) {
+            if (old[s].vacant()) continue;
+            size_t t = home(old[s].bx, old[s].by);
+            while (!slots[t].vacant()) t = (t + 1) & (slots.size() - 1);
+            slots[t] = old[s];
+        }
+    }
+};
+
+template <typename T>
+struct SpatialHash {
+    struct Entry {
+        int x, y;
+        T value;
+        uint32_t prev, next;   // bucket list; next links the free list
+    };
+
+    struct Bucket {
+        int32_t bx, by;
+        uint32_t head;
+        bool vacant() const { return head == SPATIAL_NONE; }
+    };
+
+    struct Block {
+        int32_t bx, by;   // block coordinates, bucket >> SPATIAL_BLOCK_SHIFT
+        uint64_t mask;    // bit (bucket x & 7) * 8 + (bucket y & 7)
+        bool vacant() const { return mask == 0; }
+    };
+
+    std::vector<Entry> entries;
+    SpatialTable<Bucket> table;
+    SpatialTable<Block> blocks;
+    uint32_t freeEntry;
+    size_t count;
+    int shift;
+
+    explicit SpatialHash(int bucketShift = SPATIAL_DEFAULT_SHIFT)
+        : freeEntry(SPATIAL_NONE), count(0), shift(bucketShift) {}
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t bucketCount() const { return table.used; }
+
+    // Bytes held, for comparing against a dense grid
+    size_t memoryBytes() const {
+        return entries.capacity() * sizeof(Entry) + table.slots.capacity() * sizeof(Bucket) +
+               blocks.slots.capacity() * sizeof(Block);
+    }
+
+    void clear() {
+        entries.clear();
+        table.clear();
+        blocks.clear();
+        freeEntry = SPATIAL_NONE;
+        count = 0;
+    }
+
+    const Entry& entry(uint32_t handle) const { return entries[handle]; }
+
+    uint32_t insert(int x, int y, const T& value) {
+        uint32_t h;
+        if (freeEntry != SPATIAL_NONE) {
+            h = freeEntry;
+            freeEntry = entries[h].next;
+        } else {
+            h = static_cast<uint32_t>(entries.size());
+            entries.push_back(Entry());
+        }
+        Entry& e = entries[h];
+        e.x = x;
+        e.y = y;
+        e.value = value;
+        link(h);
+        count++;
+        return h;
+    }
+
+    void remove(uint32_t handle) {
+        unlink(handle);
+        entries[handle].next = freeEntry;
+        freeEntry = handle;
+        count--;
+    }
+
+    void move(uint32_t handle, int x, int y) {
+        Entry& e = entries[handle];
+        if ((e.x >> shift) == (x >> shift) && (e.y >> shift) == (y >> shift)) {
+            e.x = x;
+            e.y = y;
+            return;
+        }
+        unlink(handle);
+        entries[handle].x = x;
+        entries[handle].y = y;
+        link(handle);
+    }
+
+    // Calls fn(handle, entry) for every value in the inclusive rectangle
+    template <typename Fn>
+    void queryRect(int x0, int y0, int x1, int y1, Fn fn) const {
+        if (count == 0 || x0 > x1 || y0 > y1) return;
+        int bx0 = x0 >> shift, bx1 = x1 >> shift, by0 = y0 >> shift, by1 = y1 >> shift;
+        // A few buckets, such as a pickup radius: probe them directly
+        if (static_cast<int64_t>(bx1 - bx0 + 1) * (by1 - by0 + 1) <= SPATIAL_DIRECT_BUCKETS) {
+            for (int bx = bx0; bx <= bx1; bx++) {
+                for (int by = by0; by <= by1; by++) {
+                    size_t s = table.find(bx, by);
+                    if (s != SIZE_MAX) visitBucket(table.slots[s].head, x0, y0, x1, y1, fn);
+                }
+            }
+            return;
+        }
+        int kx0 = bx0 >> SPATIAL_BLOCK_SHIFT, kx1 = bx1 >> SPATIAL_BLOCK_SHIFT;
+        int ky0 = by0 >> SPATIAL_BLOCK_SHIFT, ky1 = by1 >> SPATIAL_BLOCK_SHIFT;
+        if (static_cast<int64_t>(kx1 - kx0 + 1) * (ky1 - ky0 + 1) > static_cast<int64_t>(blocks.used)) {
+            for (size_t s = 0; s < blocks.slots.size(); s++) {
+                const Block& k = blocks.slots[s];
+                if (k.vacant() || k.bx < kx0 || k.bx > kx1 || k.by < ky0 || k.by > ky1) continue;
+                visitBlock(k, bx0, by0, bx1, by1, x0, y0, x1, y1, fn);
+            }
+            return;
+        }
+        for (int kx = kx0; kx <= kx1; kx++) {
+            for (int ky = ky0; ky <= ky1; ky++) {
+                size_t s = blocks.find(kx, ky);
+                if (s != SIZE_MAX) visitBlock(blocks.slots[s], bx0, by0, bx1, by1, x0, y0, x1, y1, fn);
+            }
+        }
+    }
+
+    // Values within Euclidean distance r of (cx, cy); r = 0 is the cell itself
+    template <typename Fn>
+    void queryRadius(int cx, int cy, int r, Fn fn) const {
+        int64_t r2 = static_cast<int64_t>(r) * r;
+        queryRect(cx - r, cy - r, cx + r, cy + r, [&](uint32_t h, const Entry& e) {
+            int64_t dx = e.x - cx, dy = e.y - cy;
+            if (dx * dx + dy * dy <= r2) fn(h, e);
+        });
+    }
+
+private:
+    static Bucket blankBucket() {
+        Bucket b = {0, 0, SPATIAL_NONE};
+        return b;
+    }
+
+    static Block blankBlock() {
+        Block k = {0, 0, 0};
+        return k;
+    }
+
+    static int blockBit(int bx, int by) {
+        return (bx & ((1 << SPATIAL_BLOCK_SHIFT) - 1)) << SPATIAL_BLOCK_SHIFT | (by & ((1 << SPATIAL_BLOCK_SHIFT) - 1));
+    }
+
+    // The occupied buckets of one block that lie in [bx0, bx1] x [by0, by1]
+    template <typename Fn>
+    void visitBlock(const Block& k, int bx0, int by0, int bx1, int by1, int x0, int y0, int x1, int y1, Fn& fn) const {
+        for (uint64_t bits = k.mask; bits; bits &= bits - 1) {
+            int bit = __builtin_ctzll(bits);
+            int bx = k.bx * (1 << SPATIAL_BLOCK_SHIFT) + (bit >> SPATIAL_BLOCK_SHIFT);
+            int by = k.by * (1 << SPATIAL_BLOCK_SHIFT) + (bit & ((1 << SPATIAL_BLOCK_SHIFT) - 1));
+            if (bx < bx0 || bx > bx1 || by < by0 || by > by1) continue;
+            visitBucket(table.slots[table.find(bx, by)].head, x0, y0, x1, y1, fn);
+        }
+    }
+
+    template <typename Fn>
+    void visitBucket(uint32_t h, int x0, int y0, int x1, int y1, Fn& fn) const {
+        for (; h != SPATIAL_NONE; h = entries[h].next) {
+            const Entry& e = entries[h];
+            if (e.x >= x0 && e.x <= x1 && e.y >= y0 && e.y <= y1) fn(h, e);
+        }
+    }
+
+    void link(uint32_t h) {
+        int bx = entries[h].x >> shift, by = entries[h].y >> shift;
+        size_t s = table.find(bx, by);
+        if (s == SIZE_MAX) {
+            s = table.claim(bx, by, blankBucket());
+            int kx = bx >> SPATIAL_BLOCK_SHIFT, ky = by >> SPATIAL_BLOCK_SHIFT;
+            size_t k = blocks.find(kx, ky);
+            if (k == SIZE_MAX) k = blocks.claim(kx, ky, blankBlock());
+            blocks.slots[k].mask |= 1ull << blockBit(bx, by);
+        }
+        Bucket& b = table.slots[s];
+        entries[h].prev = SPATIAL_NONE;
+        entries[h].next = b.head;
+        if (b.head != SPATIAL_NONE) entries[b.head].prev = h;
+        b.head = h;
+    }
+
+    void unlink(uint32_t h) {
+        const Entry& e = entries[h];
+        int bx = e.x >> shift, by = e.y >> shift;
+        size_t s = table.find(bx, by);
+        if (e.prev != SPATIAL_NONE) entries[e.prev].next = e.next;
+        else table.slots[s].head = e.next;
+        if (e.next != SPATIAL_NONE) entries[e.next].prev = e.prev;
+        if (table.slots[s].head != SPATIAL_NONE) return;
+        table.erase(s, blankBucket());
+        size_t k = blocks.find(bx >> SPATIAL_BLOCK_SHIFT, by >> SPATIAL_BLOCK_SHIFT);
+        blocks.slots[k].mask &= ~(1ull << blockBit(bx, by));
+        if (blocks.slots[k].vacant()) blocks.erase(k, blankBlock());
+    }
+};
+
+#endif
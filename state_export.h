@@ -0,0 +1,198 @@
+#ifndef STATE_EXPORT_H
+#define STATE_EXPORT_H
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+// Per-tick game state published to POSIX shared memory for observers in
+// other processes (dashboards, recorders, bot trainers). The writer never
+// waits: each tick goes into the next slot of a small ring, guarded by a
+// per-slot sequence number (odd while being written). Readers copy a slot
+// and retry if the sequence moved underneath them.
+
+#define STATE_EXPORT_NAME "/maga_fight_state"
+#define STATE_EXPORT_MAGIC 0x4D474653u   // "MGFS"
+#define STATE_EXPORT_VERSION 1
+#define STATE_EXPORT_SLOTS 8
+
+#define EXPORT_MAX_PLAYERS 8
+#define EXPORT_MAX_ITEMS 64
+#define EXPORT_MAX_CRATES 512
+
+struct ExportPlayer {
+    int32_t x, y, score;
+};
+
+struct ExportItem {
+    int16_t x, y;
+    float spawnTime;
+};
+
+struct ExportCrate {
+    int16_t x, y;
+};
+
+// Fixed binary layout; only the first *Count entries of each array are valid
+struct ExportSnapshot {
+    uint64_t tick;
+    float elapsed;
+    float timeRemaining;
+    int32_t gridSize;
+    int32_t running;
+    int32_t playerCount;
+    int32_t itemCount;
+    int32_t crateCount;
+    int32_t reserved;
+    ExportPlayer players[EXPORT_MAX_PLAYERS];
+    ExportItem items[EXPORT_MAX_ITEMS];
+    ExportCrate crates[EXPORT_MAX_CRATES];
+};
+
+struct alignas(64) ExportSlot {
+    std::atomic<uint32_t> seq;
+    char pad[60];
+    ExportSnapshot data;
+};
+
+struct alignas(64) ExportHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t slotSize;
+    std::atomic<uint64_t> published;   // number of ticks written so far
+};
+
+struct ExportRegion {
+    ExportHeader header;
+    ExportSlot slots[STATE_EXPORT_SLOTS];
+};
+
+struct StateExportWriter {
+    int fd;
+    ExportRegion* region;
+    uint64_t tick;
+    const char* name;
+
+    StateExportWriter() : fd(-1), region(nullptr), tick(0), name(STATE_EXPORT_NAME) {}
+    ~StateExportWriter() { close(); }
+
+    bool open(const char* shmName = STATE_EXPORT_NAME) {
+        name = shmName;
+        fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+        if (fd < 0) return false;
+        if (ftruncate(fd, sizeof(ExportRegion)) != 0) {
+            close();
+            return false;
+        }
+        void* base = mmap(nullptr, sizeof(ExportRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) {
+            close();
+            return false;
+        }
+        region = static_cast<ExportRegion*>(base);
+        memset(static_cast<void*>(region), 0, sizeof(ExportRegion));
+        region->header.slotCount = STATE_EXPORT_SLOTS;
+        region->header.slotSize = sizeof(ExportSlot);
+        region->header.version = STATE_EXPORT_VERSION;
+        std::atomic_thread_fence(std::memory_order_release);
+        region->header.magic = STATE_EXPORT_MAGIC;
+        return true;
+    }
+
+    // Returns the snapshot to fill for this tick; publish() makes it visible
+    ExportSnapshot* begin() {
+        ExportSlot& slot = region->slots[tick % STATE_EXPORT_SLOTS];
+        slot.seq.store(slot.seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.data.tick = tick;
+        return &slot.data;
+    }
+
+    void publish() {
+        ExportSlot& slot = region->slots[tick % STATE_EXPORT_SLOTS];
+        slot.seq.store(slot.seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        region->header.published.store(++tick, std::memory_order_release);
+    }
+
+    void close() {
+        if (region) munmap(region, sizeof(ExportRegion));
+        if (fd >= 0) {
+            ::close(fd);
+            shm_unlink(name);
+        }
+        region = nullptr;
+        fd = -1;
+    }
+};
+
+struct StateExportReader {
+    int fd;
+    const ExportRegion* region;
+
+    StateExportReader() : fd(-1), region(nullptr) {}
+    ~StateExportReader() { close(); }
+
+    bool open(const char* shmName = STATE_EXPORT_NAME) {
+        fd = shm_open(shmName, O_RDONLY, 0);
+        if (fd < 0) return false;
+        // A writer between shm_open and ftruncate, or a stale object from
+        // an older build, is too small; touching it would raise SIGBUS
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(ExportRegion))) {
+            close();
+            return false;
+        }
+        void* base = mmap(nullptr, sizeof(ExportRegion), PROT_READ, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) {
+            close();
+            return false;
+        }
+        region = static_cast<const ExportRegion*>(base);
+        if (region->header.magic != STATE_EXPORT_MAGIC || region->header.version != STATE_EXPORT_VERSION ||
+            region->header.slotSize != sizeof(ExportSlot)) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    uint64_t published() const {
+        return region->header.published.load(std::memory_order_acquire);
+    }
+
+    // Copies the newest complete tick; false if nothing is published yet or
+    // the writer lapped the ring on every attempt
+    bool readLatest(ExportSnapshot& out, int maxAttempts = 16) const {
+        for (int attempt = 0; attempt < maxAttempts; attempt++) {
+            uint64_t count = published();
+            if (count == 0) return false;
+            const ExportSlot& slot = region->slots[(count - 1) % STATE_EXPORT_SLOTS];
+
+            uint32_t before = slot.seq.load(std::memory_order_acquire);
+            if (before & 1) continue;
+            memcpy(&out, &slot.data, sizeof(out));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) != before) continue;
+
+            if (out.playerCount > EXPORT_MAX_PLAYERS) out.playerCount = EXPORT_MAX_PLAYERS;
+            if (out.itemCount > EXPORT_MAX_ITEMS) out.itemCount = EXPORT_MAX_ITEMS;
+            if (out.crateCount > EXPORT_MAX_CRATES) out.crateCount = EXPORT_MAX_CRATES;
+            return true;
+        }
+        return false;
+    }
+
+    void close() {
+        if (region) munmap(const_cast<ExportRegion*>(region), sizeof(ExportRegion));
+        if (fd >= 0) ::close(fd);
+        region = nullptr;
+        fd = -1;
+    }
+};
+
+#endif
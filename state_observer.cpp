@@ -0,0 +1,32 @@
+// Prints the live match published by ./prog --export, ten times a second.
+// g++ -std=c++11 state_observer.cpp -o state_observer -lrt
+#include <unistd.h>
+#include <cstdio>
+#include "state_export.h"
+
+int main() {
+    StateExportReader reader;
+    while (!reader.open()) {
+        fprintf(stderr, "Waiting for %s (start the game with --export)\n", STATE_EXPORT_NAME);
+        sleep(1);
+    }
+
+    ExportSnapshot snap;
+    uint64_t lastTick = ~0ULL;
+    for (;;) {
+        if (reader.readLatest(snap) && snap.tick != lastTick) {
+            lastTick = snap.tick;
+            printf("tick %llu  %5.1fs left  %dx%d  items %d  crates %d ",
+                   static_cast<unsigned long long>(snap.tick), snap.timeRemaining,
+                   snap.gridSize, snap.gridSize, snap.itemCount, snap.crateCount);
+            for (int i = 0; i < snap.playerCount; i++) {
+                printf(" P%d (%d,%d) %d", i + 1, snap.players[i].x, snap.players[i].y, snap.players[i].score);
+            }
+            printf("\n");
+            fflush(stdout);
+            if (!snap.running) break;
+        }
+        usleep(100000);
+    }
+    return 0;
+}
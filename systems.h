@@ -0,0 +1,146 @@
+#ifndef SYSTEMS_H
+#define SYSTEMS_H
+
+#include <atomic>
+#include <vector>
+#include "eventlog.h"
+#include "game.h"
+#include "metrics.h"
+
+// Game systems over the MatchState world. Shared state that is not a
+// component gets a resource bit so the scheduler can order access to it.
+#define RES_BOARD (1u << 16)     // board bitboards and connectivity index
+#define RES_MOVES (1u << 17)     // this frame's move messages
+#define RES_SPAWNER (1u << 18)   // spawn RNG, spawn timer and coin count
+#define RES_RENDER (1u << 19)    // render output (vertex arrays)
+
+struct FrameContext {
+    MatchState* match;
+    float now;
+    bool running;
+    std::vector<MoveMessage> moves;
+    void* renderData;    // owned by whoever supplies the render system
+    uint32_t logSource;  // tags this match's event log records
+    std::atomic<bool>* spawnDue;  // set by a spawn timer, or nullptr to spawn on the clock
+    int pickupRadius;             // cells; 0 collects only the coin underfoot
+
+    FrameContext()
+        : match(nullptr), now(0), running(true), renderData(nullptr), logSource(0), spawnDue(nullptr), pickupRadius(0) {}
+};
+
+// Applies each queued move if the target cell is open
+inline void movementSystem(void* arg, World& world, Commands&) {
+    FrameContext* frame = static_cast<FrameContext*>(arg);
+    MatchState& match = *frame->match;
+    for (size_t i = 0; i < frame->moves.size(); i++) {
+        const MoveMessage& msg = frame->moves[i];
+        Position& pos = world.get<Position>(match.players[msg.playerID]);
+        int newX = pos.x + msg.newX;
+        int newY = pos.y + msg.newY;
+        if (match.board.isOpen(newX, newY)) {
+            pos.x = newX;
+            pos.y = newY;
+            logEvent(EVENT_MOVE, msg.playerID, newX, newY, 0, frame->logSource);
+        } else {
+            countMetric(METRIC_MOVES_REJECTED);
+            logEvent(EVENT_MOVE_REJECTED, msg.playerID, newX, newY, 0, frame->logSource);
+        }
+    }
+}
+
+// A player collects every coin within pickupRadius cells, found through
+// the world's spatial index
+inline void pickupSystem(void* arg, World& world, Commands& cmds) {
+    FrameContext* frame = static_cast<FrameContext*>(arg);
+    MatchState& match = *frame->match;
+    world.each(COMP_POSITION | COMP_SCORE, 0, [&](Archetype& players) {
+        for (int p = 0; p < players.size(); p++) {
+            const Position pos = players.positions[p];
+            // Nothing underfoot: the bitboard answers without a lookup
+            if (frame->pickupRadius == 0 && !match.board.hasItem(pos.x, pos.y)) continue;
+            int player = match.playerIndex(players.entities[p]);
+            world.spatial.queryRadius(pos.x, pos.y, frame->pickupRadius, [&](uint32_t, const SpatialHash<Entity>::Entry& coin) {
+                // The first player to reach a coin clears its board bit;
+                // the entity itself is only destroyed after this stage
+                if (!match.board.pickup(coin.x, coin.y)) return;
+                match.addScore(player, world.get<Collectible>(coin.value).value);
+                countMetric(METRIC_PICKUPS);
+                logEvent(EVENT_PICKUP, player, coin.x, coin.y, match.playerScore(player), frame->logSource);
+                match.connectivity.markFree(coin.x, coin.y);
+                cmds.destroy(coin.value);
+            });
+        }
+    });
+}
+
+// Coins with a lifetime vanish when it runs out
+inline void expirySystem(void* arg, World& world, Commands& cmds) {
+    FrameContext* frame = static_cast<FrameContext*>(arg);
+    MatchState& match = *frame->match;
+    world.each(COMP_POSITION | COMP_LIFETIME, 0, [&](Archetype& a) {
+        for (int i = 0; i < a.size(); i++) {
+            if (frame->now < a.lifetimes[i].expiresAt) continue;
+            const Position& pos = a.positions[i];
+            if (a.mask & COMP_COLLECTIBLE) {
+                match.board.clearItem(pos.x, pos.y);
+                match.connectivity.markFree(pos.x, pos.y);
+            }
+            cmds.destroy(a.entities[i]);
+        }
+    });
+}
+
+// Drops a coin every ITEM_SPAWN_INTERVAL seconds, or whenever spawnDue is
+// raised, on a free cell some player can walk to. A spawn that finds no
+// cell is retried next frame.
+inline void spawnSystem(void* arg, World& world, Commands& cmds) {
+    FrameContext* frame = static_cast<FrameContext*>(arg);
+    MatchState& match = *frame->match;
+    if (!frame->running) return;
+    if (frame->spawnDue ? !frame->spawnDue->load() : frame->now - match.lastItemSpawnTime < ITEM_SPAWN_INTERVAL) return;
+    if (match.itemsSpawned >= MAX_ITEMS) return;
+
+    int xs[TOTAL_PLAYERS], ys[TOTAL_PLAYERS];
+    for (int i = 0; i < TOTAL_PLAYERS; i++) {
+        const Position& pos = world.get<Position>(match.players[i]);
+        xs[i] = pos.x;
+        ys[i] = pos.y;
+    }
+
+    int x, y;
+    if (!match.connectivity.pickReachableFreeCell(xs, ys, TOTAL_PLAYERS, match.spawnRng.next(), x, y)) {
+        countMetric(METRIC_SPAWN_FAILURES);
+        logEvent(EVENT_SPAWN_FAILED, match.itemsSpawned, 0, 0, 0, frame->logSource);
+        return;
+    }
+    match.connectivity.markOccupied(x, y);
+    match.board.setItem(x, y);
+    cmds.create(itemDesc(x, y, frame->now, match.itemLifetime));
+    match.itemsSpawned++;
+    match.lastItemSpawnTime = frame->now;
+    if (frame->spawnDue) frame->spawnDue->store(false);
+    countMetric(METRIC_SPAWNS);
+    logEvent(EVENT_SPAWN, x, y, match.itemsSpawned, 0, frame->logSource);
+}
+
+inline SystemDesc makeSystem(const char* name, unsigned reads, unsigned writes,
+                             void (*run)(void*, World&, Commands&)) {
+    SystemDesc s = {name, reads, writes, run};
+    return s;
+}
+
+// Registers the simulation systems in frame order; render (optional) reads
+// positions and sprites only, so it shares a stage with pickup and draws
+// this frame's positions. Coins picked up, expired or spawned this frame
+// show up in the next one.
+inline void addGameSystems(SystemScheduler& scheduler, void (*render)(void*, World&, Commands&)) {
+    scheduler.add(makeSystem("movement", RES_MOVES | RES_BOARD, COMP_POSITION, movementSystem));
+    scheduler.add(makeSystem("pickup", COMP_POSITION | COMP_COLLECTIBLE, COMP_SCORE | RES_BOARD, pickupSystem));
+    scheduler.add(makeSystem("expiry", COMP_POSITION | COMP_LIFETIME, RES_BOARD, expirySystem));
+    scheduler.add(makeSystem("spawn", COMP_POSITION, RES_BOARD | RES_SPAWNER, spawnSystem));
+    if (render) {
+        scheduler.add(makeSystem("render", COMP_POSITION | COMP_SPRITE, RES_RENDER, render));
+    }
+}
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef THREADCONF_H
+#define THREADCONF_H
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "eventlog.h"
+
+// Per-role thread placement. Every thread the game starts belongs to a
+// role; a role can be pinned to a CPU set, run under SCHED_FIFO or at a
+// nice level, and each thread is named "maga-<role>-<n>" for profilers
+// (top -H, perf, gdb). Roles with nothing configured keep the defaults.
+//
+//   --pin input=0 --pin render=1 --pin pool=2-7
+//   --fifo input=50 --nice pool=10
+//
+// SCHED_FIFO and negative nice levels need CAP_SYS_NICE; without it the
+// thread keeps running with the default policy and a warning is printed
+// once per role.
+
+enum ThreadRole {
+    ROLE_RENDER,       // main loop: events, render, display
+    ROLE_SIMULATION,   // ECS stage threads; the tick dispatcher in the server
+    ROLE_INPUT,        // workers resuming the player input coroutines
+    ROLE_WORKER,       // thread pool workers and frame encoders
+    ROLE_COUNT
+};
+
+struct ThreadRoleConfig {
+    bool pinned;
+    cpu_set_t cpus;
+    int fifoPriority;   // 0 = default policy
+    bool niced;
+    int nice;
+};
+
+struct ThreadConfig {
+    ThreadRoleConfig roles[ROLE_COUNT];
+    std::atomic<unsigned> warned;   // one bit per role
+
+    ThreadConfig() : warned(0) {
+        for (int r = 0; r < ROLE_COUNT; r++) {
+            roles[r].pinned = false;
+            CPU_ZERO(&roles[r].cpus);
+            roles[r].fifoPriority = 0;
+            roles[r].niced = false;
+            roles[r].nice = 0;
+        }
+    }
+};
+
+inline ThreadConfig& threadConfig() {
+    static ThreadConfig config;
+    return config;
+}
+
+inline const char* threadRoleName(int role) {
+    static const char* names[ROLE_COUNT] = {"render", "sim", "input", "pool"};
+    return role >= 0 && role < ROLE_COUNT ? names[role] : "?";
+}
+
+// "0,2-3" -> {0, 2, 3}
+inline bool parseCpuList(const char* text, cpu_set_t& cpus) {
+    CPU_ZERO(&cpus);
+    const char* p = text;
+    while (*p) {
+        char* end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0) return false;
+        long last = first;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first) return false;
+        }
+        if (last >= CPU_SETSIZE) return false;
+        for (long c = first; c <= last; c++) CPU_SET(static_cast<int>(c), &cpus);
+        if (*end == ',') end++;
+        else if (*end) return false;
+        p = end;
+    }
+    return CPU_COUNT(&cpus) > 0;
+}
+
+// Handles --pin, --fifo and --nice; value is "<role>=<setting>". Returns
+// false if flag is not one of them or the value does not parse.
+inline bool parseThreadOption(const char* flag, const char* value) {
+    const char* eq = strchr(value, '=');
+    if (!eq) return false;
+    int role = -1;
+    for (int r = 0; r < ROLE_COUNT; r++) {
+        size_t len = strlen(threadRoleName(r));
+        if (static_cast<size_t>(eq - value) == len && strncmp(value, threadRoleName(r), len) == 0) role = r;
+    }
+    if (role < 0) return false;
+
+    ThreadRoleConfig& cfg = threadConfig().roles[role];
+    const char* setting = eq + 1;
+    char* end;
+    if (strcmp(flag, "--pin") == 0) {
+        cfg.pinned = parseCpuList(setting, cfg.cpus);
+        return cfg.pinned;
+    }
+    long n = strtol(setting, &end, 10);
+    if (end == setting || *end) return false;
+    if (strcmp(flag, "--fifo") == 0) {
+        if (n < sched_get_priority_min(SCHED_FIFO) || n > sched_get_priority_max(SCHED_FIFO)) return false;
+        cfg.fifoPriority = static_cast<int>(n);
+        return true;
+    }
+    if (strcmp(flag, "--nice") == 0) {
+        if (n < -20 || n > 19) return false;
+        cfg.niced = true;
+        cfg.nice = static_cast<int>(n);
+        return true;
+    }
+    return false;
+}
+
+inline bool isThreadOption(const char* flag) {
+    return strcmp(flag, "--pin") == 0 || strcmp(flag, "--fifo") == 0 || strcmp(flag, "--nice") == 0;
+}
+
+inline void warnThreadRole(int role, const char* what, int err) {
+    unsigned bit = 1u << role;
+    if (threadConfig().warned.fetch_or(bit) & bit) return;
+    fprintf(stderr, "Thread role %s: %s failed: %s\n", threadRoleName(role), what, strerror(err));
+}
+
+// Names the calling thread and applies its role's CPU set, policy and nice
+// level. Returns false if any requested setting could not be applied.
+inline bool applyThreadRole(ThreadRole role, int index) {
+    char name[16];
+    snprintf(name, sizeof(name), "maga-%s-%d", threadRoleName(role), index);
+    pthread_setname_np(pthread_self(), name);
+
+    const ThreadRoleConfig& cfg = threadConfig().roles[role];
+    bool ok = true;
+    int err;
+    if (cfg.pinned && (err = pthread_setaffinity_np(pthread_self(), sizeof(cfg.cpus), &cfg.cpus)) != 0) {
+        warnThreadRole(role, "pinning", err);
+        ok = false;
+    }
+    if (cfg.fifoPriority > 0) {
+        sched_param param;
+        param.sched_priority = cfg.fifoPriority;
+        if ((err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param)) != 0) {
+            warnThreadRole(role, "SCHED_FIFO", err);
+            ok = false;
+        }
+    }
+    // On Linux the nice level belongs to the thread, addressed by its tid
+    if (cfg.niced && setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), cfg.nice) != 0) {
+        warnThreadRole(role, "nice", errno);
+        ok = false;
+    }
+    return ok;
+}
+
+struct RoleThreadStart {
+    ThreadRole role;
+    int index;
+    void* (*fn)(void*);
+    void* arg;
+};
+
+inline void* roleThreadMain(void* arg) {
+    RoleThreadStart start = *static_cast<RoleThreadStart*>(arg);
+    delete static_cast<RoleThreadStart*>(arg);
+    applyThreadRole(start.role, start.index);
+    logEvent(EVENT_THREAD_START, start.role, start.index);
+    void* result = start.fn(start.arg);
+    logEvent(EVENT_THREAD_STOP, start.role, start.index);
+    return result;
+}
+
+// pthread_create for a thread of the given role
+inline int createRoleThread(pthread_t* thread, ThreadRole role, int index, void* (*fn)(void*), void* arg) {
+    RoleThreadStart* start = new RoleThreadStart;
+    start->role = role;
+    start->index = index;
+    start->fn = fn;
+    start->arg = arg;
+    int err = pthread_create(thread, nullptr, roleThreadMain, start);
+    if (err != 0) delete start;
+    return err;
+}
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <pthread.h>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include "threadconf.h"
+
+// Work-stealing pool of pthreads. Every worker owns a deque: it pushes and
+// pops its own tasks at the back (newest first, still warm in cache) and,
+// when it runs dry, steals the oldest task from the front of another
+// worker's deque. Idle workers sleep on a condition variable, so a pool
+// with nothing queued uses no CPU.
+
+#define POOL_MAX_THREADS 256
+
+struct PoolTask {
+    void (*fn)(void*);
+    void* arg;
+};
+
+struct WorkerQueue {
+    pthread_mutex_t lock;
+    std::deque<PoolTask> tasks;
+    char pad[64];   // keeps the next queue's lock off this cache line
+};
+
+struct ThreadPool;
+
+struct PoolWorkerSlot {
+    ThreadPool* pool;
+    int index;
+};
+
+// Which pool and worker the calling thread is, so submit() from inside a
+// task goes to the local deque
+inline PoolWorkerSlot& poolWorkerSlot() {
+    static thread_local PoolWorkerSlot slot = {nullptr, -1};
+    return slot;
+}
+
+struct ThreadPool {
+    std::vector<WorkerQueue*> queues;
+    std::vector<pthread_t> threads;
+    std::atomic<int> queued;     // tasks waiting in some deque
+    std::atomic<int> pending;    // tasks submitted and not yet finished
+    std::atomic<int> sleepers;
+    std::atomic<bool> stopping;
+    std::atomic<unsigned> nextQueue;
+    std::atomic<long long> steals;
+    ThreadRole role;             // placement and names of the workers
+    pthread_mutex_t idleLock;
+    pthread_cond_t idleCond;
+    pthread_cond_t doneCond;
+
+    ThreadPool() : queued(0), pending(0), sleepers(0), stopping(false), nextQueue(0), steals(0), role(ROLE_WORKER) {
+        pthread_mutex_init(&idleLock, nullptr);
+        pthread_cond_init(&idleCond, nullptr);
+        pthread_cond_init(&doneCond, nullptr);
+    }
+
+    ~ThreadPool() {
+        stop();
+        pthread_cond_destroy(&doneCond);
+        pthread_cond_destroy(&idleCond);
+        pthread_mutex_destroy(&idleLock);
+    }
+
+    int size() const { return static_cast<int>(queues.size()); }
+
+    // Returns the number of workers actually started
+    int start(int threadCount) {
+        if (threadCount < 1) threadCount = 1;
+        if (threadCount > POOL_MAX_THREADS) threadCount = POOL_MAX_THREADS;
+        for (int i = 0; i < threadCount; i++) {
+            WorkerQueue* q = new WorkerQueue;
+            pthread_mutex_init(&q->lock, nullptr);
+            queues.push_back(q);
+        }
+        threads.resize(threadCount);
+        for (int i = 0; i < threadCount; i++) {
+            PoolWorkerSlot* slot = new PoolWorkerSlot;
+            slot->pool = this;
+            slot->index = i;
+            if (createRoleThread(&threads[i], role, i, worker, slot) != 0) {
+                delete slot;
+                threads.resize(i);
+                break;
+            }
+        }
+        return static_cast<int>(threads.size());
+    }
+
+    void submit(void (*fn)(void*), void* arg) {
+        PoolTask task = {fn, arg};
+        PoolWorkerSlot& self = poolWorkerSlot();
+        int q = self.pool == this ? self.index : static_cast<int>(nextQueue++ % queues.size());
+        pending++;
+        pthread_mutex_lock(&queues[q]->lock);
+        queues[q]->tasks.push_back(task);
+        pthread_mutex_unlock(&queues[q]->lock);
+        queued++;
+        if (sleepers.load() > 0) {
+            pthread_mutex_lock(&idleLock);
+            pthread_cond_signal(&idleCond);
+            pthread_mutex_unlock(&idleLock);
+        }
+    }
+
+    // Blocks until every submitted task (including ones they submit) is done
+    void waitIdle() {
+        pthread_mutex_lock(&idleLock);
+        while (pending.load() > 0) pthread_cond_wait(&doneCond, &idleLock);
+        pthread_mutex_unlock(&idleLock);
+    }
+
+    void stop() {
+        if (queues.empty()) return;
+        pthread_mutex_lock(&idleLock);
+        stopping = true;
+        pthread_cond_broadcast(&idleCond);
+        pthread_mutex_unlock(&idleLock);
+        for (size_t i = 0; i < threads.size(); i++) pthread_join(threads[i], nullptr);
+        for (size_t i = 0; i < queues.size(); i++) {
+            pthread_mutex_destroy(&queues[i]->lock);
+            delete queues[i];
+        }
+        queues.clear();
+        threads.clear();
+    }
+
+private:
+    bool popLocal(int self, PoolTask& task) {
+        WorkerQueue* q = queues[self];
+        pthread_mutex_lock(&q->lock);
+        bool found = !q->tasks.empty();
+        if (found) {
+            task = q->tasks.back();
+            q->tasks.pop_back();
+        }
+        pthread_mutex_unlock(&q->lock);
+        return found;
+    }
+
+    bool steal(int self, PoolTask& task) {
+        int n = size();
+        for (int i = 1; i < n; i++) {
+            WorkerQueue* q = queues[(self + i) % n];
+            pthread_mutex_lock(&q->lock);
+            bool found = !q->tasks.empty();
+            if (found) {
+                task = q->tasks.front();
+                q->tasks.pop_front();
+            }
+            pthread_mutex_unlock(&q->lock);
+            if (found) {
+                steals++;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void finish() {
+        if (--pending == 0) {
+            pthread_mutex_lock(&idleLock);
+            pthread_cond_broadcast(&doneCond);
+            pthread_mutex_unlock(&idleLock);
+        }
+    }
+
+    static void* worker(void* arg) {
+        PoolWorkerSlot* slot = static_cast<PoolWorkerSlot*>(arg);
+        ThreadPool* pool = slot->pool;
+        int self = slot->index;
+        poolWorkerSlot() = *slot;
+        delete slot;
+
+        PoolTask task;
+        for (;;) {
+            if (pool->popLocal(self, task) || pool->steal(self, task)) {
+                pool->queued--;
+                task.fn(task.arg);
+                pool->finish();
+                continue;
+            }
+            // Nothing anywhere: sleep until submit() sees us and signals
+            pthread_mutex_lock(&pool->idleLock);
+            pool->sleepers++;
+            while (pool->queued.load() == 0 && !pool->stopping) {
+                pthread_cond_wait(&pool->idleCond, &pool->idleLock);
+            }
+            pool->sleepers--;
+            bool stop = pool->stopping && pool->queued.load() == 0;
+            pthread_mutex_unlock(&pool->idleLock);
+            if (stop) break;
+        }
+        return nullptr;
+    }
+};
+
+#endif